@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+// collects per-frame timings of a headless benchmark run and serializes them
+// as json so they can be compared between runs
+struct BenchmarkReport {
+	struct Counter {
+		std::string name;
+		double sum;
+		uint32_t samples;
+	};
+
+	// frames rendered with one set of options. Every configuration has its
+	// own distributions, so the percentiles of one are not mixed with those
+	// of another.
+	struct Configuration {
+		std::string name;
+
+		std::vector<double> cpu_frame_ms;
+		std::vector<double> cpu_record_ms;
+		std::vector<double> gpu_ms;
+
+		// free form named values (draw calls, culled objects...), reported
+		// as the average over the frames they were added on
+		std::vector<Counter> counters;
+	};
+
+	std::string scene;
+	uint32_t width;
+	uint32_t height;
+	std::string device_name;
+
+	std::vector<Configuration> configurations;
+
+	// the frames and counters added from now on belong to a new
+	// configuration
+	void begin_configuration(const std::string& name);
+
+	void add_frame(double frame_ms, double record_ms);
+
+	void add_gpu_frame(double ms);
+
+	void add_counter(const std::string& name, double value);
+
+	std::string to_json() const;
+
+private:
+	// the last configuration, a default one if none was begun
+	Configuration& current();
+};
+
+// the contents of a json string literal, names come from the command line,
+// the driver and asset files
+std::string json_escape(std::string_view text);
+
+// writes a json report to path, or to stdout if path is empty. False if the
+// file could not be written.
+bool write_report(const std::string& json, const std::string& path);
+
+// returns the p-th percentile (0..100) of the samples using nearest-rank
+double percentile(std::vector<double> samples, double p);
+
+struct MicrobenchmarkOptions {
+	std::string name;
+	// asset used by benchmarks that load one
+	std::string asset_path = "assets/basicmesh.glb";
+	uint32_t iterations = 20;
+};
+
+// runs a cpu side microbenchmark and returns its report as json, nothing if
+// there is no benchmark with that name
+std::optional<std::string> run_microbenchmark(
+		const MicrobenchmarkOptions& options);
+
+// the microbenchmarks that measure vulkan calls, they run on the device of an
+// initialized engine instead
+bool is_device_microbenchmark(std::string_view name);
+
+std::optional<std::string> run_device_microbenchmark(
+		const MicrobenchmarkOptions& options, VkDevice device);
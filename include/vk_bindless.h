@@ -0,0 +1,48 @@
+#pragma once
+
+#include "vk_types.h"
+
+#include <unordered_map>
+
+// sizes of the bindless arrays, the shaders declare the same in
+// input_structures.glsl
+constexpr uint32_t BINDLESS_MAX_TEXTURES = 4096;
+constexpr uint32_t BINDLESS_MAX_SAMPLERS = 32;
+
+// the one descriptor set every mesh draw binds: all textures, all samplers
+// and the material registry's buffer. A draw picks its material with an
+// index in its push constants, so materials need neither sets of their own
+// nor binds between draws.
+//
+// The arrays are partially bound and update after bind, so entries can be
+// added while frames in flight still use the set, as long as those frames do
+// not read the new entries.
+class BindlessTable {
+public:
+	void init(VkDevice device, VkBuffer material_buffer,
+			VkDeviceSize material_buffer_size);
+
+	void destroy();
+
+	// index of the view in the texture array, the same view is only added
+	// once. Nothing if the array is full.
+	std::optional<uint32_t> add_texture(VkImageView view);
+
+	std::optional<uint32_t> add_sampler(VkSampler sampler);
+
+	VkDescriptorSetLayout layout() const { return _layout; }
+	VkDescriptorSet set() const { return _set; }
+
+	uint32_t texture_count() const { return (uint32_t)_textures.size(); }
+	uint32_t sampler_count() const { return (uint32_t)_samplers.size(); }
+
+private:
+	VkDevice _device;
+
+	VkDescriptorSetLayout _layout;
+	VkDescriptorPool _pool;
+	VkDescriptorSet _set;
+
+	std::unordered_map<VkImageView, uint32_t> _textures;
+	std::unordered_map<VkSampler, uint32_t> _samplers;
+};
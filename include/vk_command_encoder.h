@@ -0,0 +1,96 @@
+#pragma once
+
+#include "vk_descriptors.h"
+#include "vk_types.h"
+
+struct EncoderCounters {
+	uint32_t issued = 0;
+	uint32_t elided = 0;
+};
+
+// bind calls recorded through a command encoder, split by whether they
+// reached vulkan or were skipped as redundant
+struct CommandEncoderStats {
+	EncoderCounters pipelines;
+	EncoderCounters descriptor_sets;
+	EncoderCounters index_buffers;
+	EncoderCounters push_constants;
+	uint32_t draws = 0;
+	// vkCmdDrawIndexedIndirectCount calls, each drawing a whole batch
+	uint32_t indirect_draws = 0;
+
+	// sums the stats of encoders that recorded parts of the same pass
+	CommandEncoderStats& operator+=(const CommandEncoderStats& other);
+};
+
+// thin wrapper over a graphics command buffer that remembers the state it
+// bound and skips calls that would not change it. Only tracks what goes
+// through it, so the command buffer must not be bound to directly while an
+// encoder is recording into it.
+class CommandEncoder {
+public:
+	explicit CommandEncoder(VkCommandBuffer cmd) : _cmd(cmd) {}
+
+	void bind_pipeline(VkPipeline pipeline);
+
+	// a set with dynamic buffers is only rebound if one of its offsets
+	// changed
+	void bind_descriptor_set(VkPipelineLayout layout, uint32_t set,
+			VkDescriptorSet descriptor,
+			std::span<const uint32_t> dynamic_offsets = {});
+
+	// pushes the writer's writes as the set, skipped if the same writes were
+	// the last pushed there with the same layout
+	void push_descriptor_set(VkPipelineLayout layout, uint32_t set,
+			const DescriptorWriter& writer);
+
+	void bind_index_buffer(
+			VkBuffer buffer, VkDeviceSize offset, VkIndexType type);
+
+	void push_constants(VkPipelineLayout layout, VkShaderStageFlags stages,
+			uint32_t size, const void* data);
+
+	void draw_indexed(uint32_t index_count, uint32_t instance_count,
+			uint32_t first_index, int32_t vertex_offset,
+			uint32_t first_instance);
+
+	void draw_indexed_indirect_count(VkBuffer buffer, VkDeviceSize offset,
+			VkBuffer count_buffer, VkDeviceSize count_offset,
+			uint32_t max_draw_count, uint32_t stride);
+
+	const CommandEncoderStats& stats() const { return _stats; }
+
+private:
+	// the guaranteed minimum of maxPushConstantsSize
+	static constexpr uint32_t MAX_PUSH_CONSTANTS_SIZE = 128;
+	static constexpr uint32_t MAX_DESCRIPTOR_SETS = 4;
+	static constexpr uint32_t MAX_DYNAMIC_OFFSETS = 4;
+
+	// forgets the sets bound with other layouts than the one just bound
+	void set_bound(VkPipelineLayout layout, uint32_t set);
+
+	VkCommandBuffer _cmd;
+
+	VkPipeline _pipeline{ VK_NULL_HANDLE };
+
+	// a set stays bound for as long as it is used with the layout it was
+	// bound with
+	VkPipelineLayout _set_layouts[MAX_DESCRIPTOR_SETS] = {};
+	VkDescriptorSet _sets[MAX_DESCRIPTOR_SETS] = {};
+	uint32_t _dynamic_offsets[MAX_DESCRIPTOR_SETS][MAX_DYNAMIC_OFFSETS] = {};
+	uint32_t _dynamic_offset_counts[MAX_DESCRIPTOR_SETS] = {};
+	// key of the writes of a pushed set, whose descriptor is null
+	std::vector<uint64_t> _pushed[MAX_DESCRIPTOR_SETS];
+	std::vector<uint64_t> _key;
+
+	VkBuffer _index_buffer{ VK_NULL_HANDLE };
+	VkDeviceSize _index_offset{ 0 };
+	VkIndexType _index_type{ VK_INDEX_TYPE_MAX_ENUM };
+
+	VkPipelineLayout _push_layout{ VK_NULL_HANDLE };
+	VkShaderStageFlags _push_stages{ 0 };
+	uint32_t _push_size{ 0 };
+	uint8_t _push_data[MAX_PUSH_CONSTANTS_SIZE];
+
+	CommandEncoderStats _stats;
+};
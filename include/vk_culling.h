@@ -0,0 +1,46 @@
+#pragma once
+
+#include "vk_types.h"
+
+// planes of a view frustum, xyz point inwards and a point p is inside a plane
+// when dot(xyz, p) + w >= 0
+struct Frustum {
+	glm::vec4 planes[6];
+};
+
+// extracts the planes from a view projection matrix with a [0, 1] depth range
+Frustum make_frustum(const glm::mat4& viewproj);
+
+// world space bounding spheres in structure of arrays layout, so the kernels
+// can test one sphere per simd lane
+struct SphereBatch {
+	std::vector<float> x;
+	std::vector<float> y;
+	std::vector<float> z;
+	std::vector<float> radius;
+
+	void resize(size_t count) {
+		x.resize(count);
+		y.resize(count);
+		z.resize(count);
+		radius.resize(count);
+	}
+
+	size_t size() const { return x.size(); }
+};
+
+enum class CullingKernel : uint8_t {
+	Scalar,
+	SSE,
+	AVX2,
+};
+
+// widest kernel the cpu running this supports
+CullingKernel best_culling_kernel();
+
+const char* culling_kernel_name(CullingKernel kernel);
+
+// sets visible[i] to 1 if sphere i intersects the frustum and to 0 if it is
+// fully outside of any plane. Returns the number of visible spheres.
+uint32_t cull_spheres(const Frustum& frustum, const SphereBatch& spheres,
+		uint8_t* visible, CullingKernel kernel = best_culling_kernel());
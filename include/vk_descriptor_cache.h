@@ -0,0 +1,92 @@
+#pragma once
+
+#include "vk_descriptors.h"
+
+#include <deque>
+#include <list>
+#include <unordered_map>
+
+struct DescriptorCacheStats {
+	uint32_t hits = 0;
+	uint32_t misses = 0;
+	// released sets given up to make room, each is rewritten by a later miss
+	// of its layout
+	uint32_t evictions = 0;
+	// misses served by rewriting an evicted set, and misses that allocated
+	// a new set because the evicted ones were still used by frames in flight
+	uint32_t reuses = 0;
+	uint32_t deferred_reuses = 0;
+	uint32_t entries = 0;
+};
+
+// descriptor sets addressed by their layout and contents. Asking for a set
+// with the same layout and writes as one asked for before returns that set
+// instead of allocating and writing another.
+//
+// Every acquire takes a reference. Released sets stay cached, but once the
+// cache is full they are evicted least recently released first. The cache
+// only grows past its capacity while every set in it is referenced.
+//
+// The sets are not update after bind, so an evicted set is only rewritten
+// once the last frame that was recorded with it has completed.
+class DescriptorSetCache {
+public:
+	// sets are allocated from allocator, which has to outlive the cache
+	void init(DescriptorAllocatorGrowable* allocator, uint32_t capacity);
+
+	// the set writer's writes go to for layout, written only on a miss
+	VkDescriptorSet acquire(VkDevice device, VkDescriptorSetLayout layout,
+			DescriptorWriter& writer);
+
+	// frame is the number of the last frame recorded with the set
+	void release(VkDescriptorSet set, uint64_t frame);
+
+	// every frame up to and including frame has completed on the gpu, their
+	// evicted sets may be rewritten
+	void frames_completed(uint64_t frame) { _completed_frame = frame; }
+
+	const DescriptorCacheStats& stats() const { return _stats; }
+
+	float hit_rate() const {
+		const uint32_t requests = _stats.hits + _stats.misses;
+		return requests == 0 ? 0.0f : (float)_stats.hits / requests;
+	}
+
+private:
+	struct Entry {
+		std::vector<uint64_t> key;
+		uint64_t hash;
+		VkDescriptorSetLayout layout;
+		uint32_t references;
+		// the last frame recorded with the set, as of its last release
+		uint64_t frame;
+		// where the set is in _released while it has no references
+		std::list<VkDescriptorSet>::iterator released;
+	};
+
+	struct EvictedSet {
+		VkDescriptorSet set;
+		uint64_t frame;
+	};
+
+	void evict();
+
+	DescriptorAllocatorGrowable* _allocator;
+	uint32_t _capacity{ 0 };
+	// nothing has completed before the first call to frames_completed
+	std::optional<uint64_t> _completed_frame;
+
+	std::unordered_map<VkDescriptorSet, Entry> _entries;
+	// sets by the hash of their key, sets whose keys collide share a hash
+	std::unordered_multimap<uint64_t, VkDescriptorSet> _sets;
+	// sets without references, least recently released first
+	std::list<VkDescriptorSet> _released;
+	// evicted sets waiting for a miss of their layout, oldest first. A set
+	// is only taken once its frame has completed.
+	std::unordered_map<VkDescriptorSetLayout, std::deque<EvictedSet>> _free;
+
+	// scratch, kept between acquires
+	std::vector<uint64_t> _key;
+
+	DescriptorCacheStats _stats;
+};
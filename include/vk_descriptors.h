@@ -1,21 +1,33 @@
 #pragma once
 
 #include <span>
+#include <unordered_map>
 
 #include "vk_types.h"
 
 struct DescriptorLayoutBuilder {
 	std::vector<VkDescriptorSetLayoutBinding> bindings;
 
-	void add_binding(uint32_t binding, VkDescriptorType type);
+	// count above 1 makes the binding an array
+	void add_binding(
+			uint32_t binding, VkDescriptorType type, uint32_t count = 1);
 
 	void clear();
 
 	VkDescriptorSetLayout build(VkDevice device,
 			VkShaderStageFlags shader_stages, void* next = nullptr,
 			VkDescriptorSetLayoutCreateFlags flags = 0);
+
+	// a layout whose sets are never allocated but pushed into the command
+	// buffer with DescriptorWriter::push. It cannot have dynamic buffers.
+	VkDescriptorSetLayout build_push(
+			VkDevice device, VkShaderStageFlags shader_stages);
 };
 
+// fetches vkCmdPushDescriptorSetKHR for DescriptorWriter::push, false if the
+// device was created without VK_KHR_push_descriptor
+bool load_push_descriptor(VkDevice device);
+
 struct DescriptorAllocator {
 	struct PoolSizeRatio {
 		VkDescriptorType type;
@@ -34,6 +46,26 @@ struct DescriptorAllocator {
 	VkDescriptorSet allocate(VkDevice device, VkDescriptorSetLayout layout);
 };
 
+// what one pool of a growable allocator can hold and what is taken of it.
+// Descriptors only count for sets of described layouts.
+struct DescriptorPoolUsage {
+	VkDescriptorPool pool;
+	uint32_t max_sets = 0;
+	uint32_t sets = 0;
+	std::vector<VkDescriptorPoolSize> max_descriptors;
+	std::vector<VkDescriptorPoolSize> descriptors;
+	// allocation calls it could not satisfy
+	uint32_t failures = 0;
+};
+
+struct DescriptorAllocatorStats {
+	uint32_t pools_created = 0;
+	uint32_t sets = 0;
+	// vkAllocateDescriptorSets calls, and those that ran out of the pool
+	uint32_t allocate_calls = 0;
+	uint32_t failed_calls = 0;
+};
+
 struct DescriptorAllocatorGrowable {
 	struct PoolSizeRatio {
 		VkDescriptorType type;
@@ -47,18 +79,56 @@ struct DescriptorAllocatorGrowable {
 
 	void destroy_pools(VkDevice device);
 
+	// the descriptors a set of the layout takes. Pools created from then on
+	// size each type by what the described sets took on average so far,
+	// types nothing described took keep their ratio.
+	void describe_layout(VkDescriptorSetLayout layout,
+			std::span<const VkDescriptorSetLayoutBinding> bindings);
+
 	VkDescriptorSet allocate(VkDevice device, VkDescriptorSetLayout layout,
 			void* next = nullptr);
 
+	// one set per layout, in order. Each call takes as many sets as the
+	// current pool has left, halving the batch while the pool runs out of
+	// descriptors before it runs out of sets, then moves to the next pool.
+	std::vector<VkDescriptorSet> allocate_many(
+			VkDevice device, std::span<const VkDescriptorSetLayout> layouts);
+
+	std::span<const DescriptorPoolUsage> pool_usage() const {
+		return _pool_usage;
+	}
+	std::span<const PoolSizeRatio> ratios() const { return _ratios; }
+	const DescriptorAllocatorStats& stats() const { return _stats; }
+
 private:
 	VkDescriptorPool get_pool(VkDevice device);
 	VkDescriptorPool create_pool(VkDevice device, uint32_t set_count,
 			std::span<PoolSizeRatio> pool_ratios);
 
+	// a single vkAllocateDescriptorSets call, counted into the usage
+	VkResult allocate_from(VkDevice device, VkDescriptorPool pool,
+			std::span<const VkDescriptorSetLayout> layouts,
+			VkDescriptorSet* sets, void* next = nullptr);
+
+	DescriptorPoolUsage& usage_of(VkDescriptorPool pool);
+
+	void adapt_ratios();
+
 	std::vector<PoolSizeRatio> _ratios;
 	std::vector<VkDescriptorPool> _full_pools;
 	std::vector<VkDescriptorPool> _ready_pools;
 	uint32_t _sets_per_pool;
+
+	// in creation order
+	std::vector<DescriptorPoolUsage> _pool_usage;
+	DescriptorAllocatorStats _stats;
+
+	std::unordered_map<VkDescriptorSetLayout, std::vector<VkDescriptorPoolSize>>
+			_layouts;
+	// descriptors every described set allocated so far took, and how many
+	// sets that was
+	std::vector<VkDescriptorPoolSize> _demand;
+	uint32_t _demand_sets = 0;
 };
 
 struct DescriptorWriter {
@@ -72,10 +142,21 @@ struct DescriptorWriter {
 	// sets imageview and layout to null, and other similar abstractions.
 
 	void write_image(int binding, VkImageView image, VkSampler sampler,
-			VkImageLayout layout, VkDescriptorType type);
+			VkImageLayout layout, VkDescriptorType type,
+			uint32_t array_element = 0);
 	void write_buffer(int binding, VkBuffer buffer, size_t size, size_t offset,
 			VkDescriptorType type);
 
 	void clear();
 	void update_set(VkDevice device, VkDescriptorSet set);
+
+	// records the writes into cmd as set of layout, which has to be a push
+	// descriptor layout
+	void push(VkCommandBuffer cmd, VkPipelineLayout layout, uint32_t set,
+			VkPipelineBindPoint bind_point =
+					VK_PIPELINE_BIND_POINT_GRAPHICS) const;
+
+	// appends everything the writes put into a set, so sets written with
+	// equal keys are equal
+	void append_key(std::vector<uint64_t>& key) const;
 };
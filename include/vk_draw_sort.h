@@ -0,0 +1,36 @@
+#pragma once
+
+#include "vk_types.h"
+
+// 64 bit draw sort key, from the most to the least significant bits:
+//   pass 2 | pipeline 6 | material 16 | mesh 24 | depth 16
+// so sorting by key groups draws by the state they need, most expensive
+// change first, and orders draws that share all of it far to near
+uint64_t make_draw_key(MaterialPass pass, uint32_t pipeline_id,
+		uint32_t material_id, uint32_t mesh_id, float view_depth);
+
+// key of a blended draw that has to be drawn back to front:
+//   depth 16 | material 16 | mesh 24
+// depth comes first so the order is right across pipelines and materials,
+// state only orders draws at the same quantized depth
+uint64_t make_blended_draw_key(
+		uint32_t material_id, uint32_t mesh_id, float view_depth);
+
+// sorts draw indices by their keys with an lsd radix sort over 8 bit digits.
+// Digits every key shares are skipped, so keys that only differ in a few
+// fields cost only a few passes. Keeps the scratch memory between calls.
+class DrawSorter {
+public:
+	// writes the indices of keys to order, sorted by key. Draws with equal
+	// keys keep their relative order.
+	void sort(std::span<const uint64_t> keys, std::vector<uint32_t>& order);
+
+private:
+	struct Item {
+		uint64_t key;
+		uint32_t index;
+	};
+
+	std::vector<Item> _items;
+	std::vector<Item> _scratch;
+};
@@ -1,8 +1,21 @@
 #pragma once
 
+#include "vk_benchmark.h"
+#include "vk_bindless.h"
+#include "vk_command_encoder.h"
+#include "vk_culling.h"
+#include "vk_descriptor_cache.h"
 #include "vk_descriptors.h"
+#include "vk_draw_sort.h"
+#include "vk_geometry.h"
+#include "vk_jobs.h"
 #include "vk_loader.h"
+#include "vk_material_registry.h"
+#include "vk_occlusion.h"
 #include "vk_types.h"
+#include "vk_uniform_arena.h"
+#include "vk_upload.h"
+#include "vk_vertex_packing.h"
 
 struct DeletionQueue {
 	std::deque<std::function<void()>> deletors;
@@ -24,15 +37,144 @@ struct FrameData {
 	VkCommandPool command_pool;
 	VkCommandBuffer main_command_buffer;
 
+	// secondary buffers the draw list is recorded into in parallel, each
+	// with its own pool
+	std::vector<VkCommandPool> thread_command_pools;
+	std::vector<VkCommandBuffer> thread_command_buffers;
+
 	VkSemaphore swapchain_semaphore, render_semaphore;
 	VkFence render_fence;
 
 	DeletionQueue deletion_queue;
-	DescriptorAllocatorGrowable frame_descriptors;
+
+	// uniform data of the frame, and the scene set that points at it. The
+	// scene data is picked with a dynamic offset. With push descriptors there
+	// is no set, the writer holds the descriptor pushed instead.
+	UniformArena uniforms;
+	VkDescriptorSet scene_descriptor{ VK_NULL_HANDLE };
+	DescriptorWriter scene_writer;
+	uint32_t scene_data_offset{ 0 };
+
+	// begin and end timestamps of the frame's command buffer
+	VkQueryPool timestamp_pool{ VK_NULL_HANDLE };
+	bool timestamps_written{ false };
+
+	// transforms of the instanced draws
+	AllocatedBuffer instance_buffer{};
+	VkDeviceAddress instance_buffer_address{ 0 };
+	uint32_t instance_capacity{ 0 };
+
+	// object records, batch counters and draw commands of the gpu driven
+	// path, grown whenever a frame needs more
+	AllocatedBuffer object_buffer{};
+	AllocatedBuffer batch_buffer{};
+	AllocatedBuffer indirect_buffer{};
+	uint32_t object_capacity{ 0 };
+	uint32_t batch_capacity{ 0 };
+	// batches culled by the last submission, read back for the stats
+	uint32_t batches_written{ 0 };
+
+	// uniform data of the culling pass and the set pointing at it and the
+	// depth pyramid, the data is picked with a dynamic offset
+	VkDescriptorSet cull_descriptor;
+	uint32_t cull_data_offset{ 0 };
+	// what the culling pass rejected, read back like the batch counts
+	AllocatedBuffer cull_stats_buffer{};
+	bool cull_stats_written{ false };
 };
 
 constexpr unsigned int FRAME_OVERLAP = 2;
 
+// how the transparent pass composites blended surfaces
+enum class TransparencyMode : int {
+	// sorted back to front and blended straight into the draw image
+	Sorted,
+	// weighted blended order independent transparency: drawn in any order
+	// into accumulation and revealage targets, composited by a compute pass
+	WeightedBlended,
+};
+
+struct EngineOptions {
+	// render without a window or swapchain straight into the draw image
+	bool headless = false;
+	// number of frames rendered by a headless run
+	uint32_t frame_count = 1000;
+	// frames rendered before timings start being recorded
+	uint32_t warmup_frames = 10;
+	// name of the loaded node that is drawn
+	std::string scene = "Suzanne";
+	// file the headless report is written to, stdout if empty
+	std::string output_path;
+	// upload meshes as PackedVertex instead of Vertex
+	bool packed_vertices = false;
+	// cull on the gpu and draw every pipeline and material with one indirect
+	// call instead of one draw per object
+	bool gpu_driven = false;
+	// headless: check the gpu driven path against the cpu path instead of
+	// benchmarking. Needs the device features of gpu_driven.
+	bool compare_paths = false;
+	// gpu driven path only: draw what was visible last frame, build a depth
+	// pyramid from it and draw what it does not occlude in a second pass
+	bool occlusion_culling = false;
+	// cpu path only: rasterize small opaque meshes into a software depth
+	// buffer and drop the opaque surfaces they hide. Occluders are built
+	// while loading, so it cannot be turned on later.
+	bool cpu_occlusion = false;
+	// draw copies of a surface that share a material with one instanced draw
+	bool instancing = true;
+	// how many times the scene is drawn, side by side, to benchmark large
+	// draw counts
+	uint32_t scene_copies = 1;
+	// threads recording the draw list into secondary command buffers, 0
+	// records it on the main thread into the primary buffer. A headless run
+	// renders its frames once per entry.
+	std::vector<uint32_t> record_threads = { 0 };
+	// the last copies of the scene are drawn with a translucent material
+	uint32_t transparent_copies = 0;
+	// opaque materials the other copies cycle through, each with its own slot
+	// in the material registry. 0 draws them with the scene's own materials.
+	uint32_t scene_materials = 0;
+	// push the scene set with VK_KHR_push_descriptor if the device has it,
+	// instead of binding a set allocated from a pool
+	bool push_descriptors = true;
+	// lay down the depth of the opaque cpu draw list with a position only
+	// pass first, so the color pass shades every pixel once. A headless run
+	// renders its frames once per entry, and reports each entry and thread
+	// count as its own configuration. The gpu driven path only uses the
+	// first entry.
+	std::vector<bool> depth_prepass = { false };
+	TransparencyMode transparency = TransparencyMode::Sorted;
+};
+
+// timings of the last rendered frame
+struct EngineStats {
+	float frame_ms;
+	float record_ms;
+	// gpu timings come back FRAME_OVERLAP frames late, negative until then
+	float gpu_ms = -1.0f;
+	// bind calls of the geometry pass
+	CommandEncoderStats commands;
+	// frustum culling of the opaque surfaces
+	uint32_t objects_tested = 0;
+	uint32_t objects_visible = 0;
+	// on the gpu driven path the visible count comes back from the culling
+	// pass FRAME_OVERLAP frames late, and cull_ms is the cpu batching time
+	float cull_ms = 0.0f;
+	// transparent surfaces that passed culling, always culled on the cpu
+	uint32_t transparent_visible = 0;
+	// objects and triangles the gpu culling pass rejected, FRAME_OVERLAP
+	// frames late. Occlusion culling only counts with the depth pyramid on,
+	// or on the cpu path with the software occlusion buffer, without delay.
+	uint32_t frustum_culled = 0;
+	uint32_t frustum_culled_triangles = 0;
+	uint32_t occlusion_culled = 0;
+	uint32_t occlusion_culled_triangles = 0;
+	// software occlusion: setting up and rasterizing the occluders, and
+	// testing the frustum culled surfaces against them
+	float occlusion_raster_ms = 0.0f;
+	float occlusion_test_ms = 0.0f;
+};
+
 struct ComputePushConstants {
 	glm::vec4 data1;
 	glm::vec4 data2;
@@ -60,50 +202,113 @@ struct GPUSceneData {
 
 struct GLTFMetallic_Roughness {
 	MaterialPipeline opaque_pipeline;
+	MaterialPipeline depth_prepass_pipeline;
+	MaterialPipeline depth_equal_pipeline;
 	MaterialPipeline transparent_pipeline;
-
-	VkDescriptorSetLayout material_layout;
-
-	struct MaterialConstants {
-		glm::vec4 color_factors;
-		glm::vec4 metal_rough_factors;
-		// padding, we need it anyway for uniform buffers
-		glm::vec4 extra[4];
-	};
+	MaterialPipeline oit_transparent_pipeline;
+	MaterialPipeline indirect_opaque_pipeline;
 
 	struct MaterialResources {
 		AllocatedImage color_image;
 		VkSampler color_sampler;
 		AllocatedImage metal_roughness_image;
 		VkSampler metal_roughness_sampler;
-		VkBuffer data_buffer;
-		uint32_t data_buffer_offset;
+		glm::vec4 color_factors;
+		glm::vec4 metal_rough_factors;
 	};
 
-	DescriptorWriter writer;
-
 	void build_pipeline(VulkanEngine* engine);
 
 	void clear_resources(VkDevice device);
 
-	MaterialInstance write_material(VkDevice device, MaterialPass pass,
-			const MaterialResources& resources,
-			DescriptorAllocatorGrowable& descriptor_allocator);
+	// adds the material's textures and samplers to the bindless table and
+	// its constants to the registry
+	MaterialInstance write_material(MaterialPass pass,
+			const MaterialResources& resources, BindlessTable& bindless,
+			MaterialRegistry& registry);
 };
 
+// every mesh lives in the engine's geometry buffer, so a draw is fully
+// described by its offsets into it
 struct RenderObject {
+	// the GeoSurface id of what is drawn
+	uint32_t surface_id;
 	uint32_t index_count;
 	uint32_t first_index;
-	VkBuffer index_buffer;
+	int32_t vertex_offset;
+	VkIndexType index_type;
 
 	MaterialInstance* material;
+	// mesh space, transform takes it to the world
+	Bounds bounds;
 
 	glm::mat4 transform;
-	VkDeviceAddress vertex_buffer_address;
+	glm::vec3 position_offset;
+	glm::vec3 position_scale;
+};
+
+// sorted draws of the same surface and material, drawn with one instanced
+// draw. Their transforms are consecutive in the frame's instance buffer.
+struct InstanceGroup {
+	// the group's first draw in the surfaces of its draw list
+	uint32_t draw;
+	uint32_t first_instance;
+	uint32_t instance_count;
+};
+
+// a range of the indirect command buffer drawn by one
+// vkCmdDrawIndexedIndirectCount, with the state its draws share
+struct IndirectBatch {
+	MaterialInstance* material;
+	VkIndexType index_type;
+	uint32_t command_offset;
+	uint32_t max_count;
+};
+
+// the surfaces of one pass and what the cpu path derives from them
+struct DrawList {
+	std::vector<RenderObject> surfaces;
+
+	// surfaces that passed culling, their sort keys and the order they are
+	// drawn in
+	std::vector<uint32_t> visible;
+	std::vector<uint64_t> keys;
+	std::vector<uint32_t> order;
+
+	// the sorted draws merged into instanced draws
+	std::vector<InstanceGroup> groups;
+};
+
+// which of its material's pipelines a draw is recorded with
+enum class DrawVariant {
+	Color,
+	// the color pass over a depth prepass, tested for equal depth
+	DepthEqual,
+	// depth only, from the position stream
+	DepthPrepass,
+	// into the weighted blended transparency targets
+	WeightedBlended,
 };
 
 struct DrawContext {
-	std::vector<RenderObject> opaque_surfaces;
+	DrawList opaque;
+	DrawList transparent;
+
+	// transforms of the instance groups of both lists
+	std::vector<glm::mat4> instance_transforms;
+
+	// object records of the gpu driven path in batch order, and the batches
+	std::vector<GPUObjectRecord> gpu_objects;
+	std::vector<IndirectBatch> indirect_batches;
+
+	// meshes uploaded after this ticket are skipped until they are usable
+	UploadTicket usable_uploads;
+
+	// drawn instead of the surfaces' own material while set
+	MaterialInstance* material_override = nullptr;
+
+	// opaque meshes small enough to occlude on the cpu path
+	std::vector<OccluderInstance> occluders;
 };
 
 struct MeshNode : public Node {
@@ -117,7 +322,7 @@ public:
 	static VulkanEngine& get();
 
 	// initializes everything in the engine
-	void init();
+	void init(const EngineOptions& options = {});
 
 	// shuts down the engine
 	void cleanup();
@@ -125,19 +330,84 @@ public:
 	// run main loop
 	void run();
 
+	// render the configured amount of frames without presenting them and
+	// write the timings as json. False if the scene is unknown or the report
+	// could not be written.
+	bool run_headless();
+
+	// renders the scene on the cpu path and then on the gpu driven path and
+	// compares which objects each one drew, object by object. Writes the
+	// result as json. False if they disagree or the report could not be
+	// written.
+	bool run_path_comparison();
+
 	void update_scene();
 
-	GPUMeshBuffers upload_mesh(
-			std::span<uint32_t> indices, std::span<Vertex> vertices);
+	// collects the surfaces whose bounds intersect the view frustum and
+	// returns how many did
+	uint32_t cull_draws(DrawList& list);
+
+	// rasterizes the occluders and removes the visible surfaces of the list
+	// they hide, returns how many it removed
+	uint32_t cull_occluded(
+			DrawList& list, std::span<const OccluderInstance> occluders);
+
+	// builds the sort keys of the visible draws and sorts them by them, by
+	// state or back to front
+	void sort_draws(DrawList& list, bool back_to_front);
+
+	// merges runs of sorted draws that share surface and material, and
+	// appends their transforms
+	void group_instances(
+			DrawList& list, std::vector<glm::mat4>& instance_transforms);
+
+	// groups the surfaces into indirect batches and builds the object records
+	// the gpu culls, replaces cull_draws and sort_draws on the gpu driven path
+	void build_indirect_batches(DrawContext& ctx);
+
+	// starts recording uploads that are submitted together with a single
+	// submit
+	UploadBatch begin_upload();
+
+	void wait_upload(UploadTicket ticket);
+
+	// nothing if the geometry buffer has no room left for the mesh
+	std::optional<GPUMeshBuffers> upload_mesh(UploadBatch& batch,
+			std::span<const uint32_t> indices,
+			std::span<const Vertex> vertices,
+			std::span<const glm::vec3> positions);
+
+	std::optional<GPUMeshBuffers> upload_mesh(UploadBatch& batch,
+			std::span<const uint32_t> indices,
+			const PackedVertices& vertices);
 
 	AllocatedImage create_image(VkExtent3D size, VkFormat format,
 			VkImageUsageFlags usage, bool mipmapped = false);
 
-	AllocatedImage create_image(void* data, VkExtent3D size, VkFormat format,
-			VkImageUsageFlags usage, bool mipmapped = false);
+	AllocatedImage create_image(UploadBatch& batch, void* data,
+			VkExtent3D size, VkFormat format, VkImageUsageFlags usage,
+			bool mipmapped = false);
 
 	void destroy_image(const AllocatedImage& img);
 
+	// returns the mesh's geometry to the geometry buffer once the frames in
+	// flight are done with it
+	void destroy_mesh(const GPUMeshBuffers& mesh);
+
+	// ids are handed out in order, they fit the 24 bit mesh field of a draw
+	// key until there are more than 16M surfaces
+	uint32_t next_surface_id() { return _next_surface_id++; }
+
+	JobSystem& get_job_system() { return _job_system; }
+
+	VkDevice get_device() const { return _device; }
+
+	bool uses_packed_vertices() const { return _options.packed_vertices; }
+
+	// meshes only get an occluder when the software occlusion culling was
+	// asked for at startup
+	bool uses_cpu_occlusion() const { return _options.cpu_occlusion; }
+
 private:
 	void init_default_data();
 
@@ -147,6 +417,52 @@ private:
 
 	void draw_background(VkCommandBuffer cmd);
 
+	void set_draw_viewport(VkCommandBuffer cmd);
+
+	void upload_instances(FrameData& frame);
+
+	// binds or pushes the frame's scene set as set 0 of layout
+	void bind_scene_set(CommandEncoder& encoder, VkPipelineLayout layout,
+			const FrameData& frame);
+
+	// records the instance groups of surfaces with the variant's pipelines
+	void draw_instanced(CommandEncoder& encoder,
+			std::span<const RenderObject> surfaces,
+			std::span<const InstanceGroup> groups, DrawVariant variant);
+
+	// splits the opaque instance groups into one chunk per recording thread
+	// and executes the secondary buffers they were recorded into
+	void record_draws_parallel(VkCommandBuffer cmd, DrawVariant variant);
+
+	// renders the depth of the opaque draw list alone
+	void draw_depth_prepass(VkCommandBuffer cmd);
+
+	// uploads the object records and appends the visible ones to the
+	// indirect command buffer. With occlusion culling these are only the
+	// ones that were visible last frame.
+	void cull_indirect(VkCommandBuffer cmd);
+
+	void dispatch_cull(VkCommandBuffer cmd, CullPhase phase);
+
+	// draws the batches of the first culling phase, or those of the
+	// occlusion phase
+	void draw_indirect(CommandEncoder& encoder, CullPhase phase);
+
+	// levels of the depth pyramid the draw extent fills, each halves the one
+	// before rounding up, down to a single texel
+	uint32_t depth_pyramid_levels(VkExtent2D draw_extent) const;
+
+	// reduces the depth of the first phase into the depth pyramid
+	void build_depth_pyramid(VkCommandBuffer cmd);
+
+	// tests everything against the depth pyramid and draws what became
+	// visible over the first phase
+	void draw_occlusion_phase(VkCommandBuffer cmd);
+
+	// draws the transparent list over the opaque image, blended in order or
+	// through the weighted blended targets and their resolve
+	void draw_transparent(VkCommandBuffer cmd);
+
 	void init_vulkan();
 
 	void init_swapchain();
@@ -155,6 +471,31 @@ private:
 
 	void init_sync_structures();
 
+	void read_gpu_timings(FrameData& frame);
+
+	// per surface of the opaque draw list, 1 if the last gpu driven frame
+	// drew it. The device has to be idle.
+	std::vector<uint8_t> read_gpu_visibility();
+
+	// copies size bytes of a device buffer to data and waits for the copy,
+	// for checks outside of the frame loop only
+	void read_buffer(VkBuffer buffer, VkDeviceSize size, void* data);
+
+	// bump allocates value from the frame's uniform arena and returns its
+	// dynamic offset. The arena is sized for the scene data and the cull
+	// data, each written once per frame, and only takes those types.
+	template <typename T>
+	uint32_t write_uniform(FrameData& frame, const T& value);
+
+	void reserve_instance_buffer(FrameData& frame, uint32_t instance_count);
+
+	void reserve_indirect_buffers(
+			FrameData& frame, uint32_t object_count, uint32_t batch_count);
+
+	// resets the visibility of every object to visible whenever the object
+	// count changes, the records are only stable while it does not
+	void reserve_visibility_buffer(VkCommandBuffer cmd, uint32_t object_count);
+
 	void create_swapchain(uint32_t width, uint32_t height);
 
 	void destroy_swapchain();
@@ -169,9 +510,22 @@ private:
 
 	void init_mesh_pipeline();
 
+	void init_cull_pipeline();
+
+	void init_depth_pyramid();
+
+	void init_oit_resolve_pipeline();
+
+	void init_geometry_buffer();
+
 	AllocatedBuffer create_buffer(size_t alloc_size, VkBufferUsageFlags usage,
 			VmaMemoryUsage memory_usage);
 
+	std::optional<GPUMeshBuffers> upload_mesh_data(UploadBatch& batch,
+			std::span<const uint32_t> indices, const void* vertex_data,
+			const void* position_data, size_t vertex_count,
+			size_t vertex_size, size_t position_size);
+
 	void destroy_buffer(const AllocatedBuffer& buffer);
 
 	FrameData& get_current_frame() {
@@ -179,8 +533,19 @@ private:
 	};
 
 private:
+	EngineOptions _options;
+	EngineStats _stats;
+
 	bool _is_initialized{ false };
 	int _frame_number{ 0 };
+	// the entries of _options.record_threads and _options.depth_prepass
+	// currently in use
+	uint32_t _record_threads{ 0 };
+	bool _depth_prepass{ false };
+	bool _occlusion_culling{ false };
+	bool _cpu_occlusion{ false };
+	// the device has VK_KHR_push_descriptor and _options allow it
+	bool _push_descriptors{ false };
 	bool _stop_rendering{ false };
 	VkExtent2D _window_extent{ 1700, 900 };
 	bool _resize_requested{ false };
@@ -189,13 +554,20 @@ private:
 
 	DeletionQueue _deletion_queue;
 
+	JobSystem _job_system;
+
 	VkInstance _instance;
 	VkDebugUtilsMessengerEXT _debug_messenger;
 	VkPhysicalDevice _chosenGPU;
 	VkDevice _device;
-	VkSurfaceKHR _surface;
+	VkSurfaceKHR _surface{ VK_NULL_HANDLE };
 	VmaAllocator _allocator;
 
+	// nanoseconds per timestamp tick, zero if the queue has no timestamps
+	float _timestamp_period{ 0.0f };
+	VkDeviceSize _min_uniform_alignment{ 0 };
+	std::string _device_name;
+
 	VkSwapchainKHR _swapchain;
 	VkFormat _swapchain_image_format;
 
@@ -203,6 +575,11 @@ private:
 	AllocatedImage _draw_image;
 	AllocatedImage _depth_image;
 	VkExtent2D _draw_extent;
+
+	// weighted blended transparency targets, the size of the draw image
+	AllocatedImage _oit_accum_image;
+	AllocatedImage _oit_revealage_image;
+	TransparencyMode _transparency_mode{ TransparencyMode::Sorted };
 	float _render_scale = 1.0f;
 
 	std::vector<VkImage> _swapchain_images;
@@ -212,8 +589,15 @@ private:
 	FrameData _frames[FRAME_OVERLAP];
 	VkQueue _graphics_queue;
 	uint32_t _graphics_queue_family;
+	VkQueue _transfer_queue;
+	uint32_t _transfer_queue_family;
 
 	DescriptorAllocatorGrowable _global_descriptor_allocator;
+	// the sets allocated from _global_descriptor_allocator
+	DescriptorSetCache _descriptor_cache;
+	// set 1 of every mesh pipeline, its material buffer is the registry's
+	BindlessTable _bindless;
+	MaterialRegistry _material_registry;
 
 	VkDescriptorSet _draw_image_descriptors;
 	VkDescriptorSetLayout _draw_image_descriptor_layout;
@@ -223,6 +607,36 @@ private:
 	std::vector<ComputeEffect> _background_effects;
 	int _current_background_effect{ 0 };
 
+	GeometryBuffer _geometry_buffer;
+	uint32_t _next_surface_id{ 0 };
+
+	VkDescriptorSetLayout _cull_descriptor_layout;
+	VkPipelineLayout _cull_pipeline_layout;
+	VkPipeline _cull_pipeline;
+
+	// min depth pyramid of the first culling phase, one view and reduction
+	// set per level. Sized for the whole draw image, a smaller draw extent
+	// only uses part of it.
+	AllocatedImage _depth_pyramid;
+	std::vector<VkImageView> _depth_pyramid_views;
+	std::vector<VkDescriptorSet> _depth_reduce_descriptors;
+	VkDescriptorSetLayout _depth_reduce_descriptor_layout;
+	VkSampler _depth_pyramid_sampler;
+	VkPipelineLayout _depth_reduce_pipeline_layout;
+	VkPipeline _depth_reduce_pipeline;
+
+	// whether every object passed the last occlusion phase, shared by the
+	// frames in flight since their culling passes run in submission order
+	AllocatedBuffer _visibility_buffer{};
+	uint32_t _visibility_capacity{ 0 };
+	uint32_t _visibility_count{ 0 };
+
+	VkDescriptorSetLayout _oit_resolve_descriptor_layout;
+	VkDescriptorSet _oit_resolve_descriptors;
+	VkSampler _oit_sampler;
+	VkPipelineLayout _oit_resolve_pipeline_layout;
+	VkPipeline _oit_resolve_pipeline;
+
 	VkPipelineLayout _mesh_pipeline_layout;
 	VkPipeline _mesh_pipeline;
 
@@ -240,23 +654,31 @@ private:
 	VkSampler _default_sampler_linear;
 	VkSampler _default_sampler_nearest;
 
-	// default material
+	// default material, and a translucent variant of it
 	MaterialInstance _default_data;
+	MaterialInstance _default_transparent_data;
+	// what the copies of the scene cycle through with scene_materials set
+	std::vector<MaterialInstance> _scene_materials;
 	GLTFMetallic_Roughness _metal_rough_material;
 
 	DrawContext _main_draw_context;
+	DrawSorter _draw_sorter;
+	// culling scratch memory, kept between frames
+	SphereBatch _cull_spheres;
+	std::vector<uint8_t> _cull_visibility;
+	// software occlusion, the triangles of every occluder and whether each
+	// visible surface is occluded
+	OcclusionBuffer _occlusion_buffer;
+	std::vector<std::vector<OccluderTriangle>> _occluder_triangles;
+	std::vector<uint8_t> _occlusion_results;
 	std::unordered_map<std::string, std::shared_ptr<Node>> _loaded_nodes;
 
 	friend struct GLTFMetallic_Roughness;
 
 private:
-	VkFence _imm_fence;
-	VkCommandBuffer _imm_command_buffer;
-	VkCommandPool _imm_command_pool;
+	UploadContext _upload_context;
 
 	void init_imgui();
 
 	void draw_imgui(VkCommandBuffer cmd, VkImageView target_image_view);
-
-	void immediate_submit(std::function<void(VkCommandBuffer cmd)>&& function);
 };
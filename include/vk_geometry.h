@@ -0,0 +1,74 @@
+#pragma once
+
+#include "vk_types.h"
+
+#include <map>
+
+// hands out ranges of a fixed size address space. Freed ranges go back to an
+// offset ordered free list and are merged with their neighbours, so the
+// space can be reused as meshes are loaded and unloaded.
+class RangeAllocator {
+public:
+	void init(uint64_t capacity);
+
+	// first fit, nothing if no free range is large enough
+	std::optional<uint64_t> allocate(uint64_t size, uint64_t alignment = 1);
+
+	void free(uint64_t offset, uint64_t size);
+
+	uint64_t capacity() const { return _capacity; }
+	uint64_t used() const { return _used; }
+
+private:
+	// offset to size of every free range
+	std::map<uint64_t, uint64_t> _free_ranges;
+	uint64_t _capacity{ 0 };
+	uint64_t _used{ 0 };
+};
+
+// one vertex buffer and one index buffer every mesh is suballocated from, so
+// draws only differ in their offsets and the index buffer is bound once. A
+// position only stream runs parallel to the vertex buffer, vertex i of either
+// belongs to the same vertex.
+class GeometryBuffer {
+public:
+	void init(VkDevice device, VmaAllocator allocator, uint32_t vertex_stride,
+			uint32_t position_stride, VkDeviceSize vertex_capacity,
+			VkDeviceSize index_capacity);
+
+	void destroy();
+
+	// nothing if either buffer is out of space
+	std::optional<GeometryAllocation> allocate(
+			uint32_t vertex_count, VkDeviceSize index_size);
+
+	void free(const GeometryAllocation& allocation);
+
+	VkBuffer vertex_buffer() const { return _vertex_buffer.buffer; }
+	VkDeviceAddress vertex_buffer_address() const { return _vertex_address; }
+	VkBuffer position_buffer() const { return _position_buffer.buffer; }
+	VkDeviceAddress position_buffer_address() const {
+		return _position_address;
+	}
+	VkBuffer index_buffer() const { return _index_buffer.buffer; }
+
+	uint32_t vertex_stride() const { return _vertex_stride; }
+	uint32_t position_stride() const { return _position_stride; }
+
+private:
+	VmaAllocator _allocator;
+
+	AllocatedBuffer _vertex_buffer;
+	VkDeviceAddress _vertex_address;
+	AllocatedBuffer _position_buffer;
+	VkDeviceAddress _position_address;
+	AllocatedBuffer _index_buffer;
+
+	uint32_t _vertex_stride;
+	uint32_t _position_stride;
+
+	// in vertices
+	RangeAllocator _vertex_ranges;
+	// in bytes
+	RangeAllocator _index_ranges;
+};
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// fixed pool of worker threads for data parallel loops. The thread calling
+// parallel_for works on the items as well, so a pool of N threads starts N - 1
+// workers. parallel_for must not be called from inside a job or from more
+// than one thread at a time.
+class JobSystem {
+public:
+	void init(uint32_t thread_count);
+
+	void shutdown();
+
+	uint32_t thread_count() const { return (uint32_t)_workers.size() + 1; }
+
+	// runs fn(i) for every i in [0, count) and returns once all of them are
+	// done. Items are handed out dynamically, in no particular order.
+	void parallel_for(size_t count, const std::function<void(size_t)>& fn);
+
+private:
+	void worker_loop();
+
+	void run_items();
+
+	std::vector<std::thread> _workers;
+
+	std::mutex _mutex;
+	std::condition_variable _wake;
+	std::condition_variable _done;
+
+	const std::function<void(size_t)>* _fn{ nullptr };
+	size_t _count{ 0 };
+	std::atomic<size_t> _next{ 0 };
+
+	uint64_t _generation{ 0 };
+	uint32_t _busy_workers{ 0 };
+	bool _stop{ false };
+};
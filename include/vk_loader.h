@@ -9,21 +9,54 @@ struct GLTFMaterial {
 	MaterialInstance data;
 };
 
+// mesh space bounds of a surface, an aabb and a sphere around the same center
+struct Bounds {
+	glm::vec3 origin;
+	float sphere_radius;
+	glm::vec3 extents;
+};
+
 struct GeoSurface {
 	uint32_t start_index;
 	uint32_t count;
+	Bounds bounds;
 	std::shared_ptr<GLTFMaterial> material;
+	// identifies the surface among all uploaded ones, set by the engine when
+	// its mesh is uploaded
+	uint32_t id = 0;
 };
 
+// defined in vk_occlusion.h, which needs the types of this header
+struct OccluderMesh;
+
 struct MeshAsset {
 	std::string name;
 
 	std::vector<GeoSurface> surfaces;
 	GPUMeshBuffers mesh_buffers;
+
+	// what the mesh hides from the software occlusion culling, null if it
+	// has too many triangles
+	std::shared_ptr<OccluderMesh> occluder;
+};
+
+// cpu side geometry of a mesh, ready to be uploaded
+struct MeshData {
+	std::string name;
+
+	std::vector<GeoSurface> surfaces;
+	std::vector<uint32_t> indices;
+	std::vector<Vertex> vertices;
 };
 
 // forward declaration
 class VulkanEngine;
+class JobSystem;
+
+// decodes every mesh of a glTF binary. Primitives are decoded in parallel on
+// the job system if one is given, the result does not depend on it.
+std::optional<std::vector<MeshData>> decode_gltf_meshes(
+		std::filesystem::path file_path, JobSystem* job_system = nullptr);
 
 std::optional<std::vector<std::shared_ptr<MeshAsset>>> load_gltf_meshes(
 		VulkanEngine* engine, std::filesystem::path file_path);
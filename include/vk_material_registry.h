@@ -0,0 +1,93 @@
+#pragma once
+
+#include "vk_types.h"
+
+#include <map>
+#include <span>
+
+// material slots written since the last flush, kept as disjoint ranges so a
+// flush copies each run of edited materials with one region
+class DirtyRanges {
+public:
+	// merges with every range it overlaps or touches
+	void add(uint32_t first, uint32_t count);
+
+	void clear() { _ranges.clear(); }
+
+	bool empty() const { return _ranges.empty(); }
+
+	// first slot to one past the last of every range, in slot order
+	const std::map<uint32_t, uint32_t>& ranges() const { return _ranges; }
+
+private:
+	std::map<uint32_t, uint32_t> _ranges;
+};
+
+// copies the dirty materials into staging, packed in slot order, and appends
+// one copy region per range from there into the material buffer. Returns the
+// bytes written.
+VkDeviceSize pack_dirty_materials(std::span<const GPUMaterial> materials,
+		const DirtyRanges& dirty, std::byte* staging,
+		std::vector<VkBufferCopy>& regions);
+
+struct MaterialRegistryStats {
+	uint32_t material_count = 0;
+	uint32_t capacity = 0;
+	// the material buffer and the staging buffers of every frame, and how
+	// many allocations they take no matter how many materials there are
+	VkDeviceSize device_bytes = 0;
+	VkDeviceSize staging_bytes = 0;
+	uint32_t allocations = 0;
+	// what the last flush copied
+	uint32_t flushed_materials = 0;
+	uint32_t copy_regions = 0;
+};
+
+// the constants of every material in one device local buffer. A material
+// keeps its slot for the lifetime of the registry, so its index can be baked
+// into draws. Adds and edits go to a cpu copy first and are copied to the
+// gpu by the next flush, with a single copy command for all of them.
+class MaterialRegistry {
+public:
+	// one staging buffer per frame in flight, each large enough to rewrite
+	// every slot
+	void init(VmaAllocator allocator, uint32_t capacity, uint32_t frame_count);
+
+	// the material buffer and the staging buffers, whatever the capacity
+	static uint32_t allocation_count(uint32_t frame_count) {
+		return 1 + frame_count;
+	}
+
+	void destroy();
+
+	// nothing if every slot is taken
+	std::optional<uint32_t> add(const GPUMaterial& material);
+
+	void update(uint32_t index, const GPUMaterial& material);
+
+	const GPUMaterial& get(uint32_t index) const { return _materials[index]; }
+
+	// records the copy of everything added or edited since the last flush
+	// into cmd, followed by a barrier for the shaders that read materials.
+	// The frame's previous flush must have completed.
+	void flush(VkCommandBuffer cmd, uint32_t frame_index);
+
+	VkBuffer buffer() const { return _buffer.buffer; }
+	VkDeviceSize size() const { return _capacity * sizeof(GPUMaterial); }
+
+	const MaterialRegistryStats& stats() const { return _stats; }
+
+private:
+	VmaAllocator _allocator;
+	uint32_t _capacity{ 0 };
+
+	std::vector<GPUMaterial> _materials;
+	DirtyRanges _dirty;
+
+	AllocatedBuffer _buffer;
+	std::vector<AllocatedBuffer> _staging;
+	// scratch, kept between flushes
+	std::vector<VkBufferCopy> _regions;
+
+	MaterialRegistryStats _stats;
+};
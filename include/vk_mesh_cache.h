@@ -0,0 +1,64 @@
+#pragma once
+
+#include "vk_loader.h"
+
+#include <filesystem>
+
+// read only memory mapping of a whole file
+class MappedFile {
+public:
+	MappedFile() = default;
+	~MappedFile() { close(); }
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool open(const std::filesystem::path& path);
+
+	void close();
+
+	const std::byte* data() const { return _data; }
+	size_t size() const { return _size; }
+
+private:
+	const std::byte* _data{ nullptr };
+	size_t _size{ 0 };
+#ifdef _WIN32
+	void* _file{ nullptr };
+	void* _mapping{ nullptr };
+#endif
+};
+
+// geometry of a mesh that lives somewhere else, either decoded MeshData or a
+// mapped cache file
+struct MeshView {
+	std::string name;
+
+	std::vector<GeoSurface> surfaces;
+	std::span<const uint32_t> indices;
+	std::span<const Vertex> vertices;
+};
+
+// the cache of a source file lives right next to it
+std::filesystem::path mesh_cache_path(const std::filesystem::path& source);
+
+// a .vkmesh file holds the decoded meshes of a source file, laid out so the
+// vertex and index arrays can be copied from the mapping straight into
+// staging memory. It is only valid for the source whose key it was written
+// with, and for the loader version that wrote it.
+class MeshCache {
+public:
+	// maps the cache and checks it against the key, false if it is missing,
+	// stale or malformed
+	bool open(const std::filesystem::path& path, uint64_t key);
+
+	// the spans point into the mapping and stay valid while the cache is open
+	const std::vector<MeshView>& meshes() const { return _meshes; }
+
+	static bool write(const std::filesystem::path& path, uint64_t key,
+			const std::vector<MeshData>& meshes);
+
+private:
+	MappedFile _file;
+	std::vector<MeshView> _meshes;
+};
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "vk_loader.h"
+
+// post-transform vertex cache size the index order is optimized for, and
+// that the statistics simulate. Small enough to be pessimistic on every gpu.
+constexpr uint32_t VERTEX_CACHE_SIZE = 16;
+
+struct VertexCacheStats {
+	uint32_t vertices;
+	uint32_t triangles;
+	uint32_t cache_misses;
+
+	// average cache miss ratio, vertices transformed per triangle. 0.5 is
+	// the best possible on a regular grid, 3 is no reuse at all.
+	float acmr() const {
+		return triangles ? (float)cache_misses / triangles : 0.0f;
+	}
+
+	// average transform to vertex ratio, 1 means every vertex is
+	// transformed exactly once
+	float atvr() const {
+		return vertices ? (float)cache_misses / vertices : 0.0f;
+	}
+};
+
+// simulates a fifo post-transform cache over every surface of the mesh
+VertexCacheStats analyze_vertex_cache(
+		const MeshData& mesh, uint32_t cache_size = VERTEX_CACHE_SIZE);
+
+// merges bitwise identical vertices
+void deduplicate_vertices(MeshData& mesh);
+
+// reorders the triangles of every surface for post-transform cache reuse
+// (tipsify), then reorders the clusters it produces so outward facing ones
+// are drawn first, to reduce overdraw
+void optimize_vertex_cache(MeshData& mesh);
+
+// renumbers vertices in the order the index buffer first uses them, so
+// vertex fetch walks memory mostly linearly
+void optimize_vertex_fetch(MeshData& mesh);
+
+// runs every stage above in the order they depend on each other. Surface
+// ranges are kept, only the triangles inside each surface move.
+void optimize_mesh(MeshData& mesh);
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "vk_culling.h"
+#include "vk_loader.h"
+
+// meshes with more triangles are too expensive to rasterize on the cpu every
+// frame and do not get an occluder
+constexpr uint32_t OCCLUDER_MAX_TRIANGLES = 2048;
+
+// mesh space triangles a mesh hides what is behind it with
+struct OccluderMesh {
+	std::vector<glm::vec3> positions;
+	std::vector<uint32_t> indices;
+};
+
+// the occluder of a mesh, nothing if it has more than OCCLUDER_MAX_TRIANGLES
+std::optional<OccluderMesh> build_occluder(
+		std::span<const Vertex> vertices, std::span<const uint32_t> indices);
+
+// an occluder placed in the world by the scene walk
+struct OccluderInstance {
+	const OccluderMesh* mesh;
+	glm::mat4 transform;
+};
+
+// a screen space triangle set up for rasterization, edge functions and depth
+// plane in pixels
+struct OccluderTriangle {
+	// a * x + b * y + c, positive inside
+	float edge_a[3];
+	float edge_b[3];
+	float edge_c[3];
+	// depth = depth_a * x + depth_b * y + depth_c
+	float depth_a;
+	float depth_b;
+	float depth_c;
+	// smallest depth of the vertices, the plane is clamped to it
+	float min_depth;
+	// tiles the triangle touches, inclusive
+	uint16_t tile_min_x;
+	uint16_t tile_min_y;
+	uint16_t tile_max_x;
+	uint16_t tile_max_y;
+};
+
+// low resolution depth of the occluders in the style of masked software
+// occlusion culling (Hasselgren et al. 2016). Every 8x4 pixel tile keeps a
+// depth that holds for all its pixels, and a second one for the pixels in
+// its coverage mask that is merged into the first once the mask is full.
+// Depth follows the engine's depth test, greater values win.
+class OcclusionBuffer {
+public:
+	static constexpr uint32_t TILE_WIDTH = 8;
+	static constexpr uint32_t TILE_HEIGHT = 4;
+
+	// rounded up to whole tiles
+	void init(uint32_t width, uint32_t height);
+
+	// nothing occludes anything
+	void clear();
+
+	// transforms the occluder and appends its triangles that are in front
+	// of the camera and on screen
+	void setup_triangles(const OccluderMesh& mesh, const glm::mat4& mvp,
+			std::vector<OccluderTriangle>& out) const;
+
+	// rasterizes the triangles into the tile rows [first_row, end_row).
+	// Disjoint row ranges can be rasterized by different threads at once.
+	void rasterize(std::span<const OccluderTriangle> triangles,
+			uint32_t first_row, uint32_t end_row,
+			CullingKernel kernel = best_culling_kernel());
+
+	// true if the box is behind the occluders at every pixel it covers
+	bool is_occluded(const Bounds& bounds, const glm::mat4& mvp) const;
+
+	uint32_t width() const { return _tiles_x * TILE_WIDTH; }
+	uint32_t height() const { return _tiles_y * TILE_HEIGHT; }
+	uint32_t tile_rows() const { return _tiles_y; }
+
+private:
+	struct Tile {
+		// depth[0] holds for the whole tile, depth[1] for the mask
+		float depth[2];
+		uint32_t mask;
+	};
+
+	void update_tile(Tile& tile, uint32_t coverage, float depth);
+
+	uint32_t _tiles_x{ 0 };
+	uint32_t _tiles_y{ 0 };
+	std::vector<Tile> _tiles;
+};
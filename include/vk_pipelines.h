@@ -11,6 +11,8 @@ struct PipelineBuilder {
 
 	VkPipeline build_pipeline(VkDevice device);
 
+	// no fragment shader if fragment_shader is VK_NULL_HANDLE, for depth
+	// only pipelines
 	void set_shaders(
 			VkShaderModule vertex_shader, VkShaderModule fragment_shader);
 
@@ -30,6 +32,15 @@ struct PipelineBuilder {
 
 	void set_color_attachment_format(VkFormat format);
 
+	// renders into the depth attachment alone
+	void clear_color_attachments();
+
+	// two color attachments for weighted blended order independent
+	// transparency. The first accumulates weighted premultiplied color and
+	// coverage, the second multiplies up the revealage, 1 - alpha.
+	void set_weighted_blended_attachments(
+			VkFormat accum_format, VkFormat revealage_format);
+
 	void set_depth_format(VkFormat format);
 
 	void enable_depthtest(bool depth_write_enable, VkCompareOp op);
@@ -41,11 +52,11 @@ private:
 
 	VkPipelineInputAssemblyStateCreateInfo _input_assembly;
 	VkPipelineRasterizationStateCreateInfo _rasterizer;
-	VkPipelineColorBlendAttachmentState _color_blend_attachment;
+	VkPipelineColorBlendAttachmentState _color_blend_attachments[2];
 	VkPipelineMultisampleStateCreateInfo _multisampling;
 	VkPipelineDepthStencilStateCreateInfo _depth_stencil;
 	VkPipelineRenderingCreateInfo _render_info;
-	VkFormat _color_attachment_format;
+	VkFormat _color_attachment_formats[2];
 };
 
 namespace vkutil {
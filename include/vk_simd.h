@@ -0,0 +1,25 @@
+#pragma once
+
+// what the simd kernels of the culling code are compiled with. The kernels
+// multiply and add separately and never fuse them, so every kernel rounds
+// exactly like the scalar one and their results can be compared bit for bit.
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) ||           \
+		defined(_M_IX86)
+#define CULLING_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#else
+#define CULLING_X86 0
+#endif
+
+// gcc and clang compile the avx2 kernels for that target only, so the rest of
+// the engine keeps running on cpus without it. msvc allows the intrinsics
+// anywhere.
+#if CULLING_X86 && (defined(__GNUC__) || defined(__clang__))
+#define CULLING_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define CULLING_TARGET_AVX2
+#endif
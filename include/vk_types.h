@@ -49,11 +49,56 @@ struct Vertex {
 	glm::vec4 color;
 };
 
+// opt-in compressed vertex, 16 bytes instead of 48. Positions are unorm16
+// inside the mesh bounds, normals octahedral snorm8, uvs half floats and
+// colors unorm8. The shader reads it as a uvec4.
+struct PackedVertex {
+	uint16_t position[3];
+	int8_t normal[2];
+	uint16_t uv[2];
+	uint8_t color[4];
+};
+static_assert(sizeof(PackedVertex) == 16);
+
+// position only stream of packed meshes, the position of the PackedVertex
+// padded to 8 bytes. Meshes with full vertices use a stream of glm::vec3.
+struct PackedPosition {
+	uint16_t position[3];
+	uint16_t padding;
+};
+static_assert(sizeof(PackedPosition) == 8);
+
+// identifies a submission of the upload context, values only ever increase so
+// a ticket is complete once every submission up to it has been executed
+struct UploadTicket {
+	uint64_t value = 0;
+};
+
+// ranges of a mesh inside the engine's geometry buffer
+struct GeometryAllocation {
+	uint32_t first_vertex;
+	uint32_t vertex_count;
+	VkDeviceSize index_offset;
+	VkDeviceSize index_size;
+};
+
 // holds the resources needed for a mesh
 struct GPUMeshBuffers {
-	AllocatedBuffer index_buffer;
-	AllocatedBuffer vertex_buffer;
-	VkDeviceAddress vertex_buffer_address;
+	GeometryAllocation geometry;
+	// 16 bit whenever the vertex count allows it
+	VkIndexType index_type;
+	// where the mesh starts, in elements of its index type and vertex format,
+	// as passed to vkCmdDrawIndexed
+	uint32_t first_index;
+	int32_t vertex_offset;
+	// the buffers must not be drawn before the upload is usable
+	UploadTicket upload_ticket;
+
+	// maps the unorm positions of a packed vertex buffer back to mesh space,
+	// position = offset + unorm * scale
+	bool packed_vertices = false;
+	glm::vec3 position_offset{ 0.f };
+	glm::vec3 position_scale{ 1.f };
 };
 
 // push constants for our mesh object draws
@@ -62,6 +107,121 @@ struct GPUDrawPushConstants {
 	VkDeviceAddress vertex_buffer;
 };
 
+// push constants for the scene's mesh draws, the shader reads the transform
+// of every instance from the instance buffer at gl_InstanceIndex
+struct GPUInstancedDrawPushConstants {
+	VkDeviceAddress vertex_buffer;
+	VkDeviceAddress instance_buffer;
+	// into the bindless material buffer
+	uint32_t material_index;
+};
+
+// push constants for draws of meshes with packed vertices
+struct GPUPackedDrawPushConstants {
+	glm::vec4 position_offset;
+	glm::vec4 position_scale;
+	VkDeviceAddress vertex_buffer;
+	VkDeviceAddress instance_buffer;
+	uint32_t material_index;
+};
+
+// everything the culling compute shader and the indirect draws need to know
+// about an object, matches ObjectRecord in object_records.glsl
+struct GPUObjectRecord {
+	glm::mat4 transform;
+	// mesh space bounding sphere, origin in xyz and radius in w
+	glm::vec4 sphere;
+	glm::vec4 position_offset;
+	glm::vec4 position_scale;
+	uint32_t index_count;
+	uint32_t first_index;
+	int32_t vertex_offset;
+	// indirect batch the object is drawn by
+	uint32_t batch;
+};
+
+// draw count the culling shader appends to, followed by where the batch's
+// commands start. The count is read by vkCmdDrawIndexedIndirectCount.
+struct GPUDrawBatch {
+	uint32_t count;
+	uint32_t command_offset;
+};
+
+// which objects a dispatch of the culling shader appends, matches the PHASE_
+// constants of cull.comp
+enum class CullPhase : uint32_t {
+	// every object in the frustum, occlusion culling is off
+	Frustum = 0,
+	// objects in the frustum that were visible last frame, drawn before the
+	// depth pyramid is built
+	LastVisible = 1,
+	// tests every object against the depth pyramid of the first phase and
+	// appends the ones that just became visible
+	Occlusion = 2,
+};
+
+// uniform data of the culling shader, written to the frame's uniform arena
+struct GPUCullData {
+	glm::mat4 viewproj;
+	glm::vec4 frustum_planes[6];
+	// size of the rendered area, and of the first level of the depth pyramid
+	// built from it
+	glm::vec2 draw_extent;
+	glm::vec2 pyramid_extent;
+	uint32_t pyramid_levels;
+};
+
+// push constants of the culling compute shader
+struct GPUCullPushConstants {
+	VkDeviceAddress object_buffer;
+	VkDeviceAddress batch_buffer;
+	VkDeviceAddress command_buffer;
+	VkDeviceAddress visibility_buffer;
+	VkDeviceAddress stats_buffer;
+	uint32_t object_count;
+	uint32_t batch_count;
+	CullPhase phase;
+};
+
+// what the culling shader rejected in a frame, the objects that passed are
+// the draw counts of the batches
+struct GPUCullStats {
+	uint32_t frustum_culled;
+	uint32_t frustum_culled_triangles;
+	uint32_t occlusion_culled;
+	uint32_t occlusion_culled_triangles;
+};
+
+// push constants of the depth pyramid reduction, one dispatch per level
+struct GPUDepthReducePushConstants {
+	glm::ivec2 source_extent;
+	glm::ivec2 destination_extent;
+};
+
+// push constants of the indirect draws, the first instance of every command
+// is the object record the draw reads its transform from
+struct GPUIndirectDrawPushConstants {
+	VkDeviceAddress vertex_buffer;
+	VkDeviceAddress object_buffer;
+	// of the batch, every object of a batch shares its material
+	uint32_t material_index;
+};
+
+// constants of a material in the bindless material buffer, with the indices
+// of its textures and samplers in the bindless arrays
+struct GPUMaterial {
+	glm::vec4 color_factors;
+	glm::vec4 metal_rough_factors;
+	uint32_t color_texture;
+	uint32_t color_sampler;
+	uint32_t metal_rough_texture;
+	uint32_t metal_rough_sampler;
+};
+
+struct GPUOITResolvePushConstants {
+	glm::ivec2 extent;
+};
+
 enum class MaterialPass : uint8_t {
 	MainColor,
 	Transparent,
@@ -71,12 +231,26 @@ enum class MaterialPass : uint8_t {
 struct MaterialPipeline {
 	VkPipeline pipeline;
 	VkPipelineLayout layout;
+	// small dense number the draw sort keys group by
+	uint32_t id;
 };
 
 struct MaterialInstance {
 	MaterialPipeline* pipeline;
-	VkDescriptorSet material_set;
+	// same pipeline state, fed by the indirect draws of the gpu driven path.
+	// Only opaque materials have one.
+	MaterialPipeline* indirect_pipeline;
+	// writes the weighted blended transparency targets instead of blending,
+	// only transparent materials have one
+	MaterialPipeline* oit_pipeline;
+	// depth only from the position stream, and the color pass drawn over
+	// its depth with an equal test. Only opaque materials have them.
+	MaterialPipeline* depth_prepass_pipeline;
+	MaterialPipeline* depth_equal_pipeline;
 	MaterialPass pass_type;
+	// slot of the material's constants in the material registry, small and
+	// dense so the draw sort keys group by it as well
+	uint32_t id;
 };
 
 struct DrawContext;
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "vk_types.h"
+
+#include <cstring>
+
+// a piece of a uniform arena, written through the persistent mapping
+struct UniformAllocation {
+	uint32_t offset;
+	void* data;
+};
+
+// persistently mapped uniform buffer handed out front to back. Every frame in
+// flight owns one and resets it once its fence has been waited on, so an
+// allocation is only an offset bump. Offsets are aligned for use as dynamic
+// uniform buffer offsets.
+class UniformArena {
+public:
+	void init(VmaAllocator allocator, VkDeviceSize size,
+			VkDeviceSize min_offset_alignment);
+
+	void destroy();
+
+	// the gpu must be done with everything allocated so far
+	void reset() { _used = 0; }
+
+	// nothing if the arena is full
+	std::optional<UniformAllocation> allocate(VkDeviceSize size);
+
+	// copies value into a new allocation and returns its offset
+	template <typename T> std::optional<uint32_t> write(const T& value) {
+		std::optional<UniformAllocation> allocation = allocate(sizeof(T));
+		if (!allocation.has_value()) {
+			return {};
+		}
+		memcpy(allocation->data, &value, sizeof(T));
+		return allocation->offset;
+	}
+
+	VkBuffer buffer() const { return _buffer.buffer; }
+	VkDeviceSize size() const { return _size; }
+	VkDeviceSize used() const { return _used; }
+
+private:
+	VmaAllocator _allocator;
+	AllocatedBuffer _buffer;
+	std::byte* _mapped{ nullptr };
+
+	VkDeviceSize _size{ 0 };
+	VkDeviceSize _alignment{ 1 };
+	VkDeviceSize _used{ 0 };
+};
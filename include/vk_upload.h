@@ -0,0 +1,133 @@
+#pragma once
+
+#include "vk_types.h"
+
+class UploadContext;
+
+// records staging copies into the upload context's current command buffer
+// until it is submitted. Data is copied into staging memory immediately, so
+// the source can be released as soon as the call returns.
+class UploadBatch {
+public:
+	void copy_to_buffer(VkBuffer dst, VkDeviceSize dst_offset,
+			const void* data, size_t size);
+
+	// copies tightly packed texels into the first mip level of the image and
+	// leaves the whole image in shader read only layout
+	void copy_to_image(
+			const AllocatedImage& image, const void* data, size_t size);
+
+	// submits everything recorded so far without waiting for it
+	UploadTicket submit();
+
+private:
+	friend class UploadContext;
+
+	explicit UploadBatch(UploadContext* context) : _context(context) {}
+
+	UploadContext* _context;
+};
+
+// owns a persistently mapped staging ring that batches suballocate from.
+// Uploads run on their own queue when the device has a separate transfer
+// family, in which case the resources are released to the graphics family
+// and only become usable once a frame recorded the matching acquire.
+// Completion is tracked with a timeline semaphore.
+class UploadContext {
+public:
+	void init(VkDevice device, VmaAllocator allocator, VkQueue queue,
+			uint32_t queue_family, uint32_t graphics_queue_family,
+			VkDeviceSize staging_size);
+
+	void destroy();
+
+	UploadBatch begin_batch();
+
+	bool is_complete(UploadTicket ticket);
+
+	void wait(UploadTicket ticket);
+
+	// records the ownership acquires of every completed upload into a
+	// graphics command buffer, returns the value its submit has to wait for
+	// on the timeline semaphore, zero if there is nothing to wait for
+	UploadTicket record_acquires(VkCommandBuffer cmd);
+
+	// newest ticket whose resources the graphics queue can use
+	UploadTicket usable_ticket() const;
+
+	VkSemaphore timeline_semaphore() const { return _timeline; }
+
+private:
+	friend class UploadBatch;
+
+	struct StagingAllocation {
+		VkBuffer buffer;
+		VkDeviceSize offset;
+		void* data;
+	};
+
+	struct Submission {
+		uint64_t value;
+		VkCommandBuffer cmd;
+		// ring position released once the submission has completed
+		uint64_t ring_end;
+		// dedicated staging buffers for uploads larger than the ring
+		std::vector<AllocatedBuffer> oversized_buffers;
+	};
+
+	// acquire half of the ownership transfers released by a submission
+	struct PendingAcquire {
+		uint64_t value;
+		std::vector<VkBufferMemoryBarrier2> buffer_barriers;
+		std::vector<VkImageMemoryBarrier2> image_barriers;
+	};
+
+	bool transfers_ownership() const {
+		return _queue_family != _graphics_queue_family;
+	}
+
+	StagingAllocation allocate_staging(VkDeviceSize size);
+
+	VkCommandBuffer get_recording_cmd();
+
+	void release_buffer(VkBuffer buffer, VkDeviceSize offset,
+			VkDeviceSize size);
+
+	void release_image(VkImage image);
+
+	UploadTicket flush();
+
+	// releases the resources of every completed submission
+	void retire();
+
+	void wait_oldest();
+
+	VkDevice _device;
+	VmaAllocator _allocator;
+	VkQueue _queue;
+	uint32_t _queue_family;
+	uint32_t _graphics_queue_family;
+
+	VkCommandPool _command_pool;
+	std::vector<VkCommandBuffer> _free_cmds;
+
+	VkSemaphore _timeline;
+
+	AllocatedBuffer _ring;
+	VkDeviceSize _ring_size;
+	// monotonic byte positions, the ring offset is position % ring size
+	uint64_t _ring_head;
+	uint64_t _ring_tail;
+
+	VkCommandBuffer _recording_cmd;
+	std::vector<AllocatedBuffer> _recording_oversized_buffers;
+	// release barriers of the batch, recorded right before it is submitted
+	std::vector<VkBufferMemoryBarrier2> _recording_buffer_releases;
+	std::vector<VkImageMemoryBarrier2> _recording_image_releases;
+
+	std::deque<Submission> _in_flight;
+	std::deque<PendingAcquire> _pending_acquires;
+	uint64_t _last_submitted;
+	uint64_t _last_completed;
+	uint64_t _last_acquired;
+};
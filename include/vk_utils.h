@@ -7,4 +7,8 @@ namespace vkutil {
 glm::mat4 make_inf_reversed_z_proj_rh(
 		float fov_y_radians, float aspect_wby_h, float z_near);
 
+// 64 bit FNV-1a, eight bytes at a time
+uint64_t hash_bytes(
+		const void* data, size_t size, uint64_t seed = 0xcbf29ce484222325ull);
+
 }
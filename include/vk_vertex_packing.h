@@ -0,0 +1,27 @@
+#pragma once
+
+#include "vk_types.h"
+
+struct PackedVertices {
+	std::vector<PackedVertex> vertices;
+	// the same positions alone, for the depth prepass
+	std::vector<PackedPosition> positions;
+
+	// bounds the positions are quantized in, see GPUMeshBuffers
+	glm::vec3 position_offset;
+	glm::vec3 position_scale;
+};
+
+PackedVertices pack_vertices(std::span<const Vertex> vertices);
+
+// tightly packed positions of full vertices, for the depth prepass
+std::vector<glm::vec3> extract_positions(std::span<const Vertex> vertices);
+
+// cpu mirror of the decode in mesh_packed.vert
+Vertex unpack_vertex(const PackedVertex& packed,
+		const glm::vec3& position_offset, const glm::vec3& position_scale);
+
+// octahedral mapping of a unit vector onto [-1, 1]^2 and back
+glm::vec2 encode_octahedral(const glm::vec3& n);
+
+glm::vec3 decode_octahedral(const glm::vec2& e);
@@ -10,12 +10,28 @@ layout(set = 0, binding = 0) uniform SceneData {
     vec4 sunlight_color;
 } scene_data;
 
-layout(set = 1, binding = 0) uniform GLTFMaterialData {
+// the bindless table, sizes match vk_bindless.h
+#define BINDLESS_MAX_TEXTURES 4096
+#define BINDLESS_MAX_SAMPLERS 32
+
+// GPUMaterial
+struct Material {
     vec4 color_factors;
     vec4 metal_rough_factors;
-} material_data;
+    uint color_texture;
+    uint color_sampler;
+    uint metal_rough_texture;
+    uint metal_rough_sampler;
+};
+
+// only the entries added so far are written. Every draw reads those of its
+// own material, so the indices are uniform across a draw.
+layout(set = 1, binding = 0) uniform texture2D textures[BINDLESS_MAX_TEXTURES];
+layout(set = 1, binding = 1) uniform sampler samplers[BINDLESS_MAX_SAMPLERS];
 
-layout(set = 1, binding = 1) uniform sampler2D color_tex;
-layout(set = 1, binding = 2) uniform sampler2D metal_rough_tex;
+// the material registry, indexed by the draw's material_index
+layout(set = 1, binding = 2, std430) readonly buffer MaterialBuffer {
+    Material materials[];
+};
 
 #endif
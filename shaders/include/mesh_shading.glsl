@@ -0,0 +1,22 @@
+#ifndef MESH_SHADING_GLSL
+#define MESH_SHADING_GLSL
+
+#include "input_structures.glsl"
+
+// lit color of a mesh fragment, alpha from the material and its texture
+vec4 shade_mesh(vec3 normal, vec3 vertex_color, vec2 uv, uint material_index) {
+    Material material = materials[material_index];
+
+    float light_value = max(
+            dot(normal, scene_data.sunlight_direction.xyz), 0.1f);
+
+    vec4 texel = texture(sampler2D(textures[material.color_texture],
+            samplers[material.color_sampler]), uv);
+    vec3 color = vertex_color * texel.xyz;
+    vec3 ambient = color * scene_data.ambient_color.xyz;
+
+    return vec4(color * light_value * scene_data.sunlight_color.w + ambient,
+            material.color_factors.a * texel.a);
+}
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef OBJECT_RECORDS_GLSL
+#define OBJECT_RECORDS_GLSL
+
+#extension GL_EXT_buffer_reference : require
+
+// GPUObjectRecord
+struct ObjectRecord {
+    mat4 transform;
+    vec4 sphere; // mesh space, radius in w
+    vec4 position_offset;
+    vec4 position_scale;
+    uint index_count;
+    uint first_index;
+    int vertex_offset;
+    uint batch;
+};
+
+layout(buffer_reference, std430) readonly buffer ObjectBuffer {
+    ObjectRecord objects[];
+};
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef PACKED_VERTEX_GLSL
+#define PACKED_VERTEX_GLSL
+
+#extension GL_EXT_buffer_reference : require
+
+// PackedVertex: unorm16 position xy | unorm16 position z, snorm8 octahedral
+// normal | half uv | unorm8 color
+layout(buffer_reference, std430) readonly buffer VertexBuffer {
+    uvec4 vertices[];
+};
+
+// the inverse of encode_octahedral in vk_vertex_packing.cpp
+vec3 decode_octahedral(vec2 e) {
+    vec3 n = vec3(e, 1.0f - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0f);
+    n.xy += vec2(n.x >= 0.0f ? -t : t, n.y >= 0.0f ? -t : t);
+    return normalize(n);
+}
+
+#endif
@@ -0,0 +1,38 @@
+#version 450
+
+#extension GL_EXT_buffer_reference : require
+
+#include "input_structures.glsl"
+
+// must match mesh.vert bit for bit, the color pass tests for equal depth
+invariant gl_Position;
+
+// tightly packed vec3 positions
+layout(buffer_reference, std430) readonly buffer PositionBuffer {
+    float positions[];
+};
+
+// world transform of every instance of the frame's draws
+layout(buffer_reference, std430) readonly buffer InstanceBuffer {
+    mat4 transforms[];
+};
+
+// GPUInstancedDrawPushConstants, with the position stream as vertex buffer
+layout(push_constant) uniform constants {
+    PositionBuffer position_buffer;
+    InstanceBuffer instance_buffer;
+} PushConstants;
+
+void main() {
+    uint i = gl_VertexIndex * 3;
+    vec3 local_position = vec3(PushConstants.position_buffer.positions[i],
+            PushConstants.position_buffer.positions[i + 1],
+            PushConstants.position_buffer.positions[i + 2]);
+
+    mat4 render_matrix =
+            PushConstants.instance_buffer.transforms[gl_InstanceIndex];
+
+    vec4 position = vec4(local_position, 1.0f);
+
+    gl_Position = scene_data.viewproj * render_matrix * position;
+}
@@ -0,0 +1,42 @@
+#version 450
+
+#extension GL_EXT_buffer_reference : require
+
+#include "input_structures.glsl"
+
+// must match mesh_packed.vert bit for bit, the color pass tests for equal
+// depth
+invariant gl_Position;
+
+// PackedPosition: unorm16 position xy | unorm16 position z, padding
+layout(buffer_reference, std430) readonly buffer PositionBuffer {
+    uvec2 positions[];
+};
+
+// world transform of every instance of the frame's draws
+layout(buffer_reference, std430) readonly buffer InstanceBuffer {
+    mat4 transforms[];
+};
+
+// GPUPackedDrawPushConstants, with the position stream as vertex buffer
+layout(push_constant) uniform constants {
+    vec4 position_offset;
+    vec4 position_scale;
+    PositionBuffer position_buffer;
+    InstanceBuffer instance_buffer;
+} PushConstants;
+
+void main() {
+    uvec2 v = PushConstants.position_buffer.positions[gl_VertexIndex];
+
+    mat4 render_matrix =
+            PushConstants.instance_buffer.transforms[gl_InstanceIndex];
+
+    vec3 unorm = vec3(v.x & 0xffffu, v.x >> 16, v.y & 0xffffu);
+    vec3 local_position = PushConstants.position_offset.xyz
+            + unorm * PushConstants.position_scale.xyz;
+
+    vec4 position = vec4(local_position, 1.0f);
+
+    gl_Position = scene_data.viewproj * render_matrix * position;
+}
@@ -4,9 +4,14 @@
 
 #include "input_structures.glsl"
 
+// the depth prepass computes the same position, the color pass over it
+// tests for equality
+invariant gl_Position;
+
 layout(location = 0) out vec3 out_normal;
 layout(location = 1) out vec3 out_color;
 layout(location = 2) out vec2 out_uv;
+layout(location = 3) flat out uint out_material;
 
 struct Vertex {
     vec3 position;
@@ -20,20 +25,32 @@ layout(buffer_reference, std430) readonly buffer VertexBuffer {
     Vertex vertices[];
 };
 
+// world transform of every instance of the frame's draws
+layout(buffer_reference, std430) readonly buffer InstanceBuffer {
+    mat4 transforms[];
+};
+
 layout(push_constant) uniform constants {
-    mat4 render_matrix;
     VertexBuffer vertex_buffer;
+    InstanceBuffer instance_buffer;
+    uint material_index;
 } PushConstants;
 
 void main() {
+    Material material = materials[PushConstants.material_index];
+
     Vertex v = PushConstants.vertex_buffer.vertices[gl_VertexIndex];
 
+    mat4 render_matrix =
+            PushConstants.instance_buffer.transforms[gl_InstanceIndex];
+
     vec4 position = vec4(v.position, 1.0f);
 
-    gl_Position = scene_data.viewproj * PushConstants.render_matrix * position;
+    gl_Position = scene_data.viewproj * render_matrix * position;
 
-    out_normal = (PushConstants.render_matrix * vec4(v.normal, 0.f)).xyz;
-    out_color = v.color.xyz * material_data.color_factors.xyz;
+    out_normal = (render_matrix * vec4(v.normal, 0.f)).xyz;
+    out_color = v.color.xyz * material.color_factors.xyz;
     out_uv.x = v.uv_x;
     out_uv.y = v.uv_y;
+    out_material = PushConstants.material_index;
 }
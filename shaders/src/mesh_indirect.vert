@@ -0,0 +1,49 @@
+#version 450
+
+#extension GL_EXT_buffer_reference : require
+
+#include "input_structures.glsl"
+#include "object_records.glsl"
+
+layout(location = 0) out vec3 out_normal;
+layout(location = 1) out vec3 out_color;
+layout(location = 2) out vec2 out_uv;
+layout(location = 3) flat out uint out_material;
+
+struct Vertex {
+    vec3 position;
+    float uv_x;
+    vec3 normal;
+    float uv_y;
+    vec4 color;
+};
+
+layout(buffer_reference, std430) readonly buffer VertexBuffer {
+    Vertex vertices[];
+};
+
+layout(push_constant) uniform constants {
+    VertexBuffer vertex_buffer;
+    ObjectBuffer object_buffer;
+    uint material_index;
+} PushConstants;
+
+void main() {
+    Material material = materials[PushConstants.material_index];
+
+    Vertex v = PushConstants.vertex_buffer.vertices[gl_VertexIndex];
+
+    // the culling pass stores the object index as the first instance
+    mat4 render_matrix =
+            PushConstants.object_buffer.objects[gl_InstanceIndex].transform;
+
+    vec4 position = vec4(v.position, 1.0f);
+
+    gl_Position = scene_data.viewproj * render_matrix * position;
+
+    out_normal = (render_matrix * vec4(v.normal, 0.f)).xyz;
+    out_color = v.color.xyz * material.color_factors.xyz;
+    out_uv.x = v.uv_x;
+    out_uv.y = v.uv_y;
+    out_material = PushConstants.material_index;
+}
@@ -0,0 +1,28 @@
+#version 450
+
+#include "mesh_shading.glsl"
+
+layout(location = 0) in vec3 in_normal;
+layout(location = 1) in vec3 in_color;
+layout(location = 2) in vec2 in_uv;
+layout(location = 3) flat in uint in_material;
+
+// summed weighted premultiplied color and coverage
+layout(location = 0) out vec4 out_accum;
+// multiplied by 1 - alpha through the blend state
+layout(location = 1) out float out_revealage;
+
+void main() {
+    vec4 color = shade_mesh(in_normal, in_color, in_uv, in_material);
+
+    // weight from the view depth, equation 9 of McGuire and Bavoil 2013.
+    // Close surfaces dominate the average, so the result stays close to the
+    // sorted one without any ordering.
+    float view_depth = 1.0 / gl_FragCoord.w;
+    float weight = color.a * clamp(10.0 / (1e-5
+                    + pow(view_depth / 5.0, 2.0)
+                    + pow(view_depth / 200.0, 6.0)), 1e-2, 3e3);
+
+    out_accum = vec4(color.rgb * color.a, color.a) * weight;
+    out_revealage = color.a;
+}
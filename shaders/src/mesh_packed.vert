@@ -0,0 +1,51 @@
+#version 450
+
+#extension GL_EXT_buffer_reference : require
+
+#include "input_structures.glsl"
+#include "packed_vertex.glsl"
+
+// the depth prepass computes the same position, the color pass over it
+// tests for equality
+invariant gl_Position;
+
+layout(location = 0) out vec3 out_normal;
+layout(location = 1) out vec3 out_color;
+layout(location = 2) out vec2 out_uv;
+layout(location = 3) flat out uint out_material;
+
+// world transform of every instance of the frame's draws
+layout(buffer_reference, std430) readonly buffer InstanceBuffer {
+    mat4 transforms[];
+};
+
+layout(push_constant) uniform constants {
+    vec4 position_offset;
+    vec4 position_scale;
+    VertexBuffer vertex_buffer;
+    InstanceBuffer instance_buffer;
+    uint material_index;
+} PushConstants;
+
+void main() {
+    Material material = materials[PushConstants.material_index];
+
+    uvec4 v = PushConstants.vertex_buffer.vertices[gl_VertexIndex];
+
+    mat4 render_matrix =
+            PushConstants.instance_buffer.transforms[gl_InstanceIndex];
+
+    vec3 unorm = vec3(v.x & 0xffffu, v.x >> 16, v.y & 0xffffu);
+    vec3 local_position = PushConstants.position_offset.xyz
+            + unorm * PushConstants.position_scale.xyz;
+    vec3 normal = decode_octahedral(unpackSnorm4x8(v.y).zw);
+
+    vec4 position = vec4(local_position, 1.0f);
+
+    gl_Position = scene_data.viewproj * render_matrix * position;
+
+    out_normal = (render_matrix * vec4(normal, 0.f)).xyz;
+    out_color = unpackUnorm4x8(v.w).xyz * material.color_factors.xyz;
+    out_uv = unpackHalf2x16(v.z);
+    out_material = PushConstants.material_index;
+}
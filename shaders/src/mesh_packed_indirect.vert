@@ -0,0 +1,42 @@
+#version 450
+
+#extension GL_EXT_buffer_reference : require
+
+#include "input_structures.glsl"
+#include "object_records.glsl"
+#include "packed_vertex.glsl"
+
+layout(location = 0) out vec3 out_normal;
+layout(location = 1) out vec3 out_color;
+layout(location = 2) out vec2 out_uv;
+layout(location = 3) flat out uint out_material;
+
+layout(push_constant) uniform constants {
+    VertexBuffer vertex_buffer;
+    ObjectBuffer object_buffer;
+    uint material_index;
+} PushConstants;
+
+void main() {
+    Material material = materials[PushConstants.material_index];
+
+    uvec4 v = PushConstants.vertex_buffer.vertices[gl_VertexIndex];
+
+    // the culling pass stores the object index as the first instance
+    ObjectRecord object =
+            PushConstants.object_buffer.objects[gl_InstanceIndex];
+
+    vec3 unorm = vec3(v.x & 0xffffu, v.x >> 16, v.y & 0xffffu);
+    vec3 local_position = object.position_offset.xyz
+            + unorm * object.position_scale.xyz;
+    vec3 normal = decode_octahedral(unpackSnorm4x8(v.y).zw);
+
+    vec4 position = vec4(local_position, 1.0f);
+
+    gl_Position = scene_data.viewproj * object.transform * position;
+
+    out_normal = (object.transform * vec4(normal, 0.f)).xyz;
+    out_color = unpackUnorm4x8(v.w).xyz * material.color_factors.xyz;
+    out_uv = unpackHalf2x16(v.z);
+    out_material = PushConstants.material_index;
+}
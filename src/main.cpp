@@ -1,13 +1,188 @@
+#include <vk_benchmark.h>
 #include <vk_engine.h>
 
+#include <charconv>
+#include <string_view>
+
+// a plain decimal count, nothing for signs, other characters or overflow
+static std::optional<uint32_t> parse_count(std::string_view text) {
+	uint32_t value = 0;
+	const char* end = text.data() + text.size();
+	auto [ptr, ec] = std::from_chars(text.data(), end, value);
+	if (ec != std::errc() || ptr != end) {
+		return {};
+	}
+	return value;
+}
+
+// comma separated counts, a headless run renders once per entry. Nothing if
+// any entry is not a count.
+static std::optional<std::vector<uint32_t>> parse_list(
+		std::string_view list) {
+	std::vector<uint32_t> values;
+	size_t start = 0;
+	while (start < list.size()) {
+		size_t comma = std::min(list.find(',', start), list.size());
+		std::optional<uint32_t> value =
+				parse_count(list.substr(start, comma - start));
+		if (!value.has_value()) {
+			return {};
+		}
+		values.push_back(value.value());
+		start = comma + 1;
+	}
+	return values;
+}
+
+static EngineOptions parse_options(
+		int argc, char* argv[], MicrobenchmarkOptions& bench_options) {
+	EngineOptions options;
+
+	for (int i = 1; i < argc; i++) {
+		std::string_view arg = argv[i];
+
+		auto value_of = [&](std::string_view prefix) {
+			return std::string(arg.substr(prefix.size()));
+		};
+
+		// counts are left unchanged when the value is not one
+		auto count_of = [&](std::string_view prefix, uint32_t& count) {
+			std::optional<uint32_t> value =
+					parse_count(arg.substr(prefix.size()));
+			if (!value.has_value()) {
+				fmt::println("Unknown argument {}", arg);
+				return;
+			}
+			count = value.value();
+		};
+
+		auto list_of = [&](std::string_view prefix) {
+			std::optional<std::vector<uint32_t>> values =
+					parse_list(arg.substr(prefix.size()));
+			if (!values.has_value()) {
+				fmt::println("Unknown argument {}", arg);
+			}
+			return values;
+		};
+
+		if (arg == "--headless") {
+			options.headless = true;
+		} else if (arg.starts_with("--frames=")) {
+			count_of("--frames=", options.frame_count);
+		} else if (arg.starts_with("--warmup=")) {
+			count_of("--warmup=", options.warmup_frames);
+		} else if (arg.starts_with("--scene=")) {
+			options.scene = value_of("--scene=");
+		} else if (arg.starts_with("--output=")) {
+			options.output_path = value_of("--output=");
+		} else if (arg == "--packed-vertices") {
+			options.packed_vertices = true;
+		} else if (arg == "--gpu-driven") {
+			options.gpu_driven = true;
+		} else if (arg == "--compare-paths") {
+			// the engine starts on the gpu driven path so its device
+			// features are enabled, the comparison switches between both
+			options.compare_paths = true;
+			options.headless = true;
+			options.gpu_driven = true;
+		} else if (arg == "--occlusion-culling") {
+			options.occlusion_culling = true;
+		} else if (arg == "--cpu-occlusion") {
+			options.cpu_occlusion = true;
+		} else if (arg == "--no-push-descriptors") {
+			options.push_descriptors = false;
+		} else if (arg == "--no-instancing") {
+			options.instancing = false;
+		} else if (arg.starts_with("--record-threads=")) {
+			std::optional<std::vector<uint32_t>> threads =
+					list_of("--record-threads=");
+			if (threads.has_value()) {
+				options.record_threads = std::move(threads.value());
+			}
+			if (options.record_threads.empty()) {
+				options.record_threads.push_back(0);
+			}
+		} else if (arg.starts_with("--depth-prepass=")) {
+			std::optional<std::vector<uint32_t>> prepass =
+					list_of("--depth-prepass=");
+			if (prepass.has_value()) {
+				options.depth_prepass.clear();
+				for (uint32_t value : prepass.value()) {
+					options.depth_prepass.push_back(value != 0);
+				}
+			}
+			if (options.depth_prepass.empty()) {
+				options.depth_prepass.push_back(false);
+			}
+		} else if (arg.starts_with("--copies=")) {
+			count_of("--copies=", options.scene_copies);
+		} else if (arg.starts_with("--transparent-copies=")) {
+			count_of("--transparent-copies=", options.transparent_copies);
+		} else if (arg.starts_with("--materials=")) {
+			count_of("--materials=", options.scene_materials);
+		} else if (arg == "--transparency=sorted") {
+			options.transparency = TransparencyMode::Sorted;
+		} else if (arg == "--transparency=weighted") {
+			options.transparency = TransparencyMode::WeightedBlended;
+		} else if (arg.starts_with("--bench=")) {
+			bench_options.name = value_of("--bench=");
+		} else if (arg.starts_with("--asset=")) {
+			bench_options.asset_path = value_of("--asset=");
+		} else if (arg.starts_with("--iterations=")) {
+			count_of("--iterations=", bench_options.iterations);
+		} else {
+			fmt::println("Unknown argument {}", arg);
+		}
+	}
+
+	return options;
+}
+
+// a benchmark that failed has no report
+static int write_benchmark_report(
+		const std::optional<std::string>& json, const EngineOptions& options) {
+	if (!json.has_value()) {
+		return 1;
+	}
+
+	return write_report(json.value(), options.output_path) ? 0 : 1;
+}
+
 int main(int argc, char* argv[]) {
+	MicrobenchmarkOptions bench_options;
+	EngineOptions options = parse_options(argc, argv, bench_options);
+
+	// microbenchmarks measure cpu side systems and need no engine
+	if (!bench_options.name.empty() &&
+			!is_device_microbenchmark(bench_options.name)) {
+		return write_benchmark_report(
+				run_microbenchmark(bench_options), options);
+	}
+
+	// the ones that measure vulkan calls only need its device
+	const bool device_benchmark = !bench_options.name.empty();
+	if (device_benchmark) {
+		options.headless = true;
+	}
+
 	VulkanEngine engine;
 
-	engine.init();
+	engine.init(options);
 
-	engine.run();
+	int result = 0;
+	if (device_benchmark) {
+		result = write_benchmark_report(
+				run_device_microbenchmark(bench_options, engine.get_device()),
+				options);
+	} else if (options.compare_paths) {
+		result = engine.run_path_comparison() ? 0 : 1;
+	} else if (options.headless) {
+		result = engine.run_headless() ? 0 : 1;
+	} else {
+		engine.run();
+	}
 
 	engine.cleanup();
 
-	return 0;
+	return result;
 }
@@ -0,0 +1,1101 @@
+#include "vk_benchmark.h"
+
+#include "vk_culling.h"
+#include "vk_descriptor_cache.h"
+#include "vk_descriptors.h"
+#include "vk_draw_sort.h"
+#include "vk_engine.h"
+#include "vk_jobs.h"
+#include "vk_loader.h"
+#include "vk_material_registry.h"
+#include "vk_mesh_optimize.h"
+#include "vk_occlusion.h"
+#include "vk_vertex_packing.h"
+
+#include <fmt/core.h>
+#include <glm/common.hpp>
+#include <glm/ext/matrix_clip_space.hpp>
+#include <glm/ext/matrix_transform.hpp>
+#include <glm/geometric.hpp>
+#include <glm/trigonometric.hpp>
+#include <glm/vector_relational.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <numeric>
+#include <random>
+#include <thread>
+
+std::string json_escape(std::string_view text) {
+	std::string escaped;
+	escaped.reserve(text.size());
+	for (char c : text) {
+		switch (c) {
+			case '"':
+				escaped += "\\\"";
+				break;
+			case '\\':
+				escaped += "\\\\";
+				break;
+			case '\n':
+				escaped += "\\n";
+				break;
+			case '\r':
+				escaped += "\\r";
+				break;
+			case '\t':
+				escaped += "\\t";
+				break;
+			default:
+				if ((unsigned char)c < 0x20) {
+					escaped += fmt::format("\\u{:04x}", (unsigned char)c);
+				} else {
+					escaped += c;
+				}
+		}
+	}
+	return escaped;
+}
+
+void BenchmarkReport::begin_configuration(const std::string& name) {
+	configurations.push_back(Configuration{ .name = name });
+}
+
+BenchmarkReport::Configuration& BenchmarkReport::current() {
+	if (configurations.empty()) {
+		begin_configuration("default");
+	}
+	return configurations.back();
+}
+
+void BenchmarkReport::add_frame(double frame_ms, double record_ms) {
+	current().cpu_frame_ms.push_back(frame_ms);
+	current().cpu_record_ms.push_back(record_ms);
+}
+
+void BenchmarkReport::add_gpu_frame(double ms) {
+	current().gpu_ms.push_back(ms);
+}
+
+void BenchmarkReport::add_counter(const std::string& name, double value) {
+	std::vector<Counter>& counters = current().counters;
+	for (Counter& c : counters) {
+		if (c.name == name) {
+			c.sum += value;
+			c.samples++;
+			return;
+		}
+	}
+
+	counters.push_back(Counter{
+			.name = name,
+			.sum = value,
+			.samples = 1,
+	});
+}
+
+static std::string samples_to_json(const std::vector<double>& samples) {
+	if (samples.empty()) {
+		return "null";
+	}
+
+	const double sum = std::accumulate(samples.begin(), samples.end(), 0.0);
+	const auto [min, max] = std::minmax_element(samples.begin(), samples.end());
+
+	return fmt::format("{{ \"mean\": {:.4f}, \"min\": {:.4f}, \"max\": {:.4f}, "
+					   "\"p50\": {:.4f}, \"p95\": {:.4f}, \"p99\": {:.4f} }}",
+			sum / samples.size(), *min, *max, percentile(samples, 50),
+			percentile(samples, 95), percentile(samples, 99));
+}
+
+std::string BenchmarkReport::to_json() const {
+	size_t frames = 0;
+	for (const Configuration& configuration : configurations) {
+		frames += configuration.cpu_frame_ms.size();
+	}
+
+	std::string json = "{\n";
+	json += fmt::format("\t\"scene\": \"{}\",\n", json_escape(scene));
+	json += fmt::format(
+			"\t\"device\": \"{}\",\n", json_escape(device_name));
+	json += fmt::format("\t\"width\": {},\n", width);
+	json += fmt::format("\t\"height\": {},\n", height);
+	json += fmt::format("\t\"frames\": {},\n", frames);
+
+	json += "\t\"configurations\": [";
+	for (size_t i = 0; i < configurations.size(); i++) {
+		const Configuration& configuration = configurations[i];
+
+		json += fmt::format("{}\n\t\t{{\n", i == 0 ? "" : ",");
+		json += fmt::format("\t\t\t\"name\": \"{}\",\n", configuration.name);
+		json += fmt::format("\t\t\t\"frames\": {},\n",
+				configuration.cpu_frame_ms.size());
+		json += fmt::format("\t\t\t\"cpu_frame_ms\": {},\n",
+				samples_to_json(configuration.cpu_frame_ms));
+		json += fmt::format("\t\t\t\"cpu_record_ms\": {},\n",
+				samples_to_json(configuration.cpu_record_ms));
+		json += fmt::format("\t\t\t\"gpu_ms\": {},\n",
+				samples_to_json(configuration.gpu_ms));
+
+		const std::vector<Counter>& counters = configuration.counters;
+		json += "\t\t\t\"counters\": {";
+		for (size_t c = 0; c < counters.size(); c++) {
+			json += fmt::format("{}\n\t\t\t\t\"{}\": {:.4f}",
+					c == 0 ? "" : ",", counters[c].name,
+					counters[c].sum / counters[c].samples);
+		}
+		json += counters.empty() ? "}\n" : "\n\t\t\t}\n";
+
+		json += "\t\t}";
+	}
+	json += configurations.empty() ? "]\n" : "\n\t]\n";
+
+	json += "}\n";
+
+	return json;
+}
+
+bool write_report(const std::string& json, const std::string& path) {
+	if (path.empty()) {
+		fmt::print("{}", json);
+		return true;
+	}
+
+	std::ofstream file(path);
+	if (!file.is_open()) {
+		fmt::println("Unable to open benchmark output file {}", path);
+		return false;
+	}
+	file << json;
+
+	return file.good();
+}
+
+double percentile(std::vector<double> samples, double p) {
+	if (samples.empty()) {
+		return 0.0;
+	}
+
+	// nearest-rank: the smallest sample that is greater than or equal to p
+	// percent of the data
+	size_t rank = (size_t)std::ceil(p / 100.0 * samples.size());
+	rank = std::clamp<size_t>(rank, 1, samples.size());
+
+	std::nth_element(
+			samples.begin(), samples.begin() + (rank - 1), samples.end());
+
+	return samples[rank - 1];
+}
+
+template <typename F> static double time_ms(F&& fn) {
+	auto start = std::chrono::high_resolution_clock::now();
+	fn();
+	auto end = std::chrono::high_resolution_clock::now();
+
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// thread counts to measure scaling with: powers of two up to the core count,
+// and the core count itself
+static std::vector<uint32_t> scaling_thread_counts() {
+	const uint32_t cores = std::max(1u, std::thread::hardware_concurrency());
+
+	std::vector<uint32_t> counts;
+	for (uint32_t t = 1; t < cores; t *= 2) {
+		counts.push_back(t);
+	}
+	counts.push_back(cores);
+
+	return counts;
+}
+
+static bool same_meshes(
+		const std::vector<MeshData>& a, const std::vector<MeshData>& b) {
+	if (a.size() != b.size()) {
+		return false;
+	}
+
+	for (size_t i = 0; i < a.size(); i++) {
+		if (a[i].name != b[i].name ||
+				a[i].surfaces.size() != b[i].surfaces.size() ||
+				a[i].vertices.size() != b[i].vertices.size() ||
+				a[i].indices != b[i].indices) {
+			return false;
+		}
+
+		for (size_t s = 0; s < a[i].surfaces.size(); s++) {
+			if (a[i].surfaces[s].start_index != b[i].surfaces[s].start_index ||
+					a[i].surfaces[s].count != b[i].surfaces[s].count) {
+				return false;
+			}
+		}
+
+		// bitwise, decoding has to be deterministic down to the last bit
+		if (memcmp(a[i].vertices.data(), b[i].vertices.data(),
+					a[i].vertices.size() * sizeof(Vertex)) != 0) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static std::optional<std::string> benchmark_gltf_decode(
+		const MicrobenchmarkOptions& options) {
+	// the single threaded decode is the reference every other run must match
+	std::optional<std::vector<MeshData>> reference =
+			decode_gltf_meshes(options.asset_path);
+	if (!reference.has_value()) {
+		fmt::println("Unable to decode {}", options.asset_path);
+		return {};
+	}
+
+	std::string json = "{\n";
+	json += "\t\"benchmark\": \"gltf_decode\",\n";
+	json += fmt::format(
+			"\t\"asset\": \"{}\",\n", json_escape(options.asset_path));
+	json += "\t\"results\": [";
+
+	double single_thread_p50 = 0.0;
+	std::vector<uint32_t> thread_counts = scaling_thread_counts();
+	for (size_t i = 0; i < thread_counts.size(); i++) {
+		JobSystem job_system;
+		job_system.init(thread_counts[i]);
+
+		std::vector<double> samples;
+		bool identical = true;
+		for (uint32_t it = 0; it < options.iterations; it++) {
+			std::optional<std::vector<MeshData>> decoded;
+			samples.push_back(time_ms([&]() {
+				decoded = decode_gltf_meshes(options.asset_path, &job_system);
+			}));
+
+			identical = identical && decoded.has_value() &&
+					same_meshes(reference.value(), decoded.value());
+		}
+
+		job_system.shutdown();
+
+		const double p50 = percentile(samples, 50);
+		if (i == 0) {
+			single_thread_p50 = p50;
+		}
+
+		json += fmt::format("{}\n\t\t{{ \"threads\": {}, \"ms\": {}, "
+							"\"speedup\": {:.3f}, \"identical\": {} }}",
+				i == 0 ? "" : ",", thread_counts[i], samples_to_json(samples),
+				single_thread_p50 / p50, identical);
+	}
+
+	json += "\n\t]\n}\n";
+
+	return json;
+}
+
+static std::string cache_stats_to_json(const VertexCacheStats& stats) {
+	return fmt::format("{{ \"vertices\": {}, \"triangles\": {}, "
+					   "\"acmr\": {:.4f}, \"atvr\": {:.4f} }}",
+			stats.vertices, stats.triangles, stats.acmr(), stats.atvr());
+}
+
+static std::optional<std::string> benchmark_mesh_optimize(
+		const MicrobenchmarkOptions& options) {
+	std::optional<std::vector<MeshData>> decoded =
+			decode_gltf_meshes(options.asset_path);
+	if (!decoded.has_value()) {
+		fmt::println("Unable to decode {}", options.asset_path);
+		return {};
+	}
+
+	std::string json = "{\n";
+	json += "\t\"benchmark\": \"mesh_optimize\",\n";
+	json += fmt::format(
+			"\t\"asset\": \"{}\",\n", json_escape(options.asset_path));
+	json += fmt::format("\t\"cache_size\": {},\n", VERTEX_CACHE_SIZE);
+	json += "\t\"meshes\": [";
+
+	for (size_t i = 0; i < decoded->size(); i++) {
+		const MeshData& mesh = decoded.value()[i];
+
+		std::vector<double> samples;
+		MeshData optimized;
+		for (uint32_t it = 0; it < options.iterations; it++) {
+			optimized = mesh;
+			samples.push_back(time_ms([&]() { optimize_mesh(optimized); }));
+		}
+
+		json += fmt::format("{}\n\t\t{{ \"name\": \"{}\", "
+							"\"before\": {}, \"after\": {}, \"ms\": {} }}",
+				i == 0 ? "" : ",", json_escape(mesh.name),
+				cache_stats_to_json(analyze_vertex_cache(mesh)),
+				cache_stats_to_json(analyze_vertex_cache(optimized)),
+				samples_to_json(samples));
+	}
+
+	json += "\n\t]\n}\n";
+
+	return json;
+}
+
+// two 8 bit octahedral components, the worst case of the rounding is just
+// under a degree
+constexpr double MAX_NORMAL_ERROR_DEGREES = 1.0;
+
+static std::optional<std::string> benchmark_vertex_packing(
+		const MicrobenchmarkOptions& options) {
+	std::optional<std::vector<MeshData>> decoded =
+			decode_gltf_meshes(options.asset_path);
+	if (!decoded.has_value()) {
+		fmt::println("Unable to decode {}", options.asset_path);
+		return {};
+	}
+
+	std::string json = "{\n";
+	json += "\t\"benchmark\": \"vertex_packing\",\n";
+	json += fmt::format(
+			"\t\"asset\": \"{}\",\n", json_escape(options.asset_path));
+	json += fmt::format("\t\"vertex_bytes\": {},\n", sizeof(Vertex));
+	json += fmt::format("\t\"packed_vertex_bytes\": {},\n",
+			sizeof(PackedVertex));
+	json += "\t\"meshes\": [";
+
+	for (size_t i = 0; i < decoded->size(); i++) {
+		const MeshData& mesh = decoded.value()[i];
+
+		std::vector<double> samples;
+		PackedVertices packed;
+		for (uint32_t it = 0; it < options.iterations; it++) {
+			samples.push_back(
+					time_ms([&]() { packed = pack_vertices(mesh.vertices); }));
+		}
+
+		// worst reconstruction error of every attribute. Positions are
+		// relative to the largest extent of the mesh, so the bound is half a
+		// unorm16 step
+		const glm::vec3 extent = packed.position_scale * 65535.f;
+		const float max_extent = std::max(
+				std::max(extent.x, extent.y), std::max(extent.z, 1e-9f));
+
+		// every axis is rounded to the nearest of its own steps, so no
+		// coordinate may move by more than half of one. The slack covers
+		// float rounding of the decode.
+		const glm::vec3 position_bound = 0.5f * packed.position_scale +
+				4.f * FLT_EPSILON *
+						glm::max(glm::abs(packed.position_offset),
+								glm::abs(packed.position_offset + extent));
+		bool position_in_bound = true;
+
+		double position_error = 0.0;
+		double normal_error_degrees = 0.0;
+		double uv_error = 0.0;
+		double color_error = 0.0;
+		for (size_t v = 0; v < mesh.vertices.size(); v++) {
+			const Vertex& original = mesh.vertices[v];
+			const Vertex unpacked = unpack_vertex(packed.vertices[v],
+					packed.position_offset, packed.position_scale);
+
+			const glm::vec3 dp =
+					glm::abs(unpacked.position - original.position);
+			position_error = std::max<double>(position_error,
+					std::max(std::max(dp.x, dp.y), dp.z) / max_extent);
+			position_in_bound = position_in_bound &&
+					glm::all(glm::lessThanEqual(dp, position_bound));
+
+			const float cos_angle = glm::clamp(
+					glm::dot(unpacked.normal, glm::normalize(original.normal)),
+					-1.f, 1.f);
+			normal_error_degrees = std::max<double>(
+					normal_error_degrees, glm::degrees(std::acos(cos_angle)));
+
+			uv_error = std::max<double>(uv_error,
+					std::max(std::abs(unpacked.uv_x - original.uv_x),
+							std::abs(unpacked.uv_y - original.uv_y)));
+
+			const glm::vec4 dc = glm::abs(unpacked.color -
+					glm::clamp(original.color, 0.f, 1.f));
+			color_error = std::max<double>(color_error,
+					std::max(std::max(dc.x, dc.y), std::max(dc.z, dc.w)));
+		}
+
+		// a regression in the packing fails the run instead of showing up
+		// as a larger number in the report
+		if (!position_in_bound) {
+			fmt::println("{}: position error exceeds half a unorm16 step",
+					mesh.name);
+			return {};
+		}
+		if (normal_error_degrees > MAX_NORMAL_ERROR_DEGREES) {
+			fmt::println("{}: normal error of {:.4f} degrees exceeds {}",
+					mesh.name, normal_error_degrees, MAX_NORMAL_ERROR_DEGREES);
+			return {};
+		}
+
+		json += fmt::format("{}\n\t\t{{ \"name\": \"{}\", "
+							"\"vertices\": {}, \"ms\": {}, "
+							"\"max_position_error\": {:.8f}, "
+							"\"max_normal_error_degrees\": {:.4f}, "
+							"\"max_uv_error\": {:.6f}, "
+							"\"max_color_error\": {:.6f} }}",
+				i == 0 ? "" : ",", json_escape(mesh.name),
+				mesh.vertices.size(), samples_to_json(samples), position_error,
+				normal_error_degrees, uv_error, color_error);
+	}
+
+	json += "\n\t]\n}\n";
+
+	return json;
+}
+
+// synthetic draw of the draw sort benchmark
+struct BenchmarkDraw {
+	uint32_t pipeline;
+	uint32_t material;
+	uint32_t mesh;
+	float depth;
+};
+
+// pipeline binds plus material set binds needed to draw in that order
+static uint32_t count_state_changes(const std::vector<BenchmarkDraw>& draws,
+		const std::vector<uint32_t>& order) {
+	uint32_t changes = 0;
+	const BenchmarkDraw* last = nullptr;
+	for (uint32_t i : order) {
+		const BenchmarkDraw& draw = draws[i];
+		if (!last || last->pipeline != draw.pipeline) {
+			changes++;
+		}
+		if (!last || last->material != draw.material) {
+			changes++;
+		}
+		last = &draw;
+	}
+	return changes;
+}
+
+static std::optional<std::string> benchmark_draw_sort(
+		const MicrobenchmarkOptions& options) {
+	constexpr uint32_t pipeline_count = 4;
+	constexpr uint32_t material_count = 256;
+	constexpr uint32_t mesh_count = 1024;
+
+	std::string json = "{\n";
+	json += "\t\"benchmark\": \"draw_sort\",\n";
+	json += fmt::format("\t\"pipelines\": {},\n", pipeline_count);
+	json += fmt::format("\t\"materials\": {},\n", material_count);
+	json += fmt::format("\t\"meshes\": {},\n", mesh_count);
+	json += "\t\"results\": [";
+
+	const uint32_t draw_counts[] = { 10000, 25000, 50000, 100000 };
+	for (size_t c = 0; c < std::size(draw_counts); c++) {
+		// same scene every run
+		std::mt19937 rng(draw_counts[c]);
+		std::vector<BenchmarkDraw> draws(draw_counts[c]);
+		for (BenchmarkDraw& draw : draws) {
+			draw.material = rng() % material_count;
+			// materials always use the same pipeline
+			draw.pipeline = draw.material % pipeline_count;
+			draw.mesh = rng() % mesh_count;
+			draw.depth = std::uniform_real_distribution<float>(1, 1000)(rng);
+		}
+
+		DrawSorter sorter;
+		std::vector<uint64_t> keys(draws.size());
+		std::vector<uint32_t> order;
+
+		std::vector<double> key_samples;
+		std::vector<double> radix_samples;
+		std::vector<double> std_sort_samples;
+		for (uint32_t it = 0; it < options.iterations; it++) {
+			key_samples.push_back(time_ms([&]() {
+				for (size_t i = 0; i < draws.size(); i++) {
+					keys[i] = make_draw_key(MaterialPass::MainColor,
+							draws[i].pipeline, draws[i].material,
+							draws[i].mesh, draws[i].depth);
+				}
+			}));
+
+			radix_samples.push_back(
+					time_ms([&]() { sorter.sort(keys, order); }));
+
+			// reference comparison sort of the same index array
+			std::vector<uint32_t> reference(draws.size());
+			std::iota(reference.begin(), reference.end(), 0);
+			std_sort_samples.push_back(time_ms([&]() {
+				std::stable_sort(reference.begin(), reference.end(),
+						[&](uint32_t a, uint32_t b) {
+							return keys[a] < keys[b];
+						});
+			}));
+		}
+
+		std::vector<uint32_t> unsorted(draws.size());
+		std::iota(unsorted.begin(), unsorted.end(), 0);
+
+		json += fmt::format("{}\n\t\t{{ \"draws\": {}, \"key_ms\": {}, "
+							"\"radix_sort_ms\": {}, \"std_sort_ms\": {}, "
+							"\"state_changes_unsorted\": {}, "
+							"\"state_changes_sorted\": {} }}",
+				c == 0 ? "" : ",", draws.size(), samples_to_json(key_samples),
+				samples_to_json(radix_samples),
+				samples_to_json(std_sort_samples),
+				count_state_changes(draws, unsorted),
+				count_state_changes(draws, order));
+	}
+
+	json += "\n\t]\n}\n";
+
+	return json;
+}
+
+static std::optional<std::string> benchmark_frustum_cull(
+		const MicrobenchmarkOptions& options) {
+	// the view projection update_scene builds at the default window size
+	const glm::mat4 view =
+			glm::translate(glm::mat4(1.f), glm::vec3{ 0.f, 0.f, -5.f });
+	glm::mat4 proj = glm::perspectiveRH_ZO(
+			glm::radians(70.f), 1700.f / 900.f, 0.1f, 10000.f);
+	proj[1][1] *= -1;
+	const Frustum frustum = make_frustum(proj * view);
+
+	std::vector<CullingKernel> kernels = { CullingKernel::Scalar };
+	if (best_culling_kernel() != CullingKernel::Scalar) {
+		kernels.push_back(CullingKernel::SSE);
+	}
+	if (best_culling_kernel() == CullingKernel::AVX2) {
+		kernels.push_back(CullingKernel::AVX2);
+	}
+
+	std::string json = "{\n";
+	json += "\t\"benchmark\": \"frustum_cull\",\n";
+	json += "\t\"results\": [";
+
+	const uint32_t object_counts[] = { 100000, 1000000 };
+	for (size_t c = 0; c < std::size(object_counts); c++) {
+		// objects scattered around the camera, about a fifth of them visible
+		std::mt19937 rng(object_counts[c]);
+		std::uniform_real_distribution<float> position(-500.f, 500.f);
+		std::uniform_real_distribution<float> radius(0.5f, 5.f);
+
+		SphereBatch spheres;
+		spheres.resize(object_counts[c]);
+		for (size_t i = 0; i < spheres.size(); i++) {
+			spheres.x[i] = position(rng);
+			spheres.y[i] = position(rng);
+			spheres.z[i] = position(rng);
+			spheres.radius[i] = radius(rng);
+		}
+
+		std::vector<uint8_t> reference(spheres.size());
+		cull_spheres(frustum, spheres, reference.data(), CullingKernel::Scalar);
+
+		json += fmt::format("{}\n\t\t{{ \"objects\": {}, \"kernels\": [",
+				c == 0 ? "" : ",", spheres.size());
+
+		double scalar_p50 = 0.0;
+		for (size_t k = 0; k < kernels.size(); k++) {
+			std::vector<uint8_t> visible(spheres.size());
+			uint32_t visible_count = 0;
+
+			std::vector<double> samples;
+			for (uint32_t it = 0; it < options.iterations; it++) {
+				samples.push_back(time_ms([&]() {
+					visible_count = cull_spheres(
+							frustum, spheres, visible.data(), kernels[k]);
+				}));
+			}
+
+			const double p50 = percentile(samples, 50);
+			if (k == 0) {
+				scalar_p50 = p50;
+			}
+
+			// every kernel runs the same plane tests, any difference is a
+			// kernel bug
+			if (visible != reference) {
+				fmt::println("{} kernel disagrees with scalar on {} objects",
+						culling_kernel_name(kernels[k]), spheres.size());
+				return {};
+			}
+
+			json += fmt::format("{}\n\t\t\t{{ \"kernel\": \"{}\", "
+								"\"ms\": {}, \"speedup\": {:.3f}, "
+								"\"visible\": {} }}",
+					k == 0 ? "" : ",", culling_kernel_name(kernels[k]),
+					samples_to_json(samples), scalar_p50 / p50,
+					visible_count);
+		}
+
+		json += "\n\t\t] }";
+	}
+
+	json += "\n\t]\n}\n";
+
+	return json;
+}
+
+// the 12 triangles of an axis aligned box
+static void append_box(
+		OccluderMesh& mesh, glm::vec3 center, glm::vec3 extents) {
+	const uint32_t first = (uint32_t)mesh.positions.size();
+	for (int i = 0; i < 8; i++) {
+		mesh.positions.push_back(center +
+				extents *
+						glm::vec3((i & 1) ? 1.f : -1.f, (i & 2) ? 1.f : -1.f,
+								(i & 4) ? 1.f : -1.f));
+	}
+
+	// two triangles per face, corners indexed by their sign bits
+	const uint32_t faces[6][4] = {
+		{ 0, 2, 6, 4 }, { 1, 5, 7, 3 }, { 0, 4, 5, 1 },
+		{ 2, 3, 7, 6 }, { 0, 1, 3, 2 }, { 4, 6, 7, 5 },
+	};
+	for (const uint32_t* face : faces) {
+		const uint32_t triangles[6] = { face[0], face[1], face[2], face[0],
+			face[2], face[3] };
+		for (uint32_t index : triangles) {
+			mesh.indices.push_back(first + index);
+		}
+	}
+}
+
+static std::optional<std::string> benchmark_software_occlusion(
+		const MicrobenchmarkOptions& options) {
+	// the projection update_scene builds, the scene is placed in view space
+	// directly. Greater depth wins the engine's greater or equal test, so
+	// the walls hide the boxes between them and the camera.
+	const float aspect = 1700.f / 900.f;
+	const float tan_half_fov = std::tan(glm::radians(35.f));
+	glm::mat4 proj = glm::perspectiveRH_ZO(
+			glm::radians(70.f), aspect, 0.1f, 10000.f);
+	proj[1][1] *= -1;
+
+	// a row of walls with gaps between them across the middle of the view,
+	// boxes scattered through the frustum in front of and behind them
+	OccluderMesh walls;
+	for (int w = -3; w < 3; w++) {
+		append_box(walls, glm::vec3(w * 8.f + 4.f, 0.f, -30.f),
+				glm::vec3(3.5f, 12.f, 0.5f));
+	}
+
+	constexpr uint32_t object_count = 20000;
+	std::mt19937 rng(object_count);
+	std::uniform_real_distribution<float> unit(-0.9f, 0.9f);
+	std::uniform_real_distribution<float> depth(5.f, 150.f);
+	std::uniform_real_distribution<float> size(0.2f, 2.f);
+
+	std::vector<Bounds> objects(object_count);
+	for (Bounds& bounds : objects) {
+		const float z = depth(rng);
+		const glm::vec3 extents = glm::vec3(size(rng), size(rng), size(rng));
+		bounds = Bounds{
+			.origin = glm::vec3(unit(rng) * z * tan_half_fov * aspect,
+					unit(rng) * z * tan_half_fov, -z),
+			.sphere_radius = glm::length(extents),
+			.extents = extents,
+		};
+	}
+
+	std::vector<CullingKernel> kernels = { CullingKernel::Scalar };
+	if (best_culling_kernel() != CullingKernel::Scalar) {
+		kernels.push_back(CullingKernel::SSE);
+	}
+	if (best_culling_kernel() == CullingKernel::AVX2) {
+		kernels.push_back(CullingKernel::AVX2);
+	}
+
+	std::string json = "{\n";
+	json += "\t\"benchmark\": \"software_occlusion\",\n";
+	json += fmt::format("\t\"objects\": {},\n", object_count);
+	json += fmt::format(
+			"\t\"occluder_triangles\": {},\n", walls.indices.size() / 3);
+	json += "\t\"results\": [";
+
+	const uint32_t resolutions[][2] = { { 128, 64 }, { 256, 128 },
+		{ 512, 256 } };
+	for (size_t r = 0; r < std::size(resolutions); r++) {
+		OcclusionBuffer buffer;
+		buffer.init(resolutions[r][0], resolutions[r][1]);
+
+		json += fmt::format("{}\n\t\t{{ \"width\": {}, \"height\": {}, "
+							"\"kernels\": [",
+				r == 0 ? "" : ",", buffer.width(), buffer.height());
+
+		std::vector<uint8_t> reference;
+		double scalar_p50 = 0.0;
+		for (size_t k = 0; k < kernels.size(); k++) {
+			std::vector<OccluderTriangle> triangles;
+
+			std::vector<double> raster_samples;
+			std::vector<double> test_samples;
+			std::vector<uint8_t> occluded(object_count);
+			for (uint32_t it = 0; it < options.iterations; it++) {
+				raster_samples.push_back(time_ms([&]() {
+					triangles.clear();
+					buffer.setup_triangles(walls, proj, triangles);
+					buffer.clear();
+					buffer.rasterize(
+							triangles, 0, buffer.tile_rows(), kernels[k]);
+				}));
+				test_samples.push_back(time_ms([&]() {
+					for (size_t i = 0; i < objects.size(); i++) {
+						occluded[i] = buffer.is_occluded(objects[i], proj);
+					}
+				}));
+			}
+
+			const double p50 = percentile(raster_samples, 50);
+			if (k == 0) {
+				scalar_p50 = p50;
+				reference = occluded;
+			}
+			const uint32_t occluded_count = (uint32_t)std::count(
+					occluded.begin(), occluded.end(), (uint8_t)1);
+
+			// the kernels only differ in how they fill the tiles, any
+			// other result is a rasterizer bug
+			if (occluded != reference) {
+				fmt::println("{} kernel disagrees with scalar at {}x{}",
+						culling_kernel_name(kernels[k]), buffer.width(),
+						buffer.height());
+				return {};
+			}
+
+			json += fmt::format("{}\n\t\t\t{{ \"kernel\": \"{}\", "
+								"\"raster_ms\": {}, \"speedup\": {:.3f}, "
+								"\"test_ms\": {}, \"occluded\": {}, "
+								"\"cull_rate\": {:.3f} }}",
+					k == 0 ? "" : ",", culling_kernel_name(kernels[k]),
+					samples_to_json(raster_samples), scalar_p50 / p50,
+					samples_to_json(test_samples), occluded_count,
+					(double)occluded_count / object_count);
+		}
+
+		json += "\n\t\t] }";
+	}
+
+	json += "\n\t]\n}\n";
+
+	return json;
+}
+
+static std::optional<std::string> benchmark_material_registry(
+		const MicrobenchmarkOptions& options) {
+	// what the engine's registry takes, against an estimate of one buffer
+	// per material if every material had its own
+	const uint32_t registry_allocations =
+			MaterialRegistry::allocation_count(FRAME_OVERLAP);
+
+	std::string json = "{\n";
+	json += "\t\"benchmark\": \"material_registry\",\n";
+	json += fmt::format(
+			"\t\"material_bytes\": {},\n", sizeof(GPUMaterial));
+	json += "\t\"results\": [";
+
+	const uint32_t material_counts[] = { 1000, 10000 };
+	const float edit_fractions[] = { 0.001f, 0.01f, 0.1f, 1.0f };
+	bool first = true;
+	for (uint32_t material_count : material_counts) {
+		std::vector<GPUMaterial> materials(material_count);
+		std::vector<std::byte> staging(material_count * sizeof(GPUMaterial));
+
+		for (float fraction : edit_fractions) {
+			const uint32_t edit_count =
+					std::max(1u, (uint32_t)(material_count * fraction));
+
+			// same edits every run, random slots as a material editor or
+			// streaming would touch them
+			std::mt19937 rng(material_count + edit_count);
+			std::vector<uint32_t> edits(edit_count);
+			for (uint32_t& edit : edits) {
+				edit = rng() % material_count;
+			}
+
+			DirtyRanges dirty;
+			std::vector<VkBufferCopy> regions;
+			VkDeviceSize bytes = 0;
+
+			std::vector<double> samples;
+			for (uint32_t it = 0; it < options.iterations; it++) {
+				dirty.clear();
+				regions.clear();
+				samples.push_back(time_ms([&]() {
+					for (uint32_t edit : edits) {
+						dirty.add(edit, 1);
+					}
+					bytes = pack_dirty_materials(
+							materials, dirty, staging.data(), regions);
+				}));
+			}
+
+			json += fmt::format("{}\n\t\t{{ \"materials\": {}, "
+								"\"edits\": {}, \"flush_ms\": {}, "
+								"\"copy_regions\": {}, "
+								"\"copied_bytes\": {}, "
+								"\"registry_allocations\": {}, "
+								"\"per_material_allocations_estimate\": {} }}",
+					first ? "" : ",", material_count, edit_count,
+					samples_to_json(samples), regions.size(), bytes,
+					registry_allocations, material_count);
+			first = false;
+		}
+	}
+
+	json += "\n\t]\n}\n";
+
+	return json;
+}
+
+// sets shaped like a material's, a uniform buffer and two textures, from an
+// allocator whose ratios expect one image per set
+static std::optional<std::string> benchmark_descriptor_allocation(
+		const MicrobenchmarkOptions& options, VkDevice device) {
+	constexpr uint32_t set_count = 10000;
+
+	DescriptorLayoutBuilder builder;
+	builder.add_binding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+	builder.add_binding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+	builder.add_binding(2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+	VkDescriptorSetLayout layout =
+			builder.build(device, VK_SHADER_STAGE_FRAGMENT_BIT);
+
+	const std::vector<VkDescriptorSetLayout> layouts(set_count, layout);
+
+	std::vector<DescriptorAllocatorGrowable::PoolSizeRatio> ratios = {
+		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1 },
+		{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1 },
+	};
+
+	auto run = [&](bool bulk, std::vector<double>& samples,
+					   DescriptorAllocatorStats& stats,
+					   std::string& adapted_ratios) {
+		for (uint32_t it = 0; it < options.iterations; it++) {
+			DescriptorAllocatorGrowable allocator;
+			allocator.init(device, 64, ratios);
+			allocator.describe_layout(layout, builder.bindings);
+
+			samples.push_back(time_ms([&]() {
+				if (bulk) {
+					allocator.allocate_many(device, layouts);
+				} else {
+					for (VkDescriptorSetLayout l : layouts) {
+						allocator.allocate(device, l);
+					}
+				}
+			}));
+
+			stats = allocator.stats();
+			adapted_ratios.clear();
+			for (const auto& r : allocator.ratios()) {
+				adapted_ratios += fmt::format("{}\"{}\": {:.2f}",
+						adapted_ratios.empty() ? "" : ", ",
+						string_VkDescriptorType(r.type), r.ratio);
+			}
+
+			allocator.destroy_pools(device);
+		}
+	};
+
+	std::string json = "{\n";
+	json += "\t\"benchmark\": \"descriptor_allocation\",\n";
+	json += fmt::format("\t\"sets\": {},\n", set_count);
+	json += "\t\"results\": [";
+
+	const bool modes[] = { false, true };
+	for (bool bulk : modes) {
+		std::vector<double> samples;
+		DescriptorAllocatorStats stats;
+		std::string adapted_ratios;
+		run(bulk, samples, stats, adapted_ratios);
+
+		json += fmt::format("{}\n\t\t{{ \"mode\": \"{}\", "
+							"\"allocate_ms\": {}, \"allocate_calls\": {}, "
+							"\"failed_calls\": {}, \"pools\": {}, "
+							"\"ratios\": {{ {} }} }}",
+				bulk ? "," : "", bulk ? "allocate_many" : "allocate",
+				samples_to_json(samples), stats.allocate_calls,
+				stats.failed_calls, stats.pools_created, adapted_ratios);
+	}
+
+	json += "\n\t]\n}\n";
+
+	vkDestroyDescriptorSetLayout(device, layout, nullptr);
+
+	return json;
+}
+
+// frames that ask a cache smaller than their working set for sampler sets,
+// most of them from a small hot set, and release them once recorded. Checks
+// that hits, evictions and the deferred reuse of evicted sets all happen.
+static std::optional<std::string> benchmark_descriptor_cache(
+		const MicrobenchmarkOptions& options, VkDevice device) {
+	constexpr uint32_t sampler_count = 128;
+	constexpr uint32_t hot_samplers = 16;
+	constexpr uint32_t capacity = 32;
+	constexpr uint32_t frame_count = 200;
+	constexpr uint32_t sets_per_frame = 64;
+
+	// samplers need no memory, so distinct contents are cheap to make
+	std::vector<VkSampler> samplers(sampler_count);
+	for (uint32_t i = 0; i < sampler_count; i++) {
+		VkSamplerCreateInfo info = {
+			.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+			.magFilter = VK_FILTER_NEAREST,
+			.minFilter = VK_FILTER_NEAREST,
+			.maxLod = (float)i,
+		};
+		vkCreateSampler(device, &info, nullptr, &samplers[i]);
+	}
+
+	DescriptorLayoutBuilder builder;
+	builder.add_binding(0, VK_DESCRIPTOR_TYPE_SAMPLER);
+	VkDescriptorSetLayout layout =
+			builder.build(device, VK_SHADER_STAGE_FRAGMENT_BIT);
+
+	std::vector<DescriptorAllocatorGrowable::PoolSizeRatio> ratios = {
+		{ VK_DESCRIPTOR_TYPE_SAMPLER, 1 },
+	};
+
+	// the same requests every run
+	std::mt19937 rng(sampler_count);
+	std::vector<uint32_t> requests(frame_count * sets_per_frame);
+	for (uint32_t& request : requests) {
+		request = rng() % 2 == 0 ? rng() % hot_samplers : rng() % sampler_count;
+	}
+
+	std::vector<double> samples;
+	DescriptorCacheStats stats;
+	float hit_rate = 0.0f;
+	bool consistent = true;
+	for (uint32_t it = 0; it < options.iterations; it++) {
+		DescriptorAllocatorGrowable allocator;
+		allocator.init(device, 64, ratios);
+		allocator.describe_layout(layout, builder.bindings);
+
+		DescriptorSetCache cache;
+		cache.init(&allocator, capacity);
+
+		std::vector<VkDescriptorSet> acquired;
+		std::unordered_map<uint32_t, VkDescriptorSet> frame_sets;
+		samples.push_back(time_ms([&]() {
+			for (uint32_t frame = 0; frame < frame_count; frame++) {
+				// the engine reports the frames its fence wait covers
+				if (frame >= FRAME_OVERLAP) {
+					cache.frames_completed(frame - FRAME_OVERLAP);
+				}
+
+				acquired.clear();
+				frame_sets.clear();
+				for (uint32_t i = 0; i < sets_per_frame; i++) {
+					const uint32_t sampler =
+							requests[frame * sets_per_frame + i];
+
+					DescriptorWriter writer;
+					writer.write_image(0, VK_NULL_HANDLE, samplers[sampler],
+							VK_IMAGE_LAYOUT_UNDEFINED,
+							VK_DESCRIPTOR_TYPE_SAMPLER);
+					VkDescriptorSet set = cache.acquire(device, layout, writer);
+
+					// the same contents within a frame are the same set
+					auto [known, inserted] = frame_sets.emplace(sampler, set);
+					consistent = consistent && known->second == set;
+
+					acquired.push_back(set);
+				}
+
+				for (VkDescriptorSet set : acquired) {
+					cache.release(set, frame);
+				}
+			}
+		}));
+
+		stats = cache.stats();
+		hit_rate = cache.hit_rate();
+
+		allocator.destroy_pools(device);
+	}
+
+	vkDestroyDescriptorSetLayout(device, layout, nullptr);
+	for (VkSampler sampler : samplers) {
+		vkDestroySampler(device, sampler, nullptr);
+	}
+
+	if (!consistent) {
+		fmt::println("The cache returned different sets for the same contents");
+		return {};
+	}
+	if (stats.hits == 0 || stats.evictions == 0 || stats.reuses == 0 ||
+			stats.deferred_reuses == 0) {
+		fmt::println("The cache workload missed a path: {} hits, {} "
+					 "evictions, {} reuses, {} deferred reuses",
+				stats.hits, stats.evictions, stats.reuses,
+				stats.deferred_reuses);
+		return {};
+	}
+
+	std::string json = "{\n";
+	json += "\t\"benchmark\": \"descriptor_cache\",\n";
+	json += fmt::format("\t\"capacity\": {},\n", capacity);
+	json += fmt::format("\t\"frames\": {},\n", frame_count);
+	json += fmt::format("\t\"sets_per_frame\": {},\n", sets_per_frame);
+	json += fmt::format("\t\"ms\": {},\n", samples_to_json(samples));
+	json += fmt::format("\t\"hit_rate\": {:.4f},\n", hit_rate);
+	json += fmt::format("\t\"hits\": {},\n", stats.hits);
+	json += fmt::format("\t\"misses\": {},\n", stats.misses);
+	json += fmt::format("\t\"evictions\": {},\n", stats.evictions);
+	json += fmt::format("\t\"reuses\": {},\n", stats.reuses);
+	json += fmt::format(
+			"\t\"deferred_reuses\": {},\n", stats.deferred_reuses);
+	json += fmt::format("\t\"entries\": {}\n", stats.entries);
+	json += "}\n";
+
+	return json;
+}
+
+std::optional<std::string> run_microbenchmark(
+		const MicrobenchmarkOptions& options) {
+	if (options.name == "gltf_decode") {
+		return benchmark_gltf_decode(options);
+	}
+	if (options.name == "mesh_optimize") {
+		return benchmark_mesh_optimize(options);
+	}
+	if (options.name == "vertex_packing") {
+		return benchmark_vertex_packing(options);
+	}
+	if (options.name == "draw_sort") {
+		return benchmark_draw_sort(options);
+	}
+	if (options.name == "frustum_cull") {
+		return benchmark_frustum_cull(options);
+	}
+	if (options.name == "software_occlusion") {
+		return benchmark_software_occlusion(options);
+	}
+	if (options.name == "material_registry") {
+		return benchmark_material_registry(options);
+	}
+
+	fmt::println("Unknown benchmark {}", options.name);
+	return {};
+}
+
+bool is_device_microbenchmark(std::string_view name) {
+	return name == "descriptor_allocation" || name == "descriptor_cache";
+}
+
+std::optional<std::string> run_device_microbenchmark(
+		const MicrobenchmarkOptions& options, VkDevice device) {
+	if (options.name == "descriptor_allocation") {
+		return benchmark_descriptor_allocation(options, device);
+	}
+	if (options.name == "descriptor_cache") {
+		return benchmark_descriptor_cache(options, device);
+	}
+
+	fmt::println("Unknown benchmark {}", options.name);
+	return {};
+}
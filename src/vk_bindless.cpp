@@ -0,0 +1,122 @@
+#include "vk_bindless.h"
+
+#include "vk_descriptors.h"
+
+#include <fmt/core.h>
+
+void BindlessTable::init(VkDevice device, VkBuffer material_buffer,
+		VkDeviceSize material_buffer_size) {
+	_device = device;
+
+	DescriptorLayoutBuilder builder;
+	builder.add_binding(
+			0, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, BINDLESS_MAX_TEXTURES);
+	builder.add_binding(1, VK_DESCRIPTOR_TYPE_SAMPLER, BINDLESS_MAX_SAMPLERS);
+	builder.add_binding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+
+	// the arrays only hold what was added so far and grow while in use, the
+	// material buffer binding never changes
+	const VkDescriptorBindingFlags array_flags =
+			VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+			VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+			VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+	const VkDescriptorBindingFlags binding_flags[] = {
+		array_flags,
+		array_flags,
+		0,
+	};
+
+	VkDescriptorSetLayoutBindingFlagsCreateInfo binding_flags_info = {
+		.sType =
+			VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+		.bindingCount = (uint32_t)std::size(binding_flags),
+		.pBindingFlags = binding_flags,
+	};
+
+	_layout = builder.build(device,
+			VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+			&binding_flags_info,
+			VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT);
+
+	// a pool for exactly the one set
+	const VkDescriptorPoolSize pool_sizes[] = {
+		{ VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, BINDLESS_MAX_TEXTURES },
+		{ VK_DESCRIPTOR_TYPE_SAMPLER, BINDLESS_MAX_SAMPLERS },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1 },
+	};
+
+	VkDescriptorPoolCreateInfo pool_info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+		.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT,
+		.maxSets = 1,
+		.poolSizeCount = (uint32_t)std::size(pool_sizes),
+		.pPoolSizes = pool_sizes,
+	};
+	VK_CHECK(vkCreateDescriptorPool(device, &pool_info, nullptr, &_pool));
+
+	VkDescriptorSetAllocateInfo alloc_info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+		.descriptorPool = _pool,
+		.descriptorSetCount = 1,
+		.pSetLayouts = &_layout,
+	};
+	VK_CHECK(vkAllocateDescriptorSets(device, &alloc_info, &_set));
+
+	DescriptorWriter writer;
+	writer.write_buffer(2, material_buffer, material_buffer_size, 0,
+			VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+	writer.update_set(device, _set);
+}
+
+void BindlessTable::destroy() {
+	vkDestroyDescriptorPool(_device, _pool, nullptr);
+	vkDestroyDescriptorSetLayout(_device, _layout, nullptr);
+
+	_textures.clear();
+	_samplers.clear();
+}
+
+std::optional<uint32_t> BindlessTable::add_texture(VkImageView view) {
+	auto it = _textures.find(view);
+	if (it != _textures.end()) {
+		return it->second;
+	}
+
+	if (_textures.size() == BINDLESS_MAX_TEXTURES) {
+		fmt::println("Bindless texture array is full");
+		return {};
+	}
+
+	const uint32_t index = (uint32_t)_textures.size();
+	_textures[view] = index;
+
+	DescriptorWriter writer;
+	writer.write_image(0, view, VK_NULL_HANDLE,
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, index);
+	writer.update_set(_device, _set);
+
+	return index;
+}
+
+std::optional<uint32_t> BindlessTable::add_sampler(VkSampler sampler) {
+	auto it = _samplers.find(sampler);
+	if (it != _samplers.end()) {
+		return it->second;
+	}
+
+	if (_samplers.size() == BINDLESS_MAX_SAMPLERS) {
+		fmt::println("Bindless sampler array is full");
+		return {};
+	}
+
+	const uint32_t index = (uint32_t)_samplers.size();
+	_samplers[sampler] = index;
+
+	DescriptorWriter writer;
+	writer.write_image(1, VK_NULL_HANDLE, sampler, VK_IMAGE_LAYOUT_UNDEFINED,
+			VK_DESCRIPTOR_TYPE_SAMPLER, index);
+	writer.update_set(_device, _set);
+
+	return index;
+}
@@ -0,0 +1,142 @@
+#include "vk_command_encoder.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+CommandEncoderStats& CommandEncoderStats::operator+=(
+		const CommandEncoderStats& other) {
+	auto add = [](EncoderCounters& a, const EncoderCounters& b) {
+		a.issued += b.issued;
+		a.elided += b.elided;
+	};
+
+	add(pipelines, other.pipelines);
+	add(descriptor_sets, other.descriptor_sets);
+	add(index_buffers, other.index_buffers);
+	add(push_constants, other.push_constants);
+	draws += other.draws;
+	indirect_draws += other.indirect_draws;
+	return *this;
+}
+
+void CommandEncoder::bind_pipeline(VkPipeline pipeline) {
+	if (pipeline == _pipeline) {
+		_stats.pipelines.elided++;
+		return;
+	}
+
+	vkCmdBindPipeline(_cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+	_pipeline = pipeline;
+	_stats.pipelines.issued++;
+}
+
+void CommandEncoder::bind_descriptor_set(VkPipelineLayout layout,
+		uint32_t set, VkDescriptorSet descriptor,
+		std::span<const uint32_t> dynamic_offsets) {
+	assert(set < MAX_DESCRIPTOR_SETS);
+	assert(dynamic_offsets.size() <= MAX_DYNAMIC_OFFSETS);
+
+	const uint32_t offset_count = (uint32_t)dynamic_offsets.size();
+	if (_set_layouts[set] == layout && _sets[set] == descriptor &&
+			_dynamic_offset_counts[set] == offset_count &&
+			std::equal(dynamic_offsets.begin(), dynamic_offsets.end(),
+					_dynamic_offsets[set])) {
+		_stats.descriptor_sets.elided++;
+		return;
+	}
+
+	vkCmdBindDescriptorSets(_cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, layout,
+			set, 1, &descriptor, offset_count, dynamic_offsets.data());
+
+	set_bound(layout, set);
+	_sets[set] = descriptor;
+	_dynamic_offset_counts[set] = offset_count;
+	std::copy(dynamic_offsets.begin(), dynamic_offsets.end(),
+			_dynamic_offsets[set]);
+	_stats.descriptor_sets.issued++;
+}
+
+void CommandEncoder::push_descriptor_set(VkPipelineLayout layout,
+		uint32_t set, const DescriptorWriter& writer) {
+	assert(set < MAX_DESCRIPTOR_SETS);
+
+	_key.clear();
+	writer.append_key(_key);
+	if (_set_layouts[set] == layout && _sets[set] == VK_NULL_HANDLE &&
+			_pushed[set] == _key) {
+		_stats.descriptor_sets.elided++;
+		return;
+	}
+
+	writer.push(_cmd, layout, set);
+
+	set_bound(layout, set);
+	_sets[set] = VK_NULL_HANDLE;
+	_dynamic_offset_counts[set] = 0;
+	_pushed[set] = _key;
+	_stats.descriptor_sets.issued++;
+}
+
+void CommandEncoder::set_bound(VkPipelineLayout layout, uint32_t set) {
+	// a set bound with another layout may be disturbed by this one. Rather
+	// than checking layout compatibility, only sets bound with the exact same
+	// layout are assumed to survive
+	for (uint32_t i = 0; i < MAX_DESCRIPTOR_SETS; i++) {
+		if (i != set && _set_layouts[i] != layout) {
+			_set_layouts[i] = VK_NULL_HANDLE;
+			_sets[i] = VK_NULL_HANDLE;
+		}
+	}
+
+	_set_layouts[set] = layout;
+}
+
+void CommandEncoder::bind_index_buffer(
+		VkBuffer buffer, VkDeviceSize offset, VkIndexType type) {
+	if (buffer == _index_buffer && offset == _index_offset &&
+			type == _index_type) {
+		_stats.index_buffers.elided++;
+		return;
+	}
+
+	vkCmdBindIndexBuffer(_cmd, buffer, offset, type);
+	_index_buffer = buffer;
+	_index_offset = offset;
+	_index_type = type;
+	_stats.index_buffers.issued++;
+}
+
+void CommandEncoder::push_constants(VkPipelineLayout layout,
+		VkShaderStageFlags stages, uint32_t size, const void* data) {
+	assert(size <= MAX_PUSH_CONSTANTS_SIZE);
+
+	if (layout == _push_layout && stages == _push_stages &&
+			size == _push_size && memcmp(data, _push_data, size) == 0) {
+		_stats.push_constants.elided++;
+		return;
+	}
+
+	vkCmdPushConstants(_cmd, layout, stages, 0, size, data);
+	_push_layout = layout;
+	_push_stages = stages;
+	_push_size = size;
+	memcpy(_push_data, data, size);
+	_stats.push_constants.issued++;
+}
+
+void CommandEncoder::draw_indexed(uint32_t index_count,
+		uint32_t instance_count, uint32_t first_index, int32_t vertex_offset,
+		uint32_t first_instance) {
+	vkCmdDrawIndexed(_cmd, index_count, instance_count, first_index,
+			vertex_offset, first_instance);
+	_stats.draws++;
+}
+
+void CommandEncoder::draw_indexed_indirect_count(VkBuffer buffer,
+		VkDeviceSize offset, VkBuffer count_buffer, VkDeviceSize count_offset,
+		uint32_t max_draw_count, uint32_t stride) {
+	vkCmdDrawIndexedIndirectCount(_cmd, buffer, offset, count_buffer,
+			count_offset, max_draw_count, stride);
+	_stats.indirect_draws++;
+}
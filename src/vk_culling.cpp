@@ -0,0 +1,180 @@
+#include "vk_culling.h"
+
+#include "vk_simd.h"
+
+#include <glm/geometric.hpp>
+
+#include <bit>
+
+Frustum make_frustum(const glm::mat4& viewproj) {
+	// rows of the matrix, glm is column major
+	glm::vec4 rows[4];
+	for (int r = 0; r < 4; r++) {
+		rows[r] = glm::vec4(
+				viewproj[0][r], viewproj[1][r], viewproj[2][r], viewproj[3][r]);
+	}
+
+	Frustum frustum = { {
+			rows[3] + rows[0], // left
+			rows[3] - rows[0], // right
+			rows[3] + rows[1], // bottom
+			rows[3] - rows[1], // top
+			rows[2], // near, depth 0
+			rows[3] - rows[2], // far, depth 1
+	} };
+
+	// normalized so the plane distance is in world units and can be compared
+	// to the radius
+	for (glm::vec4& plane : frustum.planes) {
+		plane /= glm::length(glm::vec3(plane));
+	}
+
+	return frustum;
+}
+
+CullingKernel best_culling_kernel() {
+#if CULLING_X86
+#if defined(__GNUC__) || defined(__clang__)
+	if (__builtin_cpu_supports("avx2")) {
+		return CullingKernel::AVX2;
+	}
+#elif defined(_MSC_VER)
+	int info[4];
+	__cpuidex(info, 7, 0);
+	if (info[1] & (1 << 5)) {
+		return CullingKernel::AVX2;
+	}
+#endif
+	// sse2 is part of every x86-64 cpu
+	return CullingKernel::SSE;
+#else
+	return CullingKernel::Scalar;
+#endif
+}
+
+const char* culling_kernel_name(CullingKernel kernel) {
+	switch (kernel) {
+		case CullingKernel::Scalar:
+			return "scalar";
+		case CullingKernel::SSE:
+			return "sse";
+		case CullingKernel::AVX2:
+			return "avx2";
+	}
+	return "unknown";
+}
+
+static uint32_t cull_spheres_scalar(const Frustum& frustum,
+		const SphereBatch& spheres, size_t first, uint8_t* visible) {
+	uint32_t visible_count = 0;
+	for (size_t i = first; i < spheres.size(); i++) {
+		bool inside = true;
+		for (const glm::vec4& plane : frustum.planes) {
+			// summed in the same order as the simd kernels
+			const float distance = plane.x * spheres.x[i] +
+					plane.y * spheres.y[i] + plane.z * spheres.z[i] + plane.w;
+			inside = inside && distance >= -spheres.radius[i];
+		}
+		visible[i] = inside ? 1 : 0;
+		visible_count += visible[i];
+	}
+	return visible_count;
+}
+
+#if CULLING_X86
+static uint32_t cull_spheres_sse(const Frustum& frustum,
+		const SphereBatch& spheres, uint8_t* visible) {
+	// every plane component splatted across the lanes
+	__m128 planes[6][4];
+	for (int p = 0; p < 6; p++) {
+		for (int c = 0; c < 4; c++) {
+			planes[p][c] = _mm_set1_ps(frustum.planes[p][c]);
+		}
+	}
+
+	const size_t count = spheres.size();
+	const size_t batched = count & ~size_t(3);
+
+	uint32_t visible_count = 0;
+	for (size_t i = 0; i < batched; i += 4) {
+		const __m128 x = _mm_loadu_ps(&spheres.x[i]);
+		const __m128 y = _mm_loadu_ps(&spheres.y[i]);
+		const __m128 z = _mm_loadu_ps(&spheres.z[i]);
+		const __m128 neg_radius =
+				_mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&spheres.radius[i]));
+
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (int p = 0; p < 6; p++) {
+			__m128 distance = _mm_add_ps(_mm_mul_ps(planes[p][0], x),
+					_mm_mul_ps(planes[p][1], y));
+			distance = _mm_add_ps(distance, _mm_mul_ps(planes[p][2], z));
+			distance = _mm_add_ps(distance, planes[p][3]);
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, neg_radius));
+		}
+
+		const int mask = _mm_movemask_ps(inside);
+		for (int lane = 0; lane < 4; lane++) {
+			visible[i + lane] = (mask >> lane) & 1;
+		}
+		visible_count += std::popcount((uint32_t)mask);
+	}
+
+	return visible_count +
+			cull_spheres_scalar(frustum, spheres, batched, visible);
+}
+
+CULLING_TARGET_AVX2 static uint32_t cull_spheres_avx2(const Frustum& frustum,
+		const SphereBatch& spheres, uint8_t* visible) {
+	__m256 planes[6][4];
+	for (int p = 0; p < 6; p++) {
+		for (int c = 0; c < 4; c++) {
+			planes[p][c] = _mm256_set1_ps(frustum.planes[p][c]);
+		}
+	}
+
+	const size_t count = spheres.size();
+	const size_t batched = count & ~size_t(7);
+
+	uint32_t visible_count = 0;
+	for (size_t i = 0; i < batched; i += 8) {
+		const __m256 x = _mm256_loadu_ps(&spheres.x[i]);
+		const __m256 y = _mm256_loadu_ps(&spheres.y[i]);
+		const __m256 z = _mm256_loadu_ps(&spheres.z[i]);
+		const __m256 neg_radius = _mm256_sub_ps(
+				_mm256_setzero_ps(), _mm256_loadu_ps(&spheres.radius[i]));
+
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (int p = 0; p < 6; p++) {
+			__m256 distance = _mm256_add_ps(_mm256_mul_ps(planes[p][0], x),
+					_mm256_mul_ps(planes[p][1], y));
+			distance = _mm256_add_ps(distance, _mm256_mul_ps(planes[p][2], z));
+			distance = _mm256_add_ps(distance, planes[p][3]);
+			inside = _mm256_and_ps(
+					inside, _mm256_cmp_ps(distance, neg_radius, _CMP_GE_OQ));
+		}
+
+		const int mask = _mm256_movemask_ps(inside);
+		for (int lane = 0; lane < 8; lane++) {
+			visible[i + lane] = (mask >> lane) & 1;
+		}
+		visible_count += std::popcount((uint32_t)mask);
+	}
+
+	return visible_count +
+			cull_spheres_scalar(frustum, spheres, batched, visible);
+}
+#endif
+
+uint32_t cull_spheres(const Frustum& frustum, const SphereBatch& spheres,
+		uint8_t* visible, CullingKernel kernel) {
+	switch (kernel) {
+#if CULLING_X86
+		case CullingKernel::AVX2:
+			return cull_spheres_avx2(frustum, spheres, visible);
+		case CullingKernel::SSE:
+			return cull_spheres_sse(frustum, spheres, visible);
+#endif
+		default:
+			return cull_spheres_scalar(frustum, spheres, 0, visible);
+	}
+}
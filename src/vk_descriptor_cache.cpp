@@ -0,0 +1,110 @@
+#include "vk_descriptor_cache.h"
+
+#include "vk_utils.h"
+
+#include <algorithm>
+#include <cassert>
+
+void DescriptorSetCache::init(
+		DescriptorAllocatorGrowable* allocator, uint32_t capacity) {
+	_allocator = allocator;
+	_capacity = capacity;
+}
+
+VkDescriptorSet DescriptorSetCache::acquire(VkDevice device,
+		VkDescriptorSetLayout layout, DescriptorWriter& writer) {
+	_key.clear();
+	_key.push_back((uint64_t)layout);
+	writer.append_key(_key);
+	const uint64_t hash =
+			vkutil::hash_bytes(_key.data(), _key.size() * sizeof(uint64_t));
+
+	auto [first, last] = _sets.equal_range(hash);
+	for (auto it = first; it != last; ++it) {
+		Entry& entry = _entries.at(it->second);
+		if (entry.key != _key) {
+			continue;
+		}
+
+		if (entry.references++ == 0) {
+			_released.erase(entry.released);
+		}
+		_stats.hits++;
+
+		return it->second;
+	}
+
+	_stats.misses++;
+
+	if (_entries.size() >= _capacity) {
+		evict();
+	}
+
+	// sets are evicted in release order, so if the oldest one is still in
+	// use by a frame in flight so are the others
+	VkDescriptorSet set;
+	auto free = _free.find(layout);
+	const bool has_free = free != _free.end() && !free->second.empty();
+	if (has_free && _completed_frame.has_value() &&
+			free->second.front().frame <= _completed_frame.value()) {
+		set = free->second.front().set;
+		free->second.pop_front();
+		_stats.reuses++;
+	} else {
+		set = _allocator->allocate(device, layout);
+		if (has_free) {
+			_stats.deferred_reuses++;
+		}
+	}
+
+	writer.update_set(device, set);
+
+	_entries[set] = Entry{
+		.key = _key,
+		.hash = hash,
+		.layout = layout,
+		.references = 1,
+		.frame = 0,
+	};
+	_sets.emplace(hash, set);
+	_stats.entries = (uint32_t)_entries.size();
+
+	return set;
+}
+
+void DescriptorSetCache::release(VkDescriptorSet set, uint64_t frame) {
+	auto it = _entries.find(set);
+	assert(it != _entries.end() && it->second.references > 0);
+
+	Entry& entry = it->second;
+	entry.frame = std::max(entry.frame, frame);
+	if (--entry.references == 0) {
+		entry.released = _released.insert(_released.end(), set);
+	}
+}
+
+void DescriptorSetCache::evict() {
+	// every set is referenced, let the cache grow
+	if (_released.empty()) {
+		return;
+	}
+
+	VkDescriptorSet set = _released.front();
+	_released.pop_front();
+
+	auto entry = _entries.find(set);
+	auto [first, last] = _sets.equal_range(entry->second.hash);
+	for (auto it = first; it != last; ++it) {
+		if (it->second == set) {
+			_sets.erase(it);
+			break;
+		}
+	}
+
+	_free[entry->second.layout].push_back(
+			EvictedSet{ .set = set, .frame = entry->second.frame });
+	_entries.erase(entry);
+
+	_stats.evictions++;
+	_stats.entries = (uint32_t)_entries.size();
+}
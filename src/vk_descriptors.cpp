@@ -2,11 +2,15 @@
 
 #include <vulkan/vulkan_core.h>
 
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+
 void DescriptorLayoutBuilder::add_binding(
-		uint32_t binding, VkDescriptorType type) {
+		uint32_t binding, VkDescriptorType type, uint32_t count) {
 	VkDescriptorSetLayoutBinding new_binding{};
 	new_binding.binding = binding;
-	new_binding.descriptorCount = 1;
+	new_binding.descriptorCount = count;
 	new_binding.descriptorType = type;
 
 	bindings.push_back(new_binding);
@@ -35,6 +39,21 @@ VkDescriptorSetLayout DescriptorLayoutBuilder::build(VkDevice device,
 	return set;
 }
 
+VkDescriptorSetLayout DescriptorLayoutBuilder::build_push(
+		VkDevice device, VkShaderStageFlags shader_stages) {
+	return build(device, shader_stages, nullptr,
+			VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR);
+}
+
+static PFN_vkCmdPushDescriptorSetKHR push_descriptor_set = nullptr;
+
+bool load_push_descriptor(VkDevice device) {
+	push_descriptor_set = (PFN_vkCmdPushDescriptorSetKHR)vkGetDeviceProcAddr(
+			device, "vkCmdPushDescriptorSetKHR");
+
+	return push_descriptor_set != nullptr;
+}
+
 void DescriptorAllocator::init_pool(VkDevice device, uint32_t max_sets,
 		std::span<PoolSizeRatio> pool_ratios) {
 	std::vector<VkDescriptorPoolSize> pool_sizes;
@@ -80,6 +99,22 @@ VkDescriptorSet DescriptorAllocator::allocate(
 	return ds;
 }
 
+// adds count descriptors of type to the sizes
+static void add_descriptors(std::vector<VkDescriptorPoolSize>& sizes,
+		VkDescriptorType type, uint32_t count) {
+	for (VkDescriptorPoolSize& size : sizes) {
+		if (size.type == type) {
+			size.descriptorCount += count;
+			return;
+		}
+	}
+
+	sizes.push_back(VkDescriptorPoolSize{
+			.type = type,
+			.descriptorCount = count,
+	});
+}
+
 void DescriptorAllocatorGrowable::init(VkDevice device, uint32_t initial_sets,
 		std::span<PoolSizeRatio> pool_size_ratios) {
 	_ratios.clear();
@@ -107,6 +142,11 @@ void DescriptorAllocatorGrowable::clear_pools(VkDevice device) {
 	}
 
 	_full_pools.clear();
+
+	for (DescriptorPoolUsage& usage : _pool_usage) {
+		usage.sets = 0;
+		usage.descriptors.clear();
+	}
 }
 
 void DescriptorAllocatorGrowable::destroy_pools(VkDevice device) {
@@ -115,34 +155,37 @@ void DescriptorAllocatorGrowable::destroy_pools(VkDevice device) {
 	}
 	for (auto p : _full_pools) {
 		vkDestroyDescriptorPool(device, p, nullptr);
-		_ready_pools.push_back(p);
 	}
 
+	_ready_pools.clear();
 	_full_pools.clear();
+	_pool_usage.clear();
+}
+
+void DescriptorAllocatorGrowable::describe_layout(VkDescriptorSetLayout layout,
+		std::span<const VkDescriptorSetLayoutBinding> bindings) {
+	std::vector<VkDescriptorPoolSize>& sizes = _layouts[layout];
+	sizes.clear();
+	for (const VkDescriptorSetLayoutBinding& binding : bindings) {
+		add_descriptors(sizes, binding.descriptorType, binding.descriptorCount);
+	}
 }
 
 VkDescriptorSet DescriptorAllocatorGrowable::allocate(
 		VkDevice device, VkDescriptorSetLayout layout, void* next) {
 	VkDescriptorPool pool_to_use = get_pool(device);
 
-	VkDescriptorSetAllocateInfo alloc_info = {
-		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
-		.pNext = next,
-		.descriptorPool = pool_to_use,
-		.descriptorSetCount = 1,
-		.pSetLayouts = &layout,
-	};
-
 	VkDescriptorSet ds;
 
-	VkResult res = vkAllocateDescriptorSets(device, &alloc_info, &ds);
+	VkResult res = allocate_from(device, pool_to_use, { &layout, 1 }, &ds,
+			next);
 	if (res == VK_ERROR_OUT_OF_POOL_MEMORY || res == VK_ERROR_FRAGMENTED_POOL) {
 		_full_pools.push_back(pool_to_use);
 
 		pool_to_use = get_pool(device);
-		alloc_info.descriptorPool = pool_to_use;
 
-		VK_CHECK(vkAllocateDescriptorSets(device, &alloc_info, &ds));
+		VK_CHECK(allocate_from(
+				device, pool_to_use, { &layout, 1 }, &ds, next));
 	}
 
 	_ready_pools.push_back(pool_to_use);
@@ -150,13 +193,137 @@ VkDescriptorSet DescriptorAllocatorGrowable::allocate(
 	return ds;
 }
 
+std::vector<VkDescriptorSet> DescriptorAllocatorGrowable::allocate_many(
+		VkDevice device, std::span<const VkDescriptorSetLayout> layouts) {
+	std::vector<VkDescriptorSet> sets(layouts.size());
+
+	VkDescriptorPool pool_to_use = get_pool(device);
+
+	size_t done = 0;
+	while (done < layouts.size()) {
+		const DescriptorPoolUsage& usage = usage_of(pool_to_use);
+		const bool empty = usage.sets == 0;
+
+		size_t count = std::min<size_t>(
+				usage.max_sets - usage.sets, layouts.size() - done);
+
+		VkResult res = VK_ERROR_OUT_OF_POOL_MEMORY;
+		while (count > 0) {
+			res = allocate_from(device, pool_to_use,
+					layouts.subspan(done, count), &sets[done]);
+			if (res != VK_ERROR_OUT_OF_POOL_MEMORY &&
+					res != VK_ERROR_FRAGMENTED_POOL) {
+				break;
+			}
+			count /= 2;
+		}
+
+		if (count == 0) {
+			// a pool without a single set in it that cannot take one set
+			// never will
+			if (empty) {
+				VK_CHECK(res);
+			}
+
+			_full_pools.push_back(pool_to_use);
+			pool_to_use = get_pool(device);
+			continue;
+		}
+
+		VK_CHECK(res);
+		done += count;
+	}
+
+	_ready_pools.push_back(pool_to_use);
+
+	return sets;
+}
+
+VkResult DescriptorAllocatorGrowable::allocate_from(VkDevice device,
+		VkDescriptorPool pool, std::span<const VkDescriptorSetLayout> layouts,
+		VkDescriptorSet* sets, void* next) {
+	VkDescriptorSetAllocateInfo alloc_info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+		.pNext = next,
+		.descriptorPool = pool,
+		.descriptorSetCount = (uint32_t)layouts.size(),
+		.pSetLayouts = layouts.data(),
+	};
+
+	VkResult res = vkAllocateDescriptorSets(device, &alloc_info, sets);
+
+	DescriptorPoolUsage& usage = usage_of(pool);
+	_stats.allocate_calls++;
+	if (res != VK_SUCCESS) {
+		_stats.failed_calls++;
+		usage.failures++;
+		return res;
+	}
+
+	usage.sets += (uint32_t)layouts.size();
+	_stats.sets += (uint32_t)layouts.size();
+
+	for (VkDescriptorSetLayout layout : layouts) {
+		auto it = _layouts.find(layout);
+		if (it == _layouts.end()) {
+			continue;
+		}
+
+		for (const VkDescriptorPoolSize& size : it->second) {
+			add_descriptors(usage.descriptors, size.type, size.descriptorCount);
+			add_descriptors(_demand, size.type, size.descriptorCount);
+		}
+		_demand_sets++;
+	}
+
+	return res;
+}
+
+DescriptorPoolUsage& DescriptorAllocatorGrowable::usage_of(
+		VkDescriptorPool pool) {
+	auto it = std::find_if(_pool_usage.begin(), _pool_usage.end(),
+			[&](const DescriptorPoolUsage& usage) {
+				return usage.pool == pool;
+			});
+	// every pool comes from create_pool, a miss means the pool belongs to
+	// another allocator
+	if (it == _pool_usage.end()) {
+		fmt::println("Descriptor pool does not belong to this allocator");
+		abort();
+	}
+
+	return *it;
+}
+
+void DescriptorAllocatorGrowable::adapt_ratios() {
+	if (_demand_sets == 0) {
+		return;
+	}
+
+	for (const VkDescriptorPoolSize& demand : _demand) {
+		const float ratio = (float)demand.descriptorCount / _demand_sets;
+
+		auto it = std::find_if(_ratios.begin(), _ratios.end(),
+				[&](const PoolSizeRatio& r) { return r.type == demand.type; });
+		if (it != _ratios.end()) {
+			it->ratio = ratio;
+		} else {
+			_ratios.push_back(PoolSizeRatio{
+					.type = demand.type,
+					.ratio = ratio,
+			});
+		}
+	}
+}
+
 VkDescriptorPool DescriptorAllocatorGrowable::get_pool(VkDevice device) {
 	VkDescriptorPool new_pool;
 	if (_ready_pools.size() != 0) {
 		new_pool = _ready_pools.back();
 		_ready_pools.pop_back();
 	} else {
-		// need to create a new pool
+		// need to create a new pool, sized for what was asked of the others
+		adapt_ratios();
 		new_pool = create_pool(device, _sets_per_pool, _ratios);
 
 		_sets_per_pool *= 1.5f;
@@ -172,10 +339,11 @@ VkDescriptorPool DescriptorAllocatorGrowable::create_pool(VkDevice device,
 		uint32_t set_count, std::span<PoolSizeRatio> pool_ratios) {
 	std::vector<VkDescriptorPoolSize> pool_sizes;
 	for (PoolSizeRatio ratio : pool_ratios) {
+		// a demand below one descriptor per set still needs some
 		pool_sizes.push_back(VkDescriptorPoolSize{
 				.type = ratio.type,
-				.descriptorCount =
-						static_cast<uint32_t>(ratio.ratio * set_count),
+				.descriptorCount = std::max(1u,
+						static_cast<uint32_t>(ratio.ratio * set_count)),
 		});
 	}
 
@@ -190,6 +358,13 @@ VkDescriptorPool DescriptorAllocatorGrowable::create_pool(VkDevice device,
 	VkDescriptorPool new_pool;
 	vkCreateDescriptorPool(device, &pool_info, nullptr, &new_pool);
 
+	_pool_usage.push_back(DescriptorPoolUsage{
+			.pool = new_pool,
+			.max_sets = set_count,
+			.max_descriptors = std::move(pool_sizes),
+	});
+	_stats.pools_created++;
+
 	return new_pool;
 }
 
@@ -215,7 +390,8 @@ void DescriptorWriter::write_buffer(int binding, VkBuffer buffer, size_t size,
 }
 
 void DescriptorWriter::write_image(int binding, VkImageView image,
-		VkSampler sampler, VkImageLayout layout, VkDescriptorType type) {
+		VkSampler sampler, VkImageLayout layout, VkDescriptorType type,
+		uint32_t array_element) {
 	VkDescriptorImageInfo& info =
 			image_infos.emplace_back(VkDescriptorImageInfo{
 					.sampler = sampler,
@@ -227,6 +403,7 @@ void DescriptorWriter::write_image(int binding, VkImageView image,
 		.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
 		.dstSet = VK_NULL_HANDLE, //left empty for now until we need to write it
 		.dstBinding = static_cast<uint32_t>(binding),
+		.dstArrayElement = array_element,
 		.descriptorCount = 1,
 		.descriptorType = type,
 		.pImageInfo = &info,
@@ -249,3 +426,36 @@ void DescriptorWriter::update_set(VkDevice device, VkDescriptorSet set) {
 	vkUpdateDescriptorSets(
 			device, (uint32_t)writes.size(), writes.data(), 0, nullptr);
 }
+
+void DescriptorWriter::push(VkCommandBuffer cmd, VkPipelineLayout layout,
+		uint32_t set, VkPipelineBindPoint bind_point) const {
+	assert(push_descriptor_set);
+
+	// dstSet is ignored, the writes go straight into the command buffer
+	push_descriptor_set(cmd, bind_point, layout, set, (uint32_t)writes.size(),
+			writes.data());
+}
+
+void DescriptorWriter::append_key(std::vector<uint64_t>& key) const {
+	for (const VkWriteDescriptorSet& write : writes) {
+		key.push_back(
+				((uint64_t)write.dstBinding << 32) | write.dstArrayElement);
+		key.push_back(
+				((uint64_t)write.descriptorType << 32) | write.descriptorCount);
+
+		for (uint32_t i = 0; i < write.descriptorCount; i++) {
+			if (write.pImageInfo) {
+				const VkDescriptorImageInfo& info = write.pImageInfo[i];
+				key.push_back((uint64_t)info.sampler);
+				key.push_back((uint64_t)info.imageView);
+				key.push_back((uint64_t)info.imageLayout);
+			}
+			if (write.pBufferInfo) {
+				const VkDescriptorBufferInfo& info = write.pBufferInfo[i];
+				key.push_back((uint64_t)info.buffer);
+				key.push_back(info.offset);
+				key.push_back(info.range);
+			}
+		}
+	}
+}
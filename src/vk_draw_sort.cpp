@@ -0,0 +1,78 @@
+#include "vk_draw_sort.h"
+
+#include <algorithm>
+#include <cstring>
+
+static uint64_t quantize_depth(float view_depth) {
+	// the bits of a positive float grow with its value, so their top 16 bits
+	// are a logarithmic quantization that keeps precision close to the camera
+	const float depth = std::max(view_depth, 0.0f);
+	uint32_t bits;
+	memcpy(&bits, &depth, sizeof(bits));
+	return bits >> 16;
+}
+
+uint64_t make_draw_key(MaterialPass pass, uint32_t pipeline_id,
+		uint32_t material_id, uint32_t mesh_id, float view_depth) {
+	// the projection maps farther points to greater depths and the depth test
+	// keeps the greater one, so drawing far to near is what lets early depth
+	// testing reject fragments. Blended draws have to go far to near anyway.
+	const uint64_t depth = 0xffff - quantize_depth(view_depth);
+
+	return ((uint64_t)pass & 0x3) << 62 |
+			((uint64_t)pipeline_id & 0x3f) << 56 |
+			((uint64_t)material_id & 0xffff) << 40 |
+			((uint64_t)mesh_id & 0xffffff) << 16 | depth;
+}
+
+uint64_t make_blended_draw_key(
+		uint32_t material_id, uint32_t mesh_id, float view_depth) {
+	const uint64_t depth = 0xffff - quantize_depth(view_depth);
+
+	return depth << 40 | ((uint64_t)material_id & 0xffff) << 24 |
+			((uint64_t)mesh_id & 0xffffff);
+}
+
+void DrawSorter::sort(
+		std::span<const uint64_t> keys, std::vector<uint32_t>& order) {
+	const size_t count = keys.size();
+
+	_items.resize(count);
+	_scratch.resize(count);
+
+	// histograms of all eight digits in a single read of the keys
+	uint32_t histograms[8][256] = {};
+	for (size_t i = 0; i < count; i++) {
+		_items[i] = Item{ .key = keys[i], .index = (uint32_t)i };
+		for (uint32_t d = 0; d < 8; d++) {
+			histograms[d][(keys[i] >> (d * 8)) & 0xff]++;
+		}
+	}
+
+	for (uint32_t d = 0; d < 8; d++) {
+		uint32_t* histogram = histograms[d];
+
+		// every key has the same digit, the pass would not move anything
+		if (count == 0 ||
+				histogram[(_items[0].key >> (d * 8)) & 0xff] == count) {
+			continue;
+		}
+
+		uint32_t offset = 0;
+		for (uint32_t b = 0; b < 256; b++) {
+			uint32_t bucket_count = histogram[b];
+			histogram[b] = offset;
+			offset += bucket_count;
+		}
+
+		for (const Item& item : _items) {
+			_scratch[histogram[(item.key >> (d * 8)) & 0xff]++] = item;
+		}
+		std::swap(_items, _scratch);
+	}
+
+	order.resize(count);
+	for (size_t i = 0; i < count; i++) {
+		order[i] = _items[i].index;
+	}
+}
@@ -26,8 +26,11 @@
 #include <imgui.h>
 
 #include <algorithm>
+#include <bit>
 #include <chrono>
+#include <cstring>
 #include <thread>
+#include <type_traits>
 
 void GLTFMetallic_Roughness::build_pipeline(VulkanEngine* engine) {
 	VkShaderModule mesh_frag_shader;
@@ -36,29 +39,28 @@ void GLTFMetallic_Roughness::build_pipeline(VulkanEngine* engine) {
 		fmt::println("Error while building the mesh fragment shader.");
 	}
 
+	// packed vertices need their own vertex fetch and a dequantization
+	// transform per draw
+	const bool packed = engine->uses_packed_vertices();
+
 	VkShaderModule mesh_vert_shader;
 	if (!vkutil::load_shader_module(
-				"mesh.vert.spv", engine->_device, &mesh_vert_shader)) {
+				packed ? "mesh_packed.vert.spv" : "mesh.vert.spv",
+				engine->_device, &mesh_vert_shader)) {
 		fmt::println("Error while building the mesh vertex shader.");
 	}
 
 	VkPushConstantRange matrix_range = {
 		.stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
 		.offset = 0,
-		.size = sizeof(GPUDrawPushConstants),
+		.size = packed ? (uint32_t)sizeof(GPUPackedDrawPushConstants)
+					   : (uint32_t)sizeof(GPUInstancedDrawPushConstants),
 	};
 
-	DescriptorLayoutBuilder layout_builder;
-	layout_builder.add_binding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
-	layout_builder.add_binding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
-	layout_builder.add_binding(2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
-
-	material_layout = layout_builder.build(engine->_device,
-			VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT);
-
+	// materials are all in the bindless set, picked by the push constants
 	VkDescriptorSetLayout layouts[] = {
 		engine->_gpu_scene_data_descriptor_layout,
-		material_layout,
+		engine->_bindless.layout(),
 	};
 
 	VkPipelineLayoutCreateInfo mesh_layout_info =
@@ -73,7 +75,15 @@ void GLTFMetallic_Roughness::build_pipeline(VulkanEngine* engine) {
 			engine->_device, &mesh_layout_info, nullptr, &new_layout));
 
 	opaque_pipeline.layout = new_layout;
+	depth_prepass_pipeline.layout = new_layout;
+	depth_equal_pipeline.layout = new_layout;
 	transparent_pipeline.layout = new_layout;
+	oit_transparent_pipeline.layout = new_layout;
+	opaque_pipeline.id = 0;
+	depth_prepass_pipeline.id = opaque_pipeline.id;
+	depth_equal_pipeline.id = opaque_pipeline.id;
+	transparent_pipeline.id = 1;
+	oit_transparent_pipeline.id = 2;
 
 	// build the stage-create-info for both vertex and fragment stages. This
 	// lets
@@ -98,69 +108,186 @@ void GLTFMetallic_Roughness::build_pipeline(VulkanEngine* engine) {
 	// finally build the pipeline
 	opaque_pipeline.pipeline = pipeline_builder.build_pipeline(engine->_device);
 
-	// create the transparent variant
-	pipeline_builder.enable_blending_additive();
+	// over a depth prepass the color pass only shades the fragments that
+	// ended up visible
+	pipeline_builder.enable_depthtest(false, VK_COMPARE_OP_EQUAL);
+
+	depth_equal_pipeline.pipeline =
+			pipeline_builder.build_pipeline(engine->_device);
+
+	// the prepass itself reads the position stream and writes depth alone.
+	// It pushes the same constants, with the position stream in place of
+	// the vertex buffer.
+	VkShaderModule depth_prepass_vert_shader;
+	if (!vkutil::load_shader_module(packed ? "depth_prepass_packed.vert.spv"
+												: "depth_prepass.vert.spv",
+				engine->_device, &depth_prepass_vert_shader)) {
+		fmt::println("Error while building the depth prepass shader.");
+	}
+
+	pipeline_builder.set_shaders(depth_prepass_vert_shader, VK_NULL_HANDLE);
+	pipeline_builder.clear_color_attachments();
+	pipeline_builder.enable_depthtest(true, VK_COMPARE_OP_GREATER_OR_EQUAL);
+
+	depth_prepass_pipeline.pipeline =
+			pipeline_builder.build_pipeline(engine->_device);
+
+	pipeline_builder.set_shaders(mesh_vert_shader, mesh_frag_shader);
+	pipeline_builder.set_color_attachment_format(
+			engine->_draw_image.image_format);
+
+	// create the transparent variant, tested against the opaque depth but
+	// not writing it
+	pipeline_builder.enable_blending_alphablend();
 	pipeline_builder.enable_depthtest(false, VK_COMPARE_OP_GREATER_OR_EQUAL);
 
 	transparent_pipeline.pipeline =
 			pipeline_builder.build_pipeline(engine->_device);
 
+	// and the order independent one, drawn into the weighted blended targets
+	VkShaderModule mesh_oit_frag_shader;
+	if (!vkutil::load_shader_module(
+				"mesh_oit.frag.spv", engine->_device, &mesh_oit_frag_shader)) {
+		fmt::println("Error while building the oit mesh fragment shader.");
+	}
+
+	pipeline_builder.set_shaders(mesh_vert_shader, mesh_oit_frag_shader);
+	pipeline_builder.set_weighted_blended_attachments(
+			engine->_oit_accum_image.image_format,
+			engine->_oit_revealage_image.image_format);
+
+	oit_transparent_pipeline.pipeline =
+			pipeline_builder.build_pipeline(engine->_device);
+
+	// the indirect variant reads its transform from the object records, so
+	// it only pushes buffer addresses. Transparent surfaces always go
+	// through the cpu draw list.
+	VkShaderModule indirect_vert_shader;
+	if (!vkutil::load_shader_module(packed ? "mesh_packed_indirect.vert.spv"
+												: "mesh_indirect.vert.spv",
+				engine->_device, &indirect_vert_shader)) {
+		fmt::println("Error while building the indirect mesh vertex shader.");
+	}
+
+	VkPushConstantRange indirect_range = {
+		.stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+		.offset = 0,
+		.size = sizeof(GPUIndirectDrawPushConstants),
+	};
+	mesh_layout_info.pPushConstantRanges = &indirect_range;
+
+	VkPipelineLayout indirect_layout;
+	VK_CHECK(vkCreatePipelineLayout(
+			engine->_device, &mesh_layout_info, nullptr, &indirect_layout));
+
+	indirect_opaque_pipeline.layout = indirect_layout;
+	indirect_opaque_pipeline.id = opaque_pipeline.id;
+
+	pipeline_builder.pipeline_layout = indirect_layout;
+	pipeline_builder.set_shaders(indirect_vert_shader, mesh_frag_shader);
+	pipeline_builder.set_color_attachment_format(
+			engine->_draw_image.image_format);
+	pipeline_builder.disable_blending();
+	pipeline_builder.enable_depthtest(true, VK_COMPARE_OP_GREATER_OR_EQUAL);
+
+	indirect_opaque_pipeline.pipeline =
+			pipeline_builder.build_pipeline(engine->_device);
+
 	vkDestroyShaderModule(engine->_device, mesh_frag_shader, nullptr);
+	vkDestroyShaderModule(engine->_device, mesh_oit_frag_shader, nullptr);
 	vkDestroyShaderModule(engine->_device, mesh_vert_shader, nullptr);
+	vkDestroyShaderModule(engine->_device, depth_prepass_vert_shader, nullptr);
+	vkDestroyShaderModule(engine->_device, indirect_vert_shader, nullptr);
 }
 
 void GLTFMetallic_Roughness::clear_resources(VkDevice device) {}
 
-MaterialInstance GLTFMetallic_Roughness::write_material(VkDevice device,
-		MaterialPass pass, const MaterialResources& resources,
-		DescriptorAllocatorGrowable& descriptor_allocator) {
+MaterialInstance GLTFMetallic_Roughness::write_material(MaterialPass pass,
+		const MaterialResources& resources, BindlessTable& bindless,
+		MaterialRegistry& registry) {
 	MaterialInstance mat_data;
 	mat_data.pass_type = pass;
 	switch (mat_data.pass_type) {
 		case MaterialPass::Transparent:
 			mat_data.pipeline = &transparent_pipeline;
+			mat_data.indirect_pipeline = nullptr;
+			mat_data.oit_pipeline = &oit_transparent_pipeline;
+			mat_data.depth_prepass_pipeline = nullptr;
+			mat_data.depth_equal_pipeline = nullptr;
 			break;
 		case MaterialPass::MainColor:
-			mat_data.pipeline = &opaque_pipeline;
-			break;
 		default:
 			mat_data.pipeline = &opaque_pipeline;
+			mat_data.indirect_pipeline = &indirect_opaque_pipeline;
+			mat_data.oit_pipeline = nullptr;
+			mat_data.depth_prepass_pipeline = &depth_prepass_pipeline;
+			mat_data.depth_equal_pipeline = &depth_equal_pipeline;
 			break;
 	}
 
-	mat_data.material_set =
-			descriptor_allocator.allocate(device, material_layout);
-
-	writer.clear();
-	writer.write_buffer(0, resources.data_buffer, sizeof(MaterialConstants),
-			resources.data_buffer_offset, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
-	writer.write_image(1, resources.color_image.image_view,
-			resources.color_sampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-			VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
-	writer.write_image(2, resources.metal_roughness_image.image_view,
-			resources.metal_roughness_sampler,
-			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-			VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
-
-	writer.update_set(device, mat_data.material_set);
+	// a full table falls back to its first entries, the default texture,
+	// sampler and material
+	const AllocatedImage& color = resources.color_image;
+	const AllocatedImage& metal_rough = resources.metal_roughness_image;
+	const GPUMaterial constants = {
+		.color_factors = resources.color_factors,
+		.metal_rough_factors = resources.metal_rough_factors,
+		.color_texture = bindless.add_texture(color.image_view).value_or(0),
+		.color_sampler =
+				bindless.add_sampler(resources.color_sampler).value_or(0),
+		.metal_rough_texture =
+				bindless.add_texture(metal_rough.image_view).value_or(0),
+		.metal_rough_sampler =
+				bindless.add_sampler(resources.metal_roughness_sampler)
+						.value_or(0),
+	};
+	mat_data.id = registry.add(constants).value_or(0);
 
 	return mat_data;
 }
 
 void MeshNode::draw(const glm::mat4& top_matrix, DrawContext& ctx) {
+	// the mesh is still streaming in
+	if (mesh->mesh_buffers.upload_ticket.value > ctx.usable_uploads.value) {
+		return;
+	}
+
 	glm::mat4 node_matrix = top_matrix * world_transform;
 
+	// only a mesh that is opaque all over hides what is behind it
+	bool opaque = true;
+
 	for (auto& s : mesh->surfaces) {
+		MaterialInstance* material = ctx.material_override
+				? ctx.material_override
+				: &s.material->data;
+
 		RenderObject def = {
+			.surface_id = s.id,
 			.index_count = s.count,
-			.first_index = s.start_index,
-			.index_buffer = mesh->mesh_buffers.index_buffer.buffer,
-			.material = &s.material->data,
+			.first_index = mesh->mesh_buffers.first_index + s.start_index,
+			.vertex_offset = mesh->mesh_buffers.vertex_offset,
+			.index_type = mesh->mesh_buffers.index_type,
+			.material = material,
+			.bounds = s.bounds,
 			.transform = node_matrix,
-			.vertex_buffer_address = mesh->mesh_buffers.vertex_buffer_address,
+			.position_offset = mesh->mesh_buffers.position_offset,
+			.position_scale = mesh->mesh_buffers.position_scale,
 		};
 
-		ctx.opaque_surfaces.push_back(def);
+		if (material->pass_type == MaterialPass::Transparent) {
+			ctx.transparent.surfaces.push_back(def);
+			opaque = false;
+		} else {
+			ctx.opaque.surfaces.push_back(def);
+		}
+	}
+
+	if (mesh->occluder && opaque) {
+		ctx.occluders.push_back(OccluderInstance{
+				.mesh = mesh->occluder.get(),
+				.transform = node_matrix,
+		});
 	}
 }
 
@@ -168,24 +295,69 @@ constexpr bool USE_VALIDATION_LAYERS = false;
 
 constexpr uint64_t ONE_SECOND_IN_NANOSECONDS = 1000000000;
 
+// sizes of the buffers every mesh is suballocated from
+constexpr VkDeviceSize GEOMETRY_VERTEX_CAPACITY = 256 * 1024 * 1024;
+constexpr VkDeviceSize GEOMETRY_INDEX_CAPACITY = 64 * 1024 * 1024;
+
+// uniform data a frame can write, reset once the frame's fence signals. Only
+// the frame constants go through it, see write_uniform.
+constexpr VkDeviceSize UNIFORM_ARENA_SIZE = 256 * 1024;
+// the largest minUniformBufferOffsetAlignment the spec allows
+constexpr VkDeviceSize MAX_UNIFORM_ALIGNMENT = 256;
+static_assert(UNIFORM_ARENA_SIZE >=
+				sizeof(GPUSceneData) + sizeof(GPUCullData) +
+						2 * MAX_UNIFORM_ALIGNMENT,
+		"the uniform arena must hold one frame's constants");
+
+// resolution of the software occlusion buffer, about the aspect of the window
+constexpr uint32_t OCCLUSION_BUFFER_WIDTH = 256;
+constexpr uint32_t OCCLUSION_BUFFER_HEIGHT = 128;
+
+// visible surfaces one software occlusion job tests
+constexpr size_t OCCLUSION_TEST_CHUNK = 256;
+
+// material slots, the draw sort keys have room for 65536
+constexpr uint32_t MATERIAL_CAPACITY = 16384;
+
+// distinct sets a descriptor cache keeps before evicting released ones
+constexpr uint32_t DESCRIPTOR_CACHE_CAPACITY = 1024;
+
 VulkanEngine* loaded_engine = nullptr;
 
 VulkanEngine& VulkanEngine::get() { return *loaded_engine; }
 
-void VulkanEngine::init() {
+void VulkanEngine::init(const EngineOptions& options) {
 	// only one engine initialization is allowed with the application.
 	assert(loaded_engine == nullptr);
 	loaded_engine = this;
 
-	// We initialize SDL and create a window with it.
-	SDL_Init(SDL_INIT_VIDEO);
-
-	SDL_WindowFlags window_flags =
-			(SDL_WindowFlags)(SDL_WINDOW_VULKAN | SDL_WINDOW_RESIZABLE);
-
-	_window = SDL_CreateWindow("Vulkan Engine", SDL_WINDOWPOS_UNDEFINED,
-			SDL_WINDOWPOS_UNDEFINED, _window_extent.width,
-			_window_extent.height, window_flags);
+	_options = options;
+	_transparency_mode = _options.transparency;
+
+	_job_system.init(std::max(1u, std::thread::hardware_concurrency()));
+	_record_threads = _options.record_threads.empty()
+			? 0
+			: std::min(_options.record_threads.front(),
+					  _job_system.thread_count());
+	_depth_prepass = !_options.depth_prepass.empty() &&
+			_options.depth_prepass.front();
+	_occlusion_culling = _options.occlusion_culling;
+	_cpu_occlusion = _options.cpu_occlusion;
+	_occlusion_buffer.init(OCCLUSION_BUFFER_WIDTH, OCCLUSION_BUFFER_HEIGHT);
+
+	// headless runs render straight into the draw image, so they need neither
+	// a window nor a swapchain
+	if (!_options.headless) {
+		// We initialize SDL and create a window with it.
+		SDL_Init(SDL_INIT_VIDEO);
+
+		SDL_WindowFlags window_flags =
+				(SDL_WindowFlags)(SDL_WINDOW_VULKAN | SDL_WINDOW_RESIZABLE);
+
+		_window = SDL_CreateWindow("Vulkan Engine", SDL_WINDOWPOS_UNDEFINED,
+				SDL_WINDOWPOS_UNDEFINED, _window_extent.width,
+				_window_extent.height, window_flags);
+	}
 
 	init_vulkan();
 
@@ -199,7 +371,11 @@ void VulkanEngine::init() {
 
 	init_pipelines();
 
-	init_imgui();
+	init_geometry_buffer();
+
+	if (!_options.headless) {
+		init_imgui();
+	}
 
 	init_default_data();
 
@@ -218,7 +394,11 @@ void VulkanEngine::cleanup() {
 
 		_deletion_queue.flush();
 
-		SDL_DestroyWindow(_window);
+		_job_system.shutdown();
+
+		if (_window) {
+			SDL_DestroyWindow(_window);
+		}
 	}
 
 	// clear engine pointer
@@ -231,6 +411,8 @@ void VulkanEngine::run() {
 
 	// main loop
 	while (!quit) {
+		auto frame_start = std::chrono::high_resolution_clock::now();
+
 		// Handle events on queue
 		while (SDL_PollEvent(&e) != 0) {
 			// close the window when user alt-f4s or clicks the X button
@@ -297,18 +479,449 @@ void VulkanEngine::run() {
 			ImGui::End();
 		}
 
+		if (ImGui::Begin("Stats")) {
+			ImGui::Text("frame time %.3f ms", _stats.frame_ms);
+			ImGui::Text("record time %.3f ms", _stats.record_ms);
+			ImGui::Text("gpu time %.3f ms", _stats.gpu_ms);
+
+			// 0 records on the main thread into the primary buffer
+			int record_threads = (int)_record_threads;
+			if (ImGui::SliderInt("record threads", &record_threads, 0,
+						(int)_job_system.thread_count())) {
+				_record_threads = (uint32_t)record_threads;
+			}
+
+			// only the cpu draw list has a prepass. The gpu driven path culls
+			// occluded objects with the depth pyramid, the cpu path with the
+			// software occlusion buffer.
+			ImGui::Checkbox("depth prepass", &_depth_prepass);
+			ImGui::Checkbox("occlusion culling", &_occlusion_culling);
+			if (uses_cpu_occlusion()) {
+				ImGui::Checkbox("cpu occlusion culling", &_cpu_occlusion);
+			}
+
+			// edits go through the registry and reach the gpu with the next
+			// frame's flush
+			GPUMaterial material = _material_registry.get(_default_data.id);
+			if (ImGui::ColorEdit4("default material",
+						(float*)&material.color_factors)) {
+				_material_registry.update(_default_data.id, material);
+			}
+
+			const char* transparency_modes[] = { "sorted", "weighted blended" };
+			ImGui::Combo("transparency", (int*)&_transparency_mode,
+					transparency_modes, std::size(transparency_modes));
+
+			// issued / elided bind calls of the geometry pass
+			const CommandEncoderStats& commands = _stats.commands;
+			ImGui::Text("visible objects %u / %u", _stats.objects_visible,
+					_stats.objects_tested);
+			ImGui::Text("cull time %.3f ms", _stats.cull_ms);
+			ImGui::Text("frustum culled %u objects, %u triangles",
+					_stats.frustum_culled, _stats.frustum_culled_triangles);
+			ImGui::Text("occlusion culled %u objects, %u triangles",
+					_stats.occlusion_culled,
+					_stats.occlusion_culled_triangles);
+			ImGui::Text("occlusion raster %.3f ms, test %.3f ms",
+					_stats.occlusion_raster_ms, _stats.occlusion_test_ms);
+			ImGui::Text("visible transparent objects %u",
+					_stats.transparent_visible);
+
+			const MaterialRegistryStats& materials =
+					_material_registry.stats();
+			const uint32_t material_kib = (uint32_t)(
+					(materials.device_bytes + materials.staging_bytes) / 1024);
+			ImGui::Text("materials %u / %u, %u KiB in %u allocations",
+					materials.material_count, materials.capacity,
+					material_kib, materials.allocations);
+			ImGui::Text("material flush %u materials, %u copy regions",
+					materials.flushed_materials, materials.copy_regions);
+
+			const DescriptorAllocatorStats& descriptors =
+					_global_descriptor_allocator.stats();
+			ImGui::Text("descriptor pools %u, %u sets in %u calls",
+					descriptors.pools_created, descriptors.sets,
+					descriptors.allocate_calls);
+
+			const DescriptorCacheStats& cache = _descriptor_cache.stats();
+			ImGui::Text("descriptor cache %u entries, %u hits, %u misses, "
+						"%.0f%% hit rate",
+					cache.entries, cache.hits, cache.misses,
+					_descriptor_cache.hit_rate() * 100.0f);
+			ImGui::Text("scene set %s", _push_descriptors ? "pushed" : "bound");
+			ImGui::Text("draws %u", commands.draws);
+			ImGui::Text("indirect draws %u", commands.indirect_draws);
+			ImGui::Text("pipelines %u / %u", commands.pipelines.issued,
+					commands.pipelines.elided);
+			ImGui::Text("descriptor sets %u / %u",
+					commands.descriptor_sets.issued,
+					commands.descriptor_sets.elided);
+			ImGui::Text("index buffers %u / %u", commands.index_buffers.issued,
+					commands.index_buffers.elided);
+			ImGui::Text("push constants %u / %u",
+					commands.push_constants.issued,
+					commands.push_constants.elided);
+
+			ImGui::End();
+		}
+
 		// make imgui calculate internal draw structures
 		ImGui::Render();
 
 		// our draw function
 		draw();
+
+		auto frame_end = std::chrono::high_resolution_clock::now();
+		_stats.frame_ms = std::chrono::duration<float, std::milli>(
+				frame_end - frame_start)
+								  .count();
+	}
+}
+
+static void add_command_counters(
+		BenchmarkReport& report, const CommandEncoderStats& stats) {
+	auto add = [&](const char* name, const EncoderCounters& counters) {
+		report.add_counter(fmt::format("{}_issued", name), counters.issued);
+		report.add_counter(fmt::format("{}_elided", name), counters.elided);
+	};
+
+	report.add_counter("draws", stats.draws);
+	report.add_counter("indirect_draws", stats.indirect_draws);
+	add("pipeline_binds", stats.pipelines);
+	add("descriptor_set_binds", stats.descriptor_sets);
+	add("index_buffer_binds", stats.index_buffers);
+	add("push_constants", stats.push_constants);
+}
+
+static void add_material_counters(
+		BenchmarkReport& report, const MaterialRegistryStats& stats) {
+	report.add_counter("materials", stats.material_count);
+	report.add_counter("material_device_bytes", stats.device_bytes);
+	report.add_counter("material_staging_bytes", stats.staging_bytes);
+	report.add_counter("material_allocations", stats.allocations);
+	report.add_counter("materials_flushed", stats.flushed_materials);
+	report.add_counter("material_copy_regions", stats.copy_regions);
+}
+
+bool VulkanEngine::run_headless() {
+	if (_loaded_nodes.find(_options.scene) == _loaded_nodes.end()) {
+		fmt::println("Unknown scene '{}', available scenes:", _options.scene);
+		for (const auto& [name, node] : _loaded_nodes) {
+			fmt::println("\t{}", name);
+		}
+		return false;
+	}
+
+	BenchmarkReport report = {
+		.scene = _options.scene,
+		.width = _draw_image.image_extent.width,
+		.height = _draw_image.image_extent.height,
+		.device_name = _device_name,
+	};
+
+	// every configuration gets its own warmup, so the record times of one
+	// are not skewed by the switch from the previous. The gpu driven path
+	// has no prepass, so it only runs the first entry.
+	std::vector<bool> prepass_modes = _options.depth_prepass;
+	if (_options.gpu_driven) {
+		prepass_modes.resize(1);
+	}
+
+	for (bool depth_prepass : prepass_modes) {
+		_depth_prepass = depth_prepass;
+
+		for (uint32_t threads : _options.record_threads) {
+			_record_threads = std::min(threads, _job_system.thread_count());
+
+			std::string name = fmt::format("{}_threads", _record_threads);
+			if (!_options.gpu_driven) {
+				name = fmt::format("{}_{}",
+						depth_prepass ? "depth_prepass" : "no_depth_prepass",
+						name);
+			}
+			report.begin_configuration(name);
+
+			const uint32_t total_frames =
+					_options.warmup_frames + _options.frame_count;
+			for (uint32_t i = 0; i < total_frames; i++) {
+				auto frame_start = std::chrono::high_resolution_clock::now();
+
+				draw();
+
+				auto frame_end = std::chrono::high_resolution_clock::now();
+				_stats.frame_ms = std::chrono::duration<float, std::milli>(
+						frame_end - frame_start)
+										  .count();
+
+				if (i < _options.warmup_frames) {
+					continue;
+				}
+
+				report.add_frame(_stats.frame_ms, _stats.record_ms);
+				add_command_counters(report, _stats.commands);
+				report.add_counter("objects_tested", _stats.objects_tested);
+				report.add_counter("objects_visible", _stats.objects_visible);
+				report.add_counter("cull_ms", _stats.cull_ms);
+				report.add_counter("frustum_culled", _stats.frustum_culled);
+				report.add_counter("frustum_culled_triangles",
+						_stats.frustum_culled_triangles);
+				report.add_counter("occlusion_culled", _stats.occlusion_culled);
+				report.add_counter("occlusion_culled_triangles",
+						_stats.occlusion_culled_triangles);
+				report.add_counter(
+						"occlusion_raster_ms", _stats.occlusion_raster_ms);
+				report.add_counter(
+						"occlusion_test_ms", _stats.occlusion_test_ms);
+				report.add_counter(
+						"transparent_visible", _stats.transparent_visible);
+				add_material_counters(report, _material_registry.stats());
+				report.add_counter("push_descriptors", _push_descriptors);
+				// the gpu timings read back this frame belong to the one
+				// FRAME_OVERLAP frames earlier, which has to be of this
+				// configuration too
+				if (_stats.gpu_ms >= 0.0f && i >= FRAME_OVERLAP) {
+					report.add_gpu_frame(_stats.gpu_ms);
+				}
+			}
+		}
+	}
+
+	vkDeviceWaitIdle(_device);
+
+	return write_report(report.to_json(), _options.output_path);
+}
+
+bool VulkanEngine::run_path_comparison() {
+	if (_loaded_nodes.find(_options.scene) == _loaded_nodes.end()) {
+		fmt::println("Unknown scene '{}'", _options.scene);
+		return false;
+	}
+
+	// both paths cull against the frustum with the same sphere test, but
+	// occlude with different buffers, so occlusion is left out. The prepass
+	// does not change what is visible.
+	_occlusion_culling = false;
+	_cpu_occlusion = false;
+	_depth_prepass = false;
+
+	auto draw_frames = [&](bool gpu_driven) {
+		_options.gpu_driven = gpu_driven;
+		_stats.objects_visible = 0;
+
+		// the gpu driven count comes back FRAME_OVERLAP frames late
+		for (uint32_t i = 0; i <= FRAME_OVERLAP; i++) {
+			draw();
+		}
+	};
+
+	draw_frames(false);
+	const uint32_t objects = _stats.objects_tested;
+	const uint32_t cpu_visible = _stats.objects_visible;
+	const std::vector<uint8_t> cpu_visibility = _cull_visibility;
+
+	draw_frames(true);
+	vkDeviceWaitIdle(_device);
+	const uint32_t gpu_visible = _stats.objects_visible;
+	const std::vector<uint8_t> gpu_visibility = read_gpu_visibility();
+
+	// the scene is walked in the same order on both paths, so objects can
+	// be compared by their position in the opaque draw list
+	uint32_t mismatched = 0;
+	int64_t first_mismatch = -1;
+	if (cpu_visibility.size() != gpu_visibility.size()) {
+		mismatched = objects;
+	} else {
+		for (size_t i = 0; i < cpu_visibility.size(); i++) {
+			if ((cpu_visibility[i] != 0) != (gpu_visibility[i] != 0)) {
+				if (first_mismatch < 0) {
+					first_mismatch = (int64_t)i;
+				}
+				mismatched++;
+			}
+		}
 	}
+	const bool identical = mismatched == 0 && cpu_visible == gpu_visible;
+
+	std::string json = "{\n";
+	json += fmt::format(
+			"\t\"scene\": \"{}\",\n", json_escape(_options.scene));
+	json += fmt::format("\t\"copies\": {},\n", _options.scene_copies);
+	json += fmt::format("\t\"objects\": {},\n", objects);
+	json += fmt::format("\t\"cpu_visible\": {},\n", cpu_visible);
+	json += fmt::format("\t\"gpu_visible\": {},\n", gpu_visible);
+	json += fmt::format("\t\"mismatched_objects\": {},\n", mismatched);
+	json += fmt::format("\t\"identical\": {}\n", identical);
+	json += "}\n";
+
+	if (!write_report(json, _options.output_path)) {
+		return false;
+	}
+
+	if (!identical) {
+		fmt::println("The gpu driven path found {} visible objects, the cpu "
+					 "path {}. {} objects are visible on only one of them, "
+					 "the first is object {}.",
+				gpu_visible, cpu_visible, mismatched, first_mismatch);
+		return false;
+	}
+
+	return true;
+}
+
+std::vector<uint8_t> VulkanEngine::read_gpu_visibility() {
+	// the last submitted frame, whose commands the device has finished
+	const FrameData& frame = _frames[(_frame_number - 1) % FRAME_OVERLAP];
+	const DrawContext& ctx = _main_draw_context;
+
+	std::vector<uint8_t> visibility(ctx.opaque.surfaces.size(), 0);
+	const uint32_t object_count = (uint32_t)ctx.gpu_objects.size();
+	const uint32_t batch_count = (uint32_t)ctx.indirect_batches.size();
+	if (object_count == 0 || frame.batches_written == 0) {
+		return visibility;
+	}
+
+	vmaInvalidateAllocation(
+			_allocator, frame.batch_buffer.allocation, 0, VK_WHOLE_SIZE);
+	const GPUDrawBatch* batches =
+			(const GPUDrawBatch*)frame.batch_buffer.info.pMappedData;
+
+	// every phase has a command slot per object, and the commands only live
+	// on the device
+	const uint32_t phase_count = frame.batches_written / batch_count;
+	std::vector<VkDrawIndexedIndirectCommand> commands(
+			object_count * phase_count);
+	read_buffer(frame.indirect_buffer.buffer,
+			commands.size() * sizeof(VkDrawIndexedIndirectCommand),
+			commands.data());
+
+	// the first instance of a command is the object record it draws, and
+	// records are stored in the sorted order of the draw list
+	for (uint32_t b = 0; b < frame.batches_written; b++) {
+		for (uint32_t c = 0; c < batches[b].count; c++) {
+			const uint32_t record =
+					commands[batches[b].command_offset + c].firstInstance;
+			visibility[ctx.opaque.order[record]] = 1;
+		}
+	}
+
+	return visibility;
+}
+
+void VulkanEngine::read_buffer(VkBuffer buffer, VkDeviceSize size, void* data) {
+	AllocatedBuffer readback = create_buffer(size,
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_TO_CPU);
+
+	VkCommandPoolCreateInfo pool_info =
+			vkinit::command_pool_create_info(_graphics_queue_family);
+	VkCommandPool pool;
+	VK_CHECK(vkCreateCommandPool(_device, &pool_info, nullptr, &pool));
+
+	VkCommandBufferAllocateInfo cmd_alloc_info =
+			vkinit::command_buffer_allocate_info(pool);
+	VkCommandBuffer cmd;
+	VK_CHECK(vkAllocateCommandBuffers(_device, &cmd_alloc_info, &cmd));
+
+	VkCommandBufferBeginInfo begin_info = vkinit::command_buffer_begin_info(
+			VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+	VK_CHECK(vkBeginCommandBuffer(cmd, &begin_info));
+
+	// the buffer was written by an earlier submission
+	VkMemoryBarrier2 read_barrier = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+		.srcStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+		.srcAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT,
+		.dstStageMask = VK_PIPELINE_STAGE_2_COPY_BIT,
+		.dstAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT,
+	};
+
+	VkDependencyInfo dep_info = {
+		.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+		.memoryBarrierCount = 1,
+		.pMemoryBarriers = &read_barrier,
+	};
+	vkCmdPipelineBarrier2(cmd, &dep_info);
+
+	VkBufferCopy copy = { .srcOffset = 0, .dstOffset = 0, .size = size };
+	vkCmdCopyBuffer(cmd, buffer, readback.buffer, 1, &copy);
+
+	// the host reads the copy once the fence is signaled
+	VkMemoryBarrier2 host_barrier = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+		.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT,
+		.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+		.dstStageMask = VK_PIPELINE_STAGE_2_HOST_BIT,
+		.dstAccessMask = VK_ACCESS_2_HOST_READ_BIT,
+	};
+	dep_info.pMemoryBarriers = &host_barrier;
+	vkCmdPipelineBarrier2(cmd, &dep_info);
+
+	VK_CHECK(vkEndCommandBuffer(cmd));
+
+	VkFenceCreateInfo fence_info = vkinit::fence_create_info();
+	VkFence fence;
+	VK_CHECK(vkCreateFence(_device, &fence_info, nullptr, &fence));
+
+	VkCommandBufferSubmitInfo cmd_info =
+			vkinit::command_buffer_submit_info(cmd);
+	VkSubmitInfo2 submit = vkinit::submit_info(&cmd_info, nullptr, nullptr);
+	VK_CHECK(vkQueueSubmit2(_graphics_queue, 1, &submit, fence));
+	VK_CHECK(vkWaitForFences(
+			_device, 1, &fence, true, ONE_SECOND_IN_NANOSECONDS));
+
+	vmaInvalidateAllocation(_allocator, readback.allocation, 0, VK_WHOLE_SIZE);
+	memcpy(data, readback.info.pMappedData, size);
+
+	vkDestroyFence(_device, fence, nullptr);
+	vkDestroyCommandPool(_device, pool, nullptr);
+	destroy_buffer(readback);
 }
 
 void VulkanEngine::update_scene() {
-	_main_draw_context.opaque_surfaces.clear();
+	DrawContext& ctx = _main_draw_context;
+	ctx.opaque.surfaces.clear();
+	ctx.transparent.surfaces.clear();
+	ctx.occluders.clear();
+	ctx.usable_uploads = _upload_context.usable_ticket();
+
+	// the last copies are drawn translucent
+	const uint32_t copies = std::max(_options.scene_copies, 1u);
+	const uint32_t first_transparent =
+			copies - std::min(_options.transparent_copies, copies);
+	auto set_material = [&](uint32_t copy) {
+		if (copy >= first_transparent) {
+			ctx.material_override = &_default_transparent_data;
+		} else if (!_scene_materials.empty()) {
+			ctx.material_override =
+					&_scene_materials[copy % _scene_materials.size()];
+		} else {
+			ctx.material_override = nullptr;
+		}
+	};
 
-	_loaded_nodes["Suzanne"]->draw(glm::mat4(1.0f), _main_draw_context);
+	auto scene = _loaded_nodes.find(_options.scene);
+	if (scene != _loaded_nodes.end() && copies == 1) {
+		set_material(0);
+		scene->second->draw(glm::mat4(1.0f), ctx);
+	} else if (scene != _loaded_nodes.end()) {
+		// copies go on a square grid facing the camera, pushed back until
+		// the whole grid fits the 70 degree field of view
+		constexpr float spacing = 3.f;
+		const uint32_t side = (uint32_t)std::ceil(std::sqrt((float)copies));
+		const float extent = side * spacing;
+		const float distance = extent * 0.5f / std::tan(glm::radians(35.f));
+
+		for (uint32_t i = 0; i < copies; i++) {
+			const glm::vec3 offset = {
+				((i % side) + 0.5f) * spacing - extent * 0.5f,
+				((i / side) + 0.5f) * spacing - extent * 0.5f,
+				-distance,
+			};
+			set_material(i);
+			scene->second->draw(
+					glm::translate(glm::mat4(1.0f), offset), ctx);
+		}
+	}
+	ctx.material_override = nullptr;
 
 	_scene_data.view = glm::translate(glm::mat4(1.0f), glm::vec3{ 0, 0, -5 });
 	// camera projection
@@ -325,69 +938,360 @@ void VulkanEngine::update_scene() {
 	_scene_data.ambient_color = glm::vec4(0.1f);
 	_scene_data.sunlight_color = glm::vec4(1.0f);
 	_scene_data.sunlight_direction = glm::vec4(0, 1, 0.5, 1.f);
-}
 
-GPUMeshBuffers VulkanEngine::upload_mesh(
-		std::span<uint32_t> indices, std::span<Vertex> vertices) {
-	const size_t vertex_buffer_size = vertices.size() * sizeof(Vertex);
-	const size_t index_buffer_size = indices.size() * sizeof(uint32_t);
+	if (_options.gpu_driven) {
+		build_indirect_batches(ctx);
+	} else {
+		auto start = std::chrono::high_resolution_clock::now();
 
-	GPUMeshBuffers new_surface;
+		_stats.objects_visible = cull_draws(ctx.opaque);
 
-	// create vertex buffer
-	new_surface.vertex_buffer = create_buffer(vertex_buffer_size,
-			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
-					VK_BUFFER_USAGE_TRANSFER_DST_BIT |
-					VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
-			VMA_MEMORY_USAGE_GPU_ONLY);
+		auto end = std::chrono::high_resolution_clock::now();
+		_stats.cull_ms =
+				std::chrono::duration<float, std::milli>(end - start).count();
+		_stats.objects_tested = (uint32_t)ctx.opaque.surfaces.size();
 
-	// find the address of the vertex buffer
-	VkBufferDeviceAddressInfo device_address_info = {
-		.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
-		.buffer = new_surface.vertex_buffer.buffer,
-	};
-	new_surface.vertex_buffer_address =
-			vkGetBufferDeviceAddress(_device, &device_address_info);
+		if (_cpu_occlusion) {
+			_stats.objects_visible -=
+					cull_occluded(ctx.opaque, ctx.occluders);
+		} else {
+			_stats.occlusion_culled = 0;
+			_stats.occlusion_culled_triangles = 0;
+		}
 
-	// create index buffer
-	new_surface.index_buffer = create_buffer(index_buffer_size,
-			VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-			VMA_MEMORY_USAGE_GPU_ONLY);
+		sort_draws(ctx.opaque, false);
+	}
 
-	AllocatedBuffer staging = create_buffer(
-			vertex_buffer_size + index_buffer_size,
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY);
+	// transparent surfaces always take the cpu path. The weighted blended
+	// mode does not depend on their order, so they are sorted by state like
+	// the opaque ones and instanced just as well.
+	_stats.transparent_visible = cull_draws(ctx.transparent);
+	sort_draws(ctx.transparent,
+			_transparency_mode == TransparencyMode::Sorted);
 
-	void* data = staging.allocation->GetMappedData();
+	ctx.instance_transforms.clear();
+	if (!_options.gpu_driven) {
+		group_instances(ctx.opaque, ctx.instance_transforms);
+	}
+	group_instances(ctx.transparent, ctx.instance_transforms);
+}
 
-	// copy vertex buffer
-	memcpy(data, vertices.data(), vertex_buffer_size);
-	// copy index buffer
-	memcpy((char*)data + vertex_buffer_size, indices.data(), index_buffer_size);
+uint32_t VulkanEngine::cull_draws(DrawList& list) {
+	const size_t count = list.surfaces.size();
+
+	// world space spheres, scaled by the largest axis scale of the transform
+	_cull_spheres.resize(count);
+	for (size_t i = 0; i < count; i++) {
+		const RenderObject& draw = list.surfaces[i];
+
+		const glm::vec3 center =
+				draw.transform * glm::vec4(draw.bounds.origin, 1.f);
+		const float scale = std::max(
+				std::max(glm::length(glm::vec3(draw.transform[0])),
+						glm::length(glm::vec3(draw.transform[1]))),
+				glm::length(glm::vec3(draw.transform[2])));
+
+		_cull_spheres.x[i] = center.x;
+		_cull_spheres.y[i] = center.y;
+		_cull_spheres.z[i] = center.z;
+		_cull_spheres.radius[i] = draw.bounds.sphere_radius * scale;
+	}
 
-	immediate_submit([&](VkCommandBuffer cmd) {
-		VkBufferCopy vertex_copy{ 0 };
-		vertex_copy.dstOffset = 0;
-		vertex_copy.srcOffset = 0;
-		vertex_copy.size = vertex_buffer_size;
+	_cull_visibility.resize(count);
+	const uint32_t visible_count =
+			cull_spheres(make_frustum(_scene_data.viewproj), _cull_spheres,
+					_cull_visibility.data());
 
-		vkCmdCopyBuffer(cmd, staging.buffer, new_surface.vertex_buffer.buffer,
-				1, &vertex_copy);
+	list.visible.clear();
+	list.visible.reserve(visible_count);
+	for (size_t i = 0; i < count; i++) {
+		if (_cull_visibility[i]) {
+			list.visible.push_back((uint32_t)i);
+		}
+	}
 
-		VkBufferCopy index_copy{ 0 };
-		index_copy.dstOffset = 0;
-		index_copy.srcOffset = vertex_buffer_size;
-		index_copy.size = index_buffer_size;
+	return visible_count;
+}
 
-		vkCmdCopyBuffer(cmd, staging.buffer, new_surface.index_buffer.buffer, 1,
-				&index_copy);
+uint32_t VulkanEngine::cull_occluded(
+		DrawList& list, std::span<const OccluderInstance> occluders) {
+	auto start = std::chrono::high_resolution_clock::now();
+
+	// every occluder is set up on its own, into its own triangles
+	_occluder_triangles.resize(occluders.size());
+	_job_system.parallel_for(occluders.size(), [&](size_t i) {
+		_occluder_triangles[i].clear();
+		_occlusion_buffer.setup_triangles(*occluders[i].mesh,
+				_scene_data.viewproj * occluders[i].transform,
+				_occluder_triangles[i]);
 	});
 
-	destroy_buffer(staging);
+	// one band of tile rows per thread, so no two threads touch the same
+	// tile. Every band goes through the occluders in the same order, the
+	// buffer does not depend on the thread count.
+	_occlusion_buffer.clear();
+	const uint32_t rows = _occlusion_buffer.tile_rows();
+	const uint32_t bands = std::min(_job_system.thread_count(), rows);
+	_job_system.parallel_for(bands, [&](size_t b) {
+		const uint32_t first_row = (uint32_t)(rows * b / bands);
+		const uint32_t end_row = (uint32_t)(rows * (b + 1) / bands);
+		for (const std::vector<OccluderTriangle>& triangles :
+				_occluder_triangles) {
+			_occlusion_buffer.rasterize(triangles, first_row, end_row);
+		}
+	});
+
+	auto rasterized = std::chrono::high_resolution_clock::now();
+
+	const size_t count = list.visible.size();
+	_occlusion_results.resize(count);
+	const size_t chunk_count =
+			(count + OCCLUSION_TEST_CHUNK - 1) / OCCLUSION_TEST_CHUNK;
+	_job_system.parallel_for(chunk_count, [&](size_t c) {
+		const size_t end = std::min(count, (c + 1) * OCCLUSION_TEST_CHUNK);
+		for (size_t i = c * OCCLUSION_TEST_CHUNK; i < end; i++) {
+			const RenderObject& draw = list.surfaces[list.visible[i]];
+			_occlusion_results[i] = _occlusion_buffer.is_occluded(
+					draw.bounds, _scene_data.viewproj * draw.transform);
+		}
+	});
+
+	uint32_t occluded = 0;
+	uint32_t occluded_triangles = 0;
+	size_t kept = 0;
+	for (size_t i = 0; i < count; i++) {
+		if (_occlusion_results[i]) {
+			occluded++;
+			occluded_triangles +=
+					list.surfaces[list.visible[i]].index_count / 3;
+		} else {
+			list.visible[kept++] = list.visible[i];
+		}
+	}
+	list.visible.resize(kept);
+
+	auto end = std::chrono::high_resolution_clock::now();
+	_stats.occlusion_raster_ms =
+			std::chrono::duration<float, std::milli>(rasterized - start)
+					.count();
+	_stats.occlusion_test_ms =
+			std::chrono::duration<float, std::milli>(end - rasterized).count();
+	_stats.occlusion_culled = occluded;
+	_stats.occlusion_culled_triangles = occluded_triangles;
+
+	return occluded;
+}
+
+void VulkanEngine::sort_draws(DrawList& list, bool back_to_front) {
+	list.keys.resize(list.visible.size());
+	for (size_t i = 0; i < list.visible.size(); i++) {
+		const RenderObject& draw = list.surfaces[list.visible[i]];
+
+		// depth of the object's origin along the view direction
+		const float view_depth = -(_scene_data.view * draw.transform[3]).z;
+
+		// copies of a surface with the same material end up next to each
+		// other and can be instanced. Surfaces of a mesh get consecutive ids,
+		// so they still sort together.
+		if (back_to_front) {
+			list.keys[i] = make_blended_draw_key(
+					draw.material->id, draw.surface_id, view_depth);
+		} else {
+			list.keys[i] = make_draw_key(draw.material->pass_type,
+					draw.material->pipeline->id, draw.material->id,
+					draw.surface_id, view_depth);
+		}
+	}
+
+	// the sorter orders positions in the visible list, map them back to
+	// surfaces
+	_draw_sorter.sort(list.keys, list.order);
+	for (uint32_t& i : list.order) {
+		i = list.visible[i];
+	}
+}
+
+void VulkanEngine::group_instances(
+		DrawList& list, std::vector<glm::mat4>& instance_transforms) {
+	list.groups.clear();
+
+	for (uint32_t i : list.order) {
+		const RenderObject& draw = list.surfaces[i];
+
+		// only compares with the group's first draw, sorted copies are
+		// adjacent unless a truncated key collides. Back to front, only
+		// copies at the same quantized depth are, and an instanced draw
+		// keeps their order.
+		bool same_group = false;
+		if (_options.instancing && !list.groups.empty()) {
+			const RenderObject& first = list.surfaces[list.groups.back().draw];
+			same_group = first.material == draw.material &&
+					first.first_index == draw.first_index &&
+					first.index_count == draw.index_count &&
+					first.vertex_offset == draw.vertex_offset &&
+					first.index_type == draw.index_type;
+		}
+
+		if (!same_group) {
+			InstanceGroup group = {
+				.draw = i,
+				.first_instance = (uint32_t)instance_transforms.size(),
+				.instance_count = 0,
+			};
+			list.groups.push_back(group);
+		}
+
+		list.groups.back().instance_count++;
+		instance_transforms.push_back(draw.transform);
+	}
+}
+
+void VulkanEngine::build_indirect_batches(DrawContext& ctx) {
+	auto start = std::chrono::high_resolution_clock::now();
+
+	const size_t count = ctx.opaque.surfaces.size();
+
+	// an indirect draw cannot change pipeline, material set or index type, so
+	// those make the batches. The mesh field only holds the index type and
+	// the depth is left out, order inside a batch is up to the culling pass.
+	ctx.opaque.keys.resize(count);
+	for (size_t i = 0; i < count; i++) {
+		const RenderObject& draw = ctx.opaque.surfaces[i];
+		ctx.opaque.keys[i] = make_draw_key(draw.material->pass_type,
+				draw.material->pipeline->id, draw.material->id,
+				draw.index_type == VK_INDEX_TYPE_UINT16 ? 0 : 1, 0.f);
+	}
+	_draw_sorter.sort(ctx.opaque.keys, ctx.opaque.order);
+
+	// records are stored in batch order, so every batch owns the command
+	// slots of its own records
+	ctx.gpu_objects.resize(count);
+	ctx.indirect_batches.clear();
+	for (size_t i = 0; i < count; i++) {
+		const RenderObject& draw = ctx.opaque.surfaces[ctx.opaque.order[i]];
+
+		if (ctx.indirect_batches.empty() ||
+				ctx.indirect_batches.back().material != draw.material ||
+				ctx.indirect_batches.back().index_type != draw.index_type) {
+			IndirectBatch batch = {
+				.material = draw.material,
+				.index_type = draw.index_type,
+				.command_offset = (uint32_t)i,
+				.max_count = 0,
+			};
+			ctx.indirect_batches.push_back(batch);
+		}
+		ctx.indirect_batches.back().max_count++;
+
+		ctx.gpu_objects[i] = GPUObjectRecord{
+			.transform = draw.transform,
+			.sphere = glm::vec4(draw.bounds.origin, draw.bounds.sphere_radius),
+			.position_offset = glm::vec4(draw.position_offset, 0.f),
+			.position_scale = glm::vec4(draw.position_scale, 0.f),
+			.index_count = draw.index_count,
+			.first_index = draw.first_index,
+			.vertex_offset = draw.vertex_offset,
+			.batch = (uint32_t)ctx.indirect_batches.size() - 1,
+		};
+	}
+
+	auto end = std::chrono::high_resolution_clock::now();
+	_stats.cull_ms =
+			std::chrono::duration<float, std::milli>(end - start).count();
+	_stats.objects_tested = (uint32_t)count;
+}
+
+UploadBatch VulkanEngine::begin_upload() {
+	return _upload_context.begin_batch();
+}
+
+void VulkanEngine::wait_upload(UploadTicket ticket) {
+	_upload_context.wait(ticket);
+}
+
+std::optional<GPUMeshBuffers> VulkanEngine::upload_mesh(UploadBatch& batch,
+		std::span<const uint32_t> indices, std::span<const Vertex> vertices,
+		std::span<const glm::vec3> positions) {
+	assert(positions.size() == vertices.size());
+
+	return upload_mesh_data(batch, indices, vertices.data(), positions.data(),
+			vertices.size(), sizeof(Vertex), sizeof(glm::vec3));
+}
+
+std::optional<GPUMeshBuffers> VulkanEngine::upload_mesh(UploadBatch& batch,
+		std::span<const uint32_t> indices, const PackedVertices& vertices) {
+	std::optional<GPUMeshBuffers> new_surface = upload_mesh_data(batch,
+			indices, vertices.vertices.data(), vertices.positions.data(),
+			vertices.vertices.size(), sizeof(PackedVertex),
+			sizeof(PackedPosition));
+	if (!new_surface.has_value()) {
+		return {};
+	}
+
+	new_surface->packed_vertices = true;
+	new_surface->position_offset = vertices.position_offset;
+	new_surface->position_scale = vertices.position_scale;
+
+	return new_surface;
+}
+
+std::optional<GPUMeshBuffers> VulkanEngine::upload_mesh_data(
+		UploadBatch& batch, std::span<const uint32_t> indices,
+		const void* vertex_data, const void* position_data,
+		size_t vertex_count, size_t vertex_size, size_t position_size) {
+	// the geometry buffer is sized for a single vertex format
+	assert(vertex_size == _geometry_buffer.vertex_stride());
+	assert(position_size == _geometry_buffer.position_stride());
+
+	GPUMeshBuffers new_surface;
+
+	// every index of a mesh with at most 65536 vertices fits in 16 bits,
+	// which halves the index buffer and the bandwidth to read it
+	std::vector<uint16_t> narrow_indices;
+	const void* index_data = indices.data();
+	size_t index_size = sizeof(uint32_t);
+	new_surface.index_type = VK_INDEX_TYPE_UINT32;
+	if (vertex_count <= 65536) {
+		narrow_indices.assign(indices.begin(), indices.end());
+		index_data = narrow_indices.data();
+		index_size = sizeof(uint16_t);
+		new_surface.index_type = VK_INDEX_TYPE_UINT16;
+	}
+
+	std::optional<GeometryAllocation> geometry = _geometry_buffer.allocate(
+			(uint32_t)vertex_count, indices.size() * index_size);
+	if (!geometry.has_value()) {
+		fmt::println("Geometry buffer is out of space");
+		return {};
+	}
+
+	new_surface.geometry = geometry.value();
+	new_surface.first_index =
+			(uint32_t)(new_surface.geometry.index_offset / index_size);
+	new_surface.vertex_offset = (int32_t)new_surface.geometry.first_vertex;
+
+	// the data goes through the batch's staging ring, the copies run when the
+	// batch is submitted
+	batch.copy_to_buffer(_geometry_buffer.vertex_buffer(),
+			new_surface.geometry.first_vertex * vertex_size, vertex_data,
+			vertex_count * vertex_size);
+	batch.copy_to_buffer(_geometry_buffer.position_buffer(),
+			new_surface.geometry.first_vertex * position_size, position_data,
+			vertex_count * position_size);
+	batch.copy_to_buffer(_geometry_buffer.index_buffer(),
+			new_surface.geometry.index_offset, index_data,
+			new_surface.geometry.index_size);
 
 	return new_surface;
 }
 
+void VulkanEngine::destroy_mesh(const GPUMeshBuffers& mesh) {
+	// frames still in flight may be drawing it
+	GeometryAllocation geometry = mesh.geometry;
+	get_current_frame().deletion_queue.push_function(
+			[=, this]() { _geometry_buffer.free(geometry); });
+}
+
 AllocatedImage VulkanEngine::create_image(VkExtent3D size, VkFormat format,
 		VkImageUsageFlags usage, bool mipmapped) {
 	AllocatedImage new_image = {
@@ -431,47 +1335,17 @@ AllocatedImage VulkanEngine::create_image(VkExtent3D size, VkFormat format,
 	return new_image;
 }
 
-AllocatedImage VulkanEngine::create_image(void* data, VkExtent3D size,
-		VkFormat format, VkImageUsageFlags usage, bool mipmapped) {
+AllocatedImage VulkanEngine::create_image(UploadBatch& batch, void* data,
+		VkExtent3D size, VkFormat format, VkImageUsageFlags usage,
+		bool mipmapped) {
 	size_t data_size = size.depth * size.width * size.height * 4;
-	AllocatedBuffer staging_buffer = create_buffer(data_size,
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
-
-	memcpy(staging_buffer.info.pMappedData, data, data_size);
 
 	AllocatedImage new_image = create_image(size, format,
 			usage | VK_IMAGE_USAGE_TRANSFER_DST_BIT |
 					VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
 			mipmapped);
 
-	immediate_submit([&](VkCommandBuffer cmd) {
-		vkutil::transition_image(cmd, new_image.image,
-				VK_IMAGE_LAYOUT_UNDEFINED,
-				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-
-		VkBufferImageCopy copy_region = {
-            .bufferOffset =0,
-            .bufferRowLength = 0,
-            .bufferImageHeight =0,
-            .imageSubresource = {
-                .aspectMask =VK_IMAGE_ASPECT_COLOR_BIT,
-                .mipLevel = 0,
-                .baseArrayLayer =0,
-                .layerCount = 1,
-            },
-            .imageExtent =size,
-        };
-
-		// copy the buffer into the image
-		vkCmdCopyBufferToImage(cmd, staging_buffer.buffer, new_image.image,
-				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy_region);
-
-		vkutil::transition_image(cmd, new_image.image,
-				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-	});
-
-	destroy_buffer(staging_buffer);
+	batch.copy_to_image(new_image, data, data_size);
 
 	return new_image;
 }
@@ -482,19 +1356,29 @@ void VulkanEngine::destroy_image(const AllocatedImage& img) {
 }
 
 void VulkanEngine::init_default_data() {
-	_test_meshes = load_gltf_meshes(this, "assets/basicmesh.glb").value();
+	// without them the scene is empty, a headless run reports the missing
+	// scene
+	auto test_meshes = load_gltf_meshes(this, "assets/basicmesh.glb");
+	if (test_meshes.has_value()) {
+		_test_meshes = std::move(test_meshes.value());
+	} else {
+		fmt::println("Unable to load assets/basicmesh.glb");
+	}
+
+	// all default textures are uploaded with a single submit
+	UploadBatch upload = begin_upload();
 
 	//3 default textures, white, grey, black. 1 pixel each
 	uint32_t white = glm::packUnorm4x8(glm::vec4(1, 1, 1, 1));
-	_white_image = create_image((void*)&white, VkExtent3D{ 1, 1, 1 },
+	_white_image = create_image(upload, (void*)&white, VkExtent3D{ 1, 1, 1 },
 			VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_SAMPLED_BIT);
 
 	uint32_t grey = glm::packUnorm4x8(glm::vec4(0.66f, 0.66f, 0.66f, 1));
-	_grey_image = create_image((void*)&grey, VkExtent3D{ 1, 1, 1 },
+	_grey_image = create_image(upload, (void*)&grey, VkExtent3D{ 1, 1, 1 },
 			VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_SAMPLED_BIT);
 
 	uint32_t black = glm::packUnorm4x8(glm::vec4(0, 0, 0, 0));
-	_black_image = create_image((void*)&black, VkExtent3D{ 1, 1, 1 },
+	_black_image = create_image(upload, (void*)&black, VkExtent3D{ 1, 1, 1 },
 			VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_SAMPLED_BIT);
 
 	//checkerboard image
@@ -506,9 +1390,13 @@ void VulkanEngine::init_default_data() {
 		}
 	}
 	_error_checkerboard_image =
-			create_image(pixels.data(), VkExtent3D{ 16, 16, 1 },
+			create_image(upload, pixels.data(), VkExtent3D{ 16, 16, 1 },
 					VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_SAMPLED_BIT);
 
+	// the default textures are referenced by materials right away, so they
+	// have to be resident before the first frame
+	wait_upload(upload.submit());
+
 	VkSamplerCreateInfo sampl = {
 		.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO
 	};
@@ -522,34 +1410,45 @@ void VulkanEngine::init_default_data() {
 	sampl.minFilter = VK_FILTER_LINEAR;
 	vkCreateSampler(_device, &sampl, nullptr, &_default_sampler_linear);
 
-	GLTFMetallic_Roughness ::MaterialResources material_resources;
-	// default the material resources
-	material_resources.color_image = _white_image;
-	material_resources.color_sampler = _default_sampler_linear;
-	material_resources.metal_roughness_image = _white_image;
-	material_resources.metal_roughness_sampler = _default_sampler_linear;
-
-	// set the uniform buffer for the material data
-	AllocatedBuffer material_constants = create_buffer(
-			sizeof(GLTFMetallic_Roughness::MaterialConstants),
-			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
-
-	// write the buffer
-	GLTFMetallic_Roughness::MaterialConstants* scene_uniform_data =
-			(GLTFMetallic_Roughness::MaterialConstants*)
-					material_constants.allocation->GetMappedData();
-	scene_uniform_data->color_factors = glm::vec4(1, 1, 1, 1);
-	scene_uniform_data->metal_rough_factors = glm::vec4(1, 0.5f, 0, 0);
-
-	_deletion_queue.push_function(
-			[=, this]() { destroy_buffer(material_constants); });
-
-	material_resources.data_buffer = material_constants.buffer;
-	material_resources.data_buffer_offset = 0;
+	// the first material, its texture and sampler are what a full bindless
+	// table or registry falls back to
+	GLTFMetallic_Roughness::MaterialResources material_resources = {
+		.color_image = _white_image,
+		.color_sampler = _default_sampler_linear,
+		.metal_roughness_image = _white_image,
+		.metal_roughness_sampler = _default_sampler_linear,
+		.color_factors = glm::vec4(1, 1, 1, 1),
+		.metal_rough_factors = glm::vec4(1, 0.5f, 0, 0),
+	};
 
-	_default_data = _metal_rough_material.write_material(_device,
-			MaterialPass::MainColor, material_resources,
-			_global_descriptor_allocator);
+	_default_data = _metal_rough_material.write_material(
+			MaterialPass::MainColor, material_resources, _bindless,
+			_material_registry);
+
+	// the same material at half coverage, for the transparent copies
+	material_resources.color_factors = glm::vec4(1, 1, 1, 0.5f);
+
+	_default_transparent_data = _metal_rough_material.write_material(
+			MaterialPass::Transparent, material_resources, _bindless,
+			_material_registry);
+
+	// only the constants differ, so all of them share the textures and
+	// samplers above and take nothing but a registry slot each
+	const uint32_t scene_materials =
+			std::min(_options.scene_materials, MATERIAL_CAPACITY - 2);
+	_scene_materials.reserve(scene_materials);
+	for (uint32_t i = 0; i < scene_materials; i++) {
+		const float hue = (float)i / scene_materials;
+		material_resources.color_factors = glm::vec4(
+				0.5f + 0.5f * std::cos(glm::radians(360.f * hue)),
+				0.5f + 0.5f * std::cos(glm::radians(360.f * hue - 120.f)),
+				0.5f + 0.5f * std::cos(glm::radians(360.f * hue + 120.f)),
+				1.0f);
+
+		_scene_materials.push_back(_metal_rough_material.write_material(
+				MaterialPass::MainColor, material_resources, _bindless,
+				_material_registry));
+	}
 
 	for (auto& m : _test_meshes) {
 		std::shared_ptr<MeshNode> new_node = std::make_shared<MeshNode>();
@@ -566,11 +1465,6 @@ void VulkanEngine::init_default_data() {
 	}
 
 	_deletion_queue.push_function([this]() {
-		for (auto& mesh : _test_meshes) {
-			destroy_buffer(mesh->mesh_buffers.vertex_buffer);
-			destroy_buffer(mesh->mesh_buffers.index_buffer);
-		}
-
 		// destroy default images
 		destroy_image(_white_image);
 		destroy_image(_black_image);
@@ -590,17 +1484,31 @@ void VulkanEngine::draw() {
 	VK_CHECK(vkWaitForFences(_device, 1, &get_current_frame().render_fence,
 			true, ONE_SECOND_IN_NANOSECONDS));
 
+	read_gpu_timings(get_current_frame());
+
 	get_current_frame().deletion_queue.flush();
-	get_current_frame().frame_descriptors.clear_pools(_device);
+	// the fence covers the frame this one reuses the resources of, and
+	// every frame before it
+	if (_frame_number >= FRAME_OVERLAP) {
+		_descriptor_cache.frames_completed(_frame_number - FRAME_OVERLAP);
+	}
+	get_current_frame().uniforms.reset();
+
+	for (VkCommandPool pool : get_current_frame().thread_command_pools) {
+		VK_CHECK(vkResetCommandPool(_device, pool, 0));
+	}
 
 	// request image from the swapchain
-	uint32_t swapchain_image_index;
-	VkResult e = vkAcquireNextImageKHR(_device, _swapchain,
-			ONE_SECOND_IN_NANOSECONDS, get_current_frame().swapchain_semaphore,
-			nullptr, &swapchain_image_index);
-	if (e == VK_ERROR_OUT_OF_DATE_KHR) {
-		_resize_requested = true;
-		return;
+	uint32_t swapchain_image_index = 0;
+	if (!_options.headless) {
+		VkResult e = vkAcquireNextImageKHR(_device, _swapchain,
+				ONE_SECOND_IN_NANOSECONDS,
+				get_current_frame().swapchain_semaphore, nullptr,
+				&swapchain_image_index);
+		if (e == VK_ERROR_OUT_OF_DATE_KHR) {
+			_resize_requested = true;
+			return;
+		}
 	}
 
 	// wait till we ensure that swapchain is not out of date
@@ -618,16 +1526,43 @@ void VulkanEngine::draw() {
 	VkCommandBufferBeginInfo cmd_begin_info = vkinit::command_buffer_begin_info(
 			VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
 
+	// without a swapchain the whole draw image is the render target
+	VkExtent2D target_extent = _options.headless
+			? VkExtent2D{ _draw_image.image_extent.width,
+					  _draw_image.image_extent.height }
+			: _swapchain_extent;
+
 	_draw_extent.width =
-			std::min(_swapchain_extent.width, _draw_image.image_extent.width) *
+			std::min(target_extent.width, _draw_image.image_extent.width) *
 			_render_scale;
-	_draw_extent.height = std::min(_swapchain_extent.height,
-								  _draw_image.image_extent.height) *
+	_draw_extent.height =
+			std::min(target_extent.height, _draw_image.image_extent.height) *
 			_render_scale;
 
+	UploadTicket upload_wait;
+
+	auto record_start = std::chrono::high_resolution_clock::now();
+
 	// start the command buffer recording
 	VK_CHECK(vkBeginCommandBuffer(cmd, &cmd_begin_info));
 	{
+		VkQueryPool timestamp_pool = get_current_frame().timestamp_pool;
+		if (timestamp_pool) {
+			vkCmdResetQueryPool(cmd, timestamp_pool, 0, 2);
+			vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT,
+					timestamp_pool, 0);
+		}
+
+		// take ownership of everything the transfer queue finished uploading
+		upload_wait = _upload_context.record_acquires(cmd);
+
+		// materials added or edited since the last frame, in one copy
+		_material_registry.flush(cmd, _frame_number % FRAME_OVERLAP);
+
+		if (_options.gpu_driven) {
+			cull_indirect(cmd);
+		}
+
 		// make the swapchain image into writeable mode before rendering
 		vkutil::transition_image(cmd, _draw_image.image,
 				VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
@@ -643,37 +1578,61 @@ void VulkanEngine::draw() {
 
 		draw_geometry(cmd);
 
-		// transition the draw image and the swapchain image into their correct
-		// transfer layouts
-		vkutil::transition_image(cmd, _draw_image.image,
-				VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-		vkutil::transition_image(cmd, _swapchain_images[swapchain_image_index],
-				VK_IMAGE_LAYOUT_UNDEFINED,
-				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+		if (_options.gpu_driven && _occlusion_culling) {
+			draw_occlusion_phase(cmd);
+		}
 
-		// execute a copy from the draw image into the swapchain
-		vkutil::copy_image_to_image(cmd, _draw_image.image,
-				_swapchain_images[swapchain_image_index], _draw_extent,
-				_swapchain_extent);
+		draw_transparent(cmd);
+
+		if (!_options.headless) {
+			// transition the draw image and the swapchain image into their
+			// correct transfer layouts
+			vkutil::transition_image(cmd, _draw_image.image,
+					VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+					VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+			vkutil::transition_image(cmd,
+					_swapchain_images[swapchain_image_index],
+					VK_IMAGE_LAYOUT_UNDEFINED,
+					VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+			// execute a copy from the draw image into the swapchain
+			vkutil::copy_image_to_image(cmd, _draw_image.image,
+					_swapchain_images[swapchain_image_index], _draw_extent,
+					_swapchain_extent);
+
+			// set swapchain image layout to Attachment Optimal so we can draw
+			// it
+			vkutil::transition_image(cmd,
+					_swapchain_images[swapchain_image_index],
+					VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+					VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
 
-		// set swapchain image layout to Attachment Optimal so we can draw it
-		vkutil::transition_image(cmd, _swapchain_images[swapchain_image_index],
-				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-				VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+			// draw imgui into the swapchain image
+			draw_imgui(cmd, _swapchain_image_views[swapchain_image_index]);
 
-		// draw imgui into the swapchain image
-		draw_imgui(cmd, _swapchain_image_views[swapchain_image_index]);
+			// set swapchain image layout to present so we can show it on the
+			// screen
+			vkutil::transition_image(cmd,
+					_swapchain_images[swapchain_image_index],
+					VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+					VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+		}
 
-		// set swapchain image layout to present so we can show it on the screen
-		vkutil::transition_image(cmd, _swapchain_images[swapchain_image_index],
-				VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-				VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+		if (timestamp_pool) {
+			vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+					timestamp_pool, 1);
+			get_current_frame().timestamps_written = true;
+		}
 	}
 	// finalize the command buffer (we can no longer add commands, but it can
 	// now be executed)
 	VK_CHECK(vkEndCommandBuffer(cmd));
 
+	auto record_end = std::chrono::high_resolution_clock::now();
+	_stats.record_ms =
+			std::chrono::duration<float, std::milli>(record_end - record_start)
+					.count();
+
 	// prepare the submission to the queue.
 	// we want to wait on the _presentSemaphore, as that semaphore is signaled
 	// when the swapchain is ready we will signal the _renderSemaphore, to
@@ -682,129 +1641,875 @@ void VulkanEngine::draw() {
 	VkCommandBufferSubmitInfo cmd_info =
 			vkinit::command_buffer_submit_info(cmd);
 
-	VkSemaphoreSubmitInfo wait_info = vkinit::semaphore_submit_info(
-			VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR,
-			get_current_frame().swapchain_semaphore);
+	// headless frames are not presented, so there is nothing to synchronize
+	// with besides the render fence
+	VkSemaphoreSubmitInfo wait_infos[2];
+	uint32_t wait_count = 0;
+	if (!_options.headless) {
+		wait_infos[wait_count++] = vkinit::semaphore_submit_info(
+				VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR,
+				get_current_frame().swapchain_semaphore);
+	}
+
+	// the acquired uploads have already completed, the wait only orders the
+	// release before the acquire
+	if (upload_wait.value != 0) {
+		VkSemaphoreSubmitInfo& upload_wait_info = wait_infos[wait_count++];
+		upload_wait_info = vkinit::semaphore_submit_info(
+				VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+				_upload_context.timeline_semaphore());
+		upload_wait_info.value = upload_wait.value;
+	}
+
 	VkSemaphoreSubmitInfo signal_info =
 			vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_ALL_GRAPHICS_BIT,
 					get_current_frame().render_semaphore);
 
-	VkSubmitInfo2 submit =
-			vkinit::submit_info(&cmd_info, &signal_info, &wait_info);
+	VkSubmitInfo2 submit = vkinit::submit_info(&cmd_info,
+			_options.headless ? nullptr : &signal_info, nullptr);
+	submit.waitSemaphoreInfoCount = wait_count;
+	submit.pWaitSemaphoreInfos = wait_infos;
 
 	// submit command buffer to the queue and execute it.
 	// _renderFence will now block until the graphic commands finish execution
 	VK_CHECK(vkQueueSubmit2(
 			_graphics_queue, 1, &submit, get_current_frame().render_fence));
 
-	// prepare present
-	// this will put the image we just rendered to into the visible window.
-	// we want to wait on the _renderSemaphore for that,
-	// as its necessary that drawing commands have finished before the image is
-	// displayed to the user
-	VkPresentInfoKHR present_info = {};
-	present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-	present_info.pNext = nullptr;
-	present_info.pSwapchains = &_swapchain;
-	present_info.swapchainCount = 1;
+	if (!_options.headless) {
+		// prepare present
+		// this will put the image we just rendered to into the visible window.
+		// we want to wait on the _renderSemaphore for that,
+		// as its necessary that drawing commands have finished before the
+		// image is displayed to the user
+		VkPresentInfoKHR present_info = {};
+		present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+		present_info.pNext = nullptr;
+		present_info.pSwapchains = &_swapchain;
+		present_info.swapchainCount = 1;
+
+		present_info.pWaitSemaphores = &get_current_frame().render_semaphore;
+		present_info.waitSemaphoreCount = 1;
+
+		present_info.pImageIndices = &swapchain_image_index;
+
+		VkResult e = vkQueuePresentKHR(_graphics_queue, &present_info);
+		if (e == VK_ERROR_OUT_OF_DATE_KHR) {
+			_resize_requested = true;
+		}
+	}
+
+	// increase the number of frames drawn
+	_frame_number++;
+}
+
+void VulkanEngine::read_gpu_timings(FrameData& frame) {
+	if (!frame.timestamps_written) {
+		return;
+	}
+
+	// the frame fence has already been waited on, so the results are
+	// available without blocking
+	uint64_t timestamps[2];
+	VkResult res = vkGetQueryPoolResults(_device, frame.timestamp_pool, 0, 2,
+			sizeof(timestamps), timestamps, sizeof(uint64_t),
+			VK_QUERY_RESULT_64_BIT);
+	if (res == VK_SUCCESS) {
+		_stats.gpu_ms = float(timestamps[1] - timestamps[0]) *
+				_timestamp_period / 1000000.0f;
+	}
+
+	frame.timestamps_written = false;
+}
+
+static VkDeviceAddress get_buffer_address(VkDevice device, VkBuffer buffer) {
+	VkBufferDeviceAddressInfo device_address_info = {
+		.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
+		.buffer = buffer,
+	};
+	return vkGetBufferDeviceAddress(device, &device_address_info);
+}
+
+template <typename T>
+uint32_t VulkanEngine::write_uniform(FrameData& frame, const T& value) {
+	// per draw data would grow with the scene, it goes in storage buffers
+	static_assert(std::is_same_v<T, GPUSceneData> ||
+					std::is_same_v<T, GPUCullData>,
+			"only the frame constants are written to the uniform arena");
+
+	std::optional<uint32_t> offset = frame.uniforms.write(value);
+	if (!offset.has_value()) {
+		fmt::println("Uniform arena full, {} of {} bytes used",
+				frame.uniforms.used(), frame.uniforms.size());
+		abort();
+	}
+	return offset.value();
+}
+
+void VulkanEngine::reserve_instance_buffer(
+		FrameData& frame, uint32_t instance_count) {
+	if (instance_count <= frame.instance_capacity) {
+		return;
+	}
+
+	// same growth as the indirect buffers below
+	if (frame.instance_capacity > 0) {
+		destroy_buffer(frame.instance_buffer);
+	}
+
+	frame.instance_capacity = std::max(instance_count,
+			frame.instance_capacity + frame.instance_capacity / 2);
+	frame.instance_buffer = create_buffer(
+			frame.instance_capacity * sizeof(glm::mat4),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+					VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+			VMA_MEMORY_USAGE_CPU_TO_GPU);
+}
+
+void VulkanEngine::reserve_indirect_buffers(
+		FrameData& frame, uint32_t object_count, uint32_t batch_count) {
+	// the frame's previous submission has finished, so outgrown buffers can
+	// be destroyed right away. They grow by half to not reallocate on every
+	// frame while a scene streams in.
+	if (object_count > frame.object_capacity) {
+		if (frame.object_capacity > 0) {
+			destroy_buffer(frame.object_buffer);
+			destroy_buffer(frame.indirect_buffer);
+		}
+
+		frame.object_capacity = std::max(object_count,
+				frame.object_capacity + frame.object_capacity / 2);
+		frame.object_buffer = create_buffer(
+				frame.object_capacity * sizeof(GPUObjectRecord),
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+						VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+				VMA_MEMORY_USAGE_CPU_TO_GPU);
+		// copied out by the path comparison
+		frame.indirect_buffer = create_buffer(
+				frame.object_capacity * sizeof(VkDrawIndexedIndirectCommand),
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+						VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+						VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
+						VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+				VMA_MEMORY_USAGE_GPU_ONLY);
+	}
+
+	if (batch_count > frame.batch_capacity) {
+		if (frame.batch_capacity > 0) {
+			destroy_buffer(frame.batch_buffer);
+		}
+
+		frame.batch_capacity = std::max(
+				batch_count, frame.batch_capacity + frame.batch_capacity / 2);
+		// host visible, the counts are read back for the stats
+		frame.batch_buffer = create_buffer(
+				frame.batch_capacity * sizeof(GPUDrawBatch),
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+						VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+						VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+				VMA_MEMORY_USAGE_CPU_TO_GPU);
+	}
+}
+
+void VulkanEngine::reserve_visibility_buffer(
+		VkCommandBuffer cmd, uint32_t object_count) {
+	if (object_count == _visibility_count) {
+		return;
+	}
+
+	if (object_count > _visibility_capacity) {
+		// the other frame in flight may still read the old buffer, this
+		// frame's queue runs once both have finished
+		if (_visibility_capacity > 0) {
+			AllocatedBuffer old_buffer = _visibility_buffer;
+			get_current_frame().deletion_queue.push_function(
+					[this, old_buffer]() { destroy_buffer(old_buffer); });
+		}
+
+		_visibility_capacity = std::max(object_count,
+				_visibility_capacity + _visibility_capacity / 2);
+		_visibility_buffer = create_buffer(
+				_visibility_capacity * sizeof(uint32_t),
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+						VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+						VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+				VMA_MEMORY_USAGE_GPU_ONLY);
+	}
+
+	// everything counts as visible, so the first phase draws it all and the
+	// pyramid the occlusion phase tests against is complete
+	vkCmdFillBuffer(cmd, _visibility_buffer.buffer, 0,
+			object_count * sizeof(uint32_t), 1);
+
+	VkMemoryBarrier2 barrier = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+		.srcStageMask = VK_PIPELINE_STAGE_2_CLEAR_BIT,
+		.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+		.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+		.dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT |
+				VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+	};
+
+	VkDependencyInfo dep_info = {
+		.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+		.memoryBarrierCount = 1,
+		.pMemoryBarriers = &barrier,
+	};
+	vkCmdPipelineBarrier2(cmd, &dep_info);
+
+	_visibility_count = object_count;
+}
+
+void VulkanEngine::set_draw_viewport(VkCommandBuffer cmd) {
+	// set dynamic viewport and scissor
+	VkViewport viewport = {};
+	viewport.x = 0;
+	viewport.y = 0;
+	viewport.width = _draw_extent.width;
+	viewport.height = _draw_extent.height;
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+
+	vkCmdSetViewport(cmd, 0, 1, &viewport);
+
+	VkRect2D scissor = {};
+	scissor.offset.x = 0;
+	scissor.offset.y = 0;
+	scissor.extent.width = _draw_extent.width;
+	scissor.extent.height = _draw_extent.height;
+
+	vkCmdSetScissor(cmd, 0, 1, &scissor);
+}
+
+void VulkanEngine::draw_geometry(VkCommandBuffer cmd) {
+	// the scene data goes to the frame's uniform arena, the frame's scene set
+	// points at the arena and picks it with a dynamic offset
+	FrameData& frame = get_current_frame();
+	frame.scene_data_offset = write_uniform(frame, _scene_data);
+
+	// a pushed set has the offset in its descriptor, every encoder pushes
+	// the same writes
+	if (_push_descriptors) {
+		frame.scene_writer.clear();
+		frame.scene_writer.write_buffer(0, frame.uniforms.buffer(),
+				sizeof(GPUSceneData), frame.scene_data_offset,
+				VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+	}
+
+	upload_instances(frame);
+
+	_stats.commands = {};
+
+	// the gpu driven path culls and draws on the gpu, the prepass only
+	// covers the cpu draw list
+	const bool depth_prepass = _depth_prepass && !_options.gpu_driven;
+	if (depth_prepass) {
+		draw_depth_prepass(cmd);
+	}
+	const DrawVariant variant =
+			depth_prepass ? DrawVariant::DepthEqual : DrawVariant::Color;
+
+	// begin a render pass  connected to our draw image
+	VkRenderingAttachmentInfo color_attachment = vkinit::attachment_info(
+			_draw_image.image_view, nullptr, VK_IMAGE_LAYOUT_GENERAL);
+	VkRenderingAttachmentInfo depth_attachment = vkinit::depth_attachment_info(
+			_depth_image.image_view, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL);
+	if (depth_prepass) {
+		depth_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+	}
 
-	present_info.pWaitSemaphores = &get_current_frame().render_semaphore;
-	present_info.waitSemaphoreCount = 1;
+	// the cpu draw list can be recorded by several threads into secondary
+	// command buffers, the render pass then only executes them
+	const bool record_secondaries =
+			!_options.gpu_driven && _record_threads > 0;
 
-	present_info.pImageIndices = &swapchain_image_index;
+	VkRenderingInfo render_info = vkinit::rendering_info(
+			_draw_extent, &color_attachment, &depth_attachment);
+	if (record_secondaries) {
+		render_info.flags = VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT;
+	}
+	vkCmdBeginRendering(cmd, &render_info);
+
+	if (!record_secondaries) {
+		set_draw_viewport(cmd);
+	}
+
+	if (record_secondaries) {
+		record_draws_parallel(cmd, variant);
+	} else {
+		// skips the binds the sorted draws share with the previous one
+		CommandEncoder encoder(cmd);
+
+		const DrawList& opaque = _main_draw_context.opaque;
+		if (_options.gpu_driven) {
+			draw_indirect(encoder,
+					_occlusion_culling ? CullPhase::LastVisible
+									   : CullPhase::Frustum);
+		} else {
+			draw_instanced(encoder, opaque.surfaces, opaque.groups, variant);
+		}
+
+		_stats.commands += encoder.stats();
+	}
+
+	vkCmdEndRendering(cmd);
+}
+
+void VulkanEngine::draw_depth_prepass(VkCommandBuffer cmd) {
+	VkRenderingAttachmentInfo depth_attachment = vkinit::depth_attachment_info(
+			_depth_image.image_view, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL);
+
+	VkRenderingInfo render_info =
+			vkinit::rendering_info(_draw_extent, nullptr, &depth_attachment);
+	render_info.colorAttachmentCount = 0;
+	vkCmdBeginRendering(cmd, &render_info);
+
+	set_draw_viewport(cmd);
+
+	// same order as the color pass, far to near within every state
+	CommandEncoder encoder(cmd);
+	const DrawList& opaque = _main_draw_context.opaque;
+	draw_instanced(encoder, opaque.surfaces, opaque.groups,
+			DrawVariant::DepthPrepass);
+	_stats.commands += encoder.stats();
+
+	vkCmdEndRendering(cmd);
+}
+
+void VulkanEngine::record_draws_parallel(
+		VkCommandBuffer cmd, DrawVariant variant) {
+	FrameData& frame = get_current_frame();
+	const DrawList& opaque = _main_draw_context.opaque;
+	const size_t group_count = opaque.groups.size();
+
+	// contiguous chunks of the sorted draw list, one per thread, so
+	// executing them in order keeps the draw order
+	const size_t thread_count = std::min<size_t>(
+			_record_threads, frame.thread_command_buffers.size());
+	const uint32_t chunk_count =
+			(uint32_t)std::min<size_t>(thread_count, group_count);
+
+	if (chunk_count == 0) {
+		return;
+	}
+
+	const VkFormat color_format = _draw_image.image_format;
+	VkCommandBufferInheritanceRenderingInfo rendering_info = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO,
+		.pNext = nullptr,
+		.colorAttachmentCount = 1,
+		.pColorAttachmentFormats = &color_format,
+		.depthAttachmentFormat = _depth_image.image_format,
+		.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
+	};
+
+	VkCommandBufferInheritanceInfo inheritance_info = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+		.pNext = &rendering_info,
+	};
+
+	VkCommandBufferBeginInfo begin_info = vkinit::command_buffer_begin_info(
+			VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT |
+			VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT);
+	begin_info.pInheritanceInfo = &inheritance_info;
+
+	std::vector<CommandEncoderStats> chunk_stats(chunk_count);
+
+	// every chunk has its own pool, so no two threads ever record into the
+	// same one
+	_job_system.parallel_for(chunk_count, [&](size_t c) {
+		VkCommandBuffer secondary = frame.thread_command_buffers[c];
+		VK_CHECK(vkBeginCommandBuffer(secondary, &begin_info));
+
+		// dynamic state is not inherited from the primary buffer
+		set_draw_viewport(secondary);
+
+		CommandEncoder encoder(secondary);
+		const size_t first_group = group_count * c / chunk_count;
+		const size_t last_group = group_count * (c + 1) / chunk_count;
+		draw_instanced(encoder, opaque.surfaces,
+				std::span(opaque.groups)
+						.subspan(first_group, last_group - first_group),
+				variant);
+		chunk_stats[c] = encoder.stats();
+
+		VK_CHECK(vkEndCommandBuffer(secondary));
+	});
+
+	vkCmdExecuteCommands(
+			cmd, chunk_count, frame.thread_command_buffers.data());
+
+	for (const CommandEncoderStats& stats : chunk_stats) {
+		_stats.commands += stats;
+	}
+}
+
+void VulkanEngine::upload_instances(FrameData& frame) {
+	const std::vector<glm::mat4>& transforms =
+			_main_draw_context.instance_transforms;
+	if (transforms.empty()) {
+		return;
+	}
+
+	// the frame's previous submission has finished, so its transforms can be
+	// overwritten
+	reserve_instance_buffer(frame, (uint32_t)transforms.size());
+	memcpy(frame.instance_buffer.info.pMappedData, transforms.data(),
+			transforms.size() * sizeof(glm::mat4));
+
+	frame.instance_buffer_address =
+			get_buffer_address(_device, frame.instance_buffer.buffer);
+}
+
+void VulkanEngine::bind_scene_set(CommandEncoder& encoder,
+		VkPipelineLayout layout, const FrameData& frame) {
+	if (_push_descriptors) {
+		encoder.push_descriptor_set(layout, 0, frame.scene_writer);
+	} else {
+		encoder.bind_descriptor_set(layout, 0, frame.scene_descriptor,
+				{ &frame.scene_data_offset, 1 });
+	}
+}
+
+void VulkanEngine::draw_instanced(CommandEncoder& encoder,
+		std::span<const RenderObject> surfaces,
+		std::span<const InstanceGroup> groups, DrawVariant variant) {
+	const FrameData& frame = get_current_frame();
+
+	// the prepass only reads the position stream
+	const bool depth_only = variant == DrawVariant::DepthPrepass;
+	const VkDeviceAddress vertex_buffer_address = depth_only
+			? _geometry_buffer.position_buffer_address()
+			: _geometry_buffer.vertex_buffer_address();
+	const VkDeviceAddress instance_buffer_address =
+			frame.instance_buffer_address;
+
+	// drawn in key order, grouped by state
+	for (const InstanceGroup& group : groups) {
+		const RenderObject& draw = surfaces[group.draw];
+		const MaterialPipeline* pipeline = draw.material->pipeline;
+		switch (variant) {
+		case DrawVariant::Color:
+			break;
+		case DrawVariant::DepthEqual:
+			pipeline = draw.material->depth_equal_pipeline;
+			break;
+		case DrawVariant::DepthPrepass:
+			pipeline = draw.material->depth_prepass_pipeline;
+			break;
+		case DrawVariant::WeightedBlended:
+			pipeline = draw.material->oit_pipeline;
+			break;
+		}
+		const VkPipelineLayout layout = pipeline->layout;
+
+		encoder.bind_pipeline(pipeline->pipeline);
+
+		// every pipeline shares the layout and the sets, so these only
+		// reach vulkan once
+		bind_scene_set(encoder, layout, frame);
+		encoder.bind_descriptor_set(layout, 1, _bindless.set());
+
+		// push constants, the transforms come from the instance buffer so
+		// these only change with the material and the packed vertex
+		// dequantization
+		if (_options.packed_vertices) {
+			GPUPackedDrawPushConstants push_constants = {
+				.position_offset = glm::vec4(draw.position_offset, 0.f),
+				.position_scale = glm::vec4(draw.position_scale, 0.f),
+				.vertex_buffer = vertex_buffer_address,
+				.instance_buffer = instance_buffer_address,
+				.material_index = draw.material->id,
+			};
+			encoder.push_constants(layout, VK_SHADER_STAGE_VERTEX_BIT,
+					sizeof(GPUPackedDrawPushConstants), &push_constants);
+		} else {
+			GPUInstancedDrawPushConstants push_constants = {
+				.vertex_buffer = vertex_buffer_address,
+				.instance_buffer = instance_buffer_address,
+				.material_index = draw.material->id,
+			};
+			encoder.push_constants(layout, VK_SHADER_STAGE_VERTEX_BIT,
+					sizeof(GPUInstancedDrawPushConstants), &push_constants);
+		}
+
+		// every mesh shares the geometry buffer, so this only reaches vulkan
+		// when the index type changes
+		encoder.bind_index_buffer(
+				_geometry_buffer.index_buffer(), 0, draw.index_type);
+
+		// draw, gl_InstanceIndex starts at the group's first transform
+		encoder.draw_indexed(draw.index_count, group.instance_count,
+				draw.first_index, draw.vertex_offset, group.first_instance);
+	}
+}
+
+uint32_t VulkanEngine::depth_pyramid_levels(VkExtent2D draw_extent) const {
+	uint32_t levels = 0;
+	glm::uvec2 extent = { draw_extent.width, draw_extent.height };
+	do {
+		extent = (extent + 1u) / 2u;
+		levels++;
+	} while (extent.x > 1 || extent.y > 1);
+
+	// rounding up can take one level more than the image has
+	return std::min(levels, (uint32_t)_depth_reduce_descriptors.size());
+}
+
+void VulkanEngine::cull_indirect(VkCommandBuffer cmd) {
+	FrameData& frame = get_current_frame();
+	const DrawContext& ctx = _main_draw_context;
+
+	// counts of the frame's previous submission, before they are reset
+	if (frame.batches_written > 0) {
+		vmaInvalidateAllocation(
+				_allocator, frame.batch_buffer.allocation, 0, VK_WHOLE_SIZE);
+
+		const GPUDrawBatch* batches =
+				(const GPUDrawBatch*)frame.batch_buffer.info.pMappedData;
+		uint32_t visible_count = 0;
+		for (uint32_t b = 0; b < frame.batches_written; b++) {
+			visible_count += batches[b].count;
+		}
+		_stats.objects_visible = visible_count;
+	}
+
+	if (frame.cull_stats_written) {
+		vmaInvalidateAllocation(_allocator,
+				frame.cull_stats_buffer.allocation, 0, VK_WHOLE_SIZE);
+
+		const GPUCullStats* stats =
+				(const GPUCullStats*)frame.cull_stats_buffer.info.pMappedData;
+		_stats.frustum_culled = stats->frustum_culled;
+		_stats.frustum_culled_triangles = stats->frustum_culled_triangles;
+		_stats.occlusion_culled = stats->occlusion_culled;
+		_stats.occlusion_culled_triangles = stats->occlusion_culled_triangles;
+	}
+
+	const uint32_t object_count = (uint32_t)ctx.gpu_objects.size();
+	const uint32_t batch_count = (uint32_t)ctx.indirect_batches.size();
+
+	frame.batches_written = 0;
+	frame.cull_stats_written = false;
+	if (object_count == 0) {
+		return;
+	}
+
+	// the occlusion phase appends to a second set of batches, with their
+	// commands after those of the first phase
+	const uint32_t phase_count = _occlusion_culling ? 2 : 1;
+	reserve_indirect_buffers(
+			frame, object_count * phase_count, batch_count * phase_count);
+
+	memcpy(frame.object_buffer.info.pMappedData, ctx.gpu_objects.data(),
+			object_count * sizeof(GPUObjectRecord));
+
+	GPUDrawBatch* batches = (GPUDrawBatch*)frame.batch_buffer.info.pMappedData;
+	for (uint32_t phase = 0; phase < phase_count; phase++) {
+		for (uint32_t b = 0; b < batch_count; b++) {
+			batches[phase * batch_count + b] = GPUDrawBatch{
+				.count = 0,
+				.command_offset = phase * object_count +
+						ctx.indirect_batches[b].command_offset,
+			};
+		}
+	}
+	frame.batches_written = batch_count * phase_count;
+
+	*(GPUCullStats*)frame.cull_stats_buffer.info.pMappedData = {};
+	frame.cull_stats_written = true;
+
+	if (_occlusion_culling) {
+		reserve_visibility_buffer(cmd, object_count);
+	}
+
+	GPUCullData cull_data = {
+		.viewproj = _scene_data.viewproj,
+		.draw_extent = glm::vec2(_draw_extent.width, _draw_extent.height),
+		.pyramid_extent = glm::vec2((_draw_extent.width + 1) / 2,
+				(_draw_extent.height + 1) / 2),
+		.pyramid_levels = depth_pyramid_levels(_draw_extent),
+	};
+
+	const Frustum frustum = make_frustum(_scene_data.viewproj);
+	std::copy(std::begin(frustum.planes), std::end(frustum.planes),
+			cull_data.frustum_planes);
+
+	frame.cull_data_offset = write_uniform(frame, cull_data);
+
+	dispatch_cull(cmd,
+			_occlusion_culling ? CullPhase::LastVisible : CullPhase::Frustum);
+}
+
+void VulkanEngine::dispatch_cull(VkCommandBuffer cmd, CullPhase phase) {
+	const FrameData& frame = get_current_frame();
+	const DrawContext& ctx = _main_draw_context;
+
+	const uint32_t object_count = (uint32_t)ctx.gpu_objects.size();
+
+	GPUCullPushConstants push_constants = {
+		.object_buffer =
+				get_buffer_address(_device, frame.object_buffer.buffer),
+		.batch_buffer = get_buffer_address(_device, frame.batch_buffer.buffer),
+		.command_buffer =
+				get_buffer_address(_device, frame.indirect_buffer.buffer),
+		.visibility_buffer = phase == CullPhase::Frustum
+				? 0
+				: get_buffer_address(_device, _visibility_buffer.buffer),
+		.stats_buffer =
+				get_buffer_address(_device, frame.cull_stats_buffer.buffer),
+		.object_count = object_count,
+		.batch_count = (uint32_t)ctx.indirect_batches.size(),
+		.phase = phase,
+	};
+
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _cull_pipeline);
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+			_cull_pipeline_layout, 0, 1, &frame.cull_descriptor, 1,
+			&frame.cull_data_offset);
+	vkCmdPushConstants(cmd, _cull_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT,
+			0, sizeof(GPUCullPushConstants), &push_constants);
+
+	// 64 objects per workgroup
+	vkCmdDispatch(cmd, (object_count + 63) / 64, 1, 1);
+
+	// the draws read the commands and counts the pass appended, and the
+	// next culling pass the visibility it wrote, which may be in the next
+	// frame's submission
+	VkMemoryBarrier2 barrier = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+		.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+		.srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+		.dstStageMask = VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT |
+				VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+		.dstAccessMask = VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT |
+				VK_ACCESS_2_SHADER_STORAGE_READ_BIT |
+				VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+	};
+
+	VkDependencyInfo dep_info = {
+		.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+		.memoryBarrierCount = 1,
+		.pMemoryBarriers = &barrier,
+	};
+	vkCmdPipelineBarrier2(cmd, &dep_info);
+}
+
+void VulkanEngine::draw_indirect(CommandEncoder& encoder, CullPhase phase) {
+	const FrameData& frame = get_current_frame();
+	const std::vector<IndirectBatch>& batches =
+			_main_draw_context.indirect_batches;
+
+	// the occlusion phase has its own batches and commands after those of
+	// the first one
+	const bool second_phase = phase == CullPhase::Occlusion;
+	const uint32_t batch_offset =
+			second_phase ? (uint32_t)batches.size() : 0;
+	const uint32_t command_offset = second_phase
+			? (uint32_t)_main_draw_context.gpu_objects.size()
+			: 0;
+
+	GPUIndirectDrawPushConstants push_constants = {
+		.vertex_buffer = _geometry_buffer.vertex_buffer_address(),
+		.object_buffer =
+				get_buffer_address(_device, frame.object_buffer.buffer),
+	};
+
+	for (size_t b = 0; b < batches.size(); b++) {
+		const IndirectBatch& batch = batches[b];
+		const MaterialPipeline* pipeline = batch.material->indirect_pipeline;
+
+		encoder.bind_pipeline(pipeline->pipeline);
+		bind_scene_set(encoder, pipeline->layout, frame);
+		encoder.bind_descriptor_set(pipeline->layout, 1, _bindless.set());
+		push_constants.material_index = batch.material->id;
+		encoder.push_constants(pipeline->layout, VK_SHADER_STAGE_VERTEX_BIT,
+				sizeof(GPUIndirectDrawPushConstants), &push_constants);
+		encoder.bind_index_buffer(
+				_geometry_buffer.index_buffer(), 0, batch.index_type);
+
+		// up to every object of the batch, the culling pass wrote how many
+		// actually survived
+		encoder.draw_indexed_indirect_count(frame.indirect_buffer.buffer,
+				(command_offset + batch.command_offset) *
+						sizeof(VkDrawIndexedIndirectCommand),
+				frame.batch_buffer.buffer,
+				(batch_offset + b) * sizeof(GPUDrawBatch), batch.max_count,
+				sizeof(VkDrawIndexedIndirectCommand));
+	}
+}
+
+void VulkanEngine::build_depth_pyramid(VkCommandBuffer cmd) {
+	vkutil::transition_image(cmd, _depth_image.image,
+			VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL,
+			VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL);
+	// every level is rewritten, the old contents can go
+	vkutil::transition_image(cmd, _depth_pyramid.image,
+			VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+
+	vkCmdBindPipeline(
+			cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _depth_reduce_pipeline);
+
+	VkMemoryBarrier2 barrier = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+		.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+		.srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+		.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+		.dstAccessMask = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+	};
+
+	VkDependencyInfo dep_info = {
+		.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+		.memoryBarrierCount = 1,
+		.pMemoryBarriers = &barrier,
+	};
+
+	const uint32_t levels = depth_pyramid_levels(_draw_extent);
+	glm::ivec2 source_extent = { _draw_extent.width, _draw_extent.height };
+	for (uint32_t level = 0; level < levels; level++) {
+		const glm::ivec2 destination_extent = (source_extent + 1) / 2;
+
+		GPUDepthReducePushConstants push_constants = {
+			.source_extent = source_extent,
+			.destination_extent = destination_extent,
+		};
+
+		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+				_depth_reduce_pipeline_layout, 0, 1,
+				&_depth_reduce_descriptors[level], 0, nullptr);
+		vkCmdPushConstants(cmd, _depth_reduce_pipeline_layout,
+				VK_SHADER_STAGE_COMPUTE_BIT, 0,
+				sizeof(GPUDepthReducePushConstants), &push_constants);
+
+		// 8x8 texels per workgroup
+		vkCmdDispatch(cmd, (destination_extent.x + 7) / 8,
+				(destination_extent.y + 7) / 8, 1);
+
+		// the next level and the culling pass read this one
+		vkCmdPipelineBarrier2(cmd, &dep_info);
+
+		source_extent = destination_extent;
+	}
+
+	vkutil::transition_image(cmd, _depth_image.image,
+			VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL,
+			VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL);
+}
 
-	e = vkQueuePresentKHR(_graphics_queue, &present_info);
-	if (e == VK_ERROR_OUT_OF_DATE_KHR) {
-		_resize_requested = true;
+void VulkanEngine::draw_occlusion_phase(VkCommandBuffer cmd) {
+	if (_main_draw_context.gpu_objects.empty()) {
+		return;
 	}
 
-	// increase the number of frames drawn
-	_frame_number++;
-}
+	build_depth_pyramid(cmd);
 
-void VulkanEngine::draw_geometry(VkCommandBuffer cmd) {
-	// begin a render pass  connected to our draw image
+	dispatch_cull(cmd, CullPhase::Occlusion);
+
+	// over the color and depth of the first phase
 	VkRenderingAttachmentInfo color_attachment = vkinit::attachment_info(
 			_draw_image.image_view, nullptr, VK_IMAGE_LAYOUT_GENERAL);
 	VkRenderingAttachmentInfo depth_attachment = vkinit::depth_attachment_info(
 			_depth_image.image_view, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL);
+	depth_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
 
 	VkRenderingInfo render_info = vkinit::rendering_info(
 			_draw_extent, &color_attachment, &depth_attachment);
 	vkCmdBeginRendering(cmd, &render_info);
 
-	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _mesh_pipeline);
+	set_draw_viewport(cmd);
 
-	// set dynamic viewport and scissor
-	VkViewport viewport = {};
-	viewport.x = 0;
-	viewport.y = 0;
-	viewport.width = _draw_extent.width;
-	viewport.height = _draw_extent.height;
-	viewport.minDepth = 0.0f;
-	viewport.maxDepth = 1.0f;
+	CommandEncoder encoder(cmd);
+	draw_indirect(encoder, CullPhase::Occlusion);
+	_stats.commands += encoder.stats();
 
-	vkCmdSetViewport(cmd, 0, 1, &viewport);
+	vkCmdEndRendering(cmd);
+}
 
-	VkRect2D scissor = {};
-	scissor.offset.x = 0;
-	scissor.offset.y = 0;
-	scissor.extent.width = _draw_extent.width;
-	scissor.extent.height = _draw_extent.height;
+void VulkanEngine::draw_transparent(VkCommandBuffer cmd) {
+	const DrawList& transparent = _main_draw_context.transparent;
+	if (transparent.groups.empty()) {
+		return;
+	}
 
-	vkCmdSetScissor(cmd, 0, 1, &scissor);
+	const bool oit = _transparency_mode == TransparencyMode::WeightedBlended;
 
-	// prepare global uniform buffer
-	AllocatedBuffer gpu_scene_data_buffer = create_buffer(sizeof(GPUSceneData),
-			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+	// tested against the opaque depth, which is not written again
+	VkRenderingAttachmentInfo depth_attachment = vkinit::depth_attachment_info(
+			_depth_image.image_view, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL);
+	depth_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
 
-	// add it to the deletion queue of this frame so it gets deleted once
-	// its been used
-	get_current_frame().deletion_queue.push_function(
-			[=, this]() { destroy_buffer(gpu_scene_data_buffer); });
+	VkRenderingAttachmentInfo color_attachments[2];
+	uint32_t color_attachment_count = 1;
+	if (oit) {
+		vkutil::transition_image(cmd, _oit_accum_image.image,
+				VK_IMAGE_LAYOUT_UNDEFINED,
+				VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+		vkutil::transition_image(cmd, _oit_revealage_image.image,
+				VK_IMAGE_LAYOUT_UNDEFINED,
+				VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
 
-	// write the buffer
-	GPUSceneData* scene_uniform_data =
-			(GPUSceneData*)gpu_scene_data_buffer.allocation->GetMappedData();
-	*scene_uniform_data = _scene_data;
+		// nothing accumulated, and whatever is behind fully revealed
+		VkClearValue accum_clear = { .color = { { 0.f, 0.f, 0.f, 0.f } } };
+		VkClearValue revealage_clear = { .color = { { 1.f, 0.f, 0.f, 0.f } } };
+		color_attachments[0] = vkinit::attachment_info(
+				_oit_accum_image.image_view, &accum_clear,
+				VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+		color_attachments[1] = vkinit::attachment_info(
+				_oit_revealage_image.image_view, &revealage_clear,
+				VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+		color_attachment_count = 2;
+	} else {
+		color_attachments[0] = vkinit::attachment_info(
+				_draw_image.image_view, nullptr, VK_IMAGE_LAYOUT_GENERAL);
+	}
 
-	// create a descriptor set that binds that buffer and update it
-	VkDescriptorSet global_descriptor =
-			get_current_frame().frame_descriptors.allocate(
-					_device, _gpu_scene_data_descriptor_layout);
+	VkRenderingInfo render_info = vkinit::rendering_info(
+			_draw_extent, color_attachments, &depth_attachment);
+	render_info.colorAttachmentCount = color_attachment_count;
 
-	DescriptorWriter writer;
-	writer.write_buffer(0, gpu_scene_data_buffer.buffer, sizeof(GPUSceneData),
-			0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
-	writer.update_set(_device, global_descriptor);
-
-	for (const RenderObject& draw : _main_draw_context.opaque_surfaces) {
-		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
-				draw.material->pipeline->pipeline);
-
-		// bind descriptor sets
-		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
-				draw.material->pipeline->layout, 0, 1, &global_descriptor, 0,
-				nullptr);
-		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
-				draw.material->pipeline->layout, 1, 1,
-				&draw.material->material_set, 0, nullptr);
-
-		// push constants
-		GPUDrawPushConstants push_constants = {
-			.world_matrix = draw.transform,
-			.vertex_buffer = draw.vertex_buffer_address,
-		};
-		vkCmdPushConstants(cmd, draw.material->pipeline->layout,
-				VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(GPUDrawPushConstants),
-				&push_constants);
+	vkCmdBeginRendering(cmd, &render_info);
+	set_draw_viewport(cmd);
 
-		// draw
-		vkCmdBindIndexBuffer(cmd, draw.index_buffer, 0, VK_INDEX_TYPE_UINT32);
-		vkCmdDrawIndexed(cmd, draw.index_count, 1, draw.first_index, 0, 0);
-	}
+	CommandEncoder encoder(cmd);
+	draw_instanced(encoder, transparent.surfaces, transparent.groups,
+			oit ? DrawVariant::WeightedBlended : DrawVariant::Color);
+	_stats.commands += encoder.stats();
 
 	vkCmdEndRendering(cmd);
+
+	if (!oit) {
+		return;
+	}
+
+	// composite the weighted average over the opaque image
+	vkutil::transition_image(cmd, _oit_accum_image.image,
+			VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	vkutil::transition_image(cmd, _oit_revealage_image.image,
+			VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	vkutil::transition_image(cmd, _draw_image.image,
+			VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL);
+
+	vkCmdBindPipeline(
+			cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _oit_resolve_pipeline);
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+			_oit_resolve_pipeline_layout, 0, 1, &_oit_resolve_descriptors, 0,
+			nullptr);
+
+	GPUOITResolvePushConstants push_constants = {
+		.extent = glm::ivec2(_draw_extent.width, _draw_extent.height),
+	};
+	vkCmdPushConstants(cmd, _oit_resolve_pipeline_layout,
+			VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(GPUOITResolvePushConstants),
+			&push_constants);
+
+	// 16x16 workgroups
+	vkCmdDispatch(cmd, (_draw_extent.width + 15) / 16,
+			(_draw_extent.height + 15) / 16, 1);
+
+	// the rest of the frame expects the draw image as an attachment
+	vkutil::transition_image(cmd, _draw_image.image, VK_IMAGE_LAYOUT_GENERAL,
+			VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
 }
 
 void VulkanEngine::draw_background(VkCommandBuffer cmd) {
@@ -848,6 +2553,7 @@ void VulkanEngine::init_vulkan() {
 	auto inst_ret = builder.set_app_name("Example Vulkan Application")
 							.use_default_debug_messenger()
 							.require_api_version(1, 3, 0)
+							.set_headless(_options.headless)
 							.build();
 
 	vkb::Instance vkb_inst = inst_ret.value();
@@ -855,7 +2561,9 @@ void VulkanEngine::init_vulkan() {
 	_instance = vkb_inst.instance;
 	_debug_messenger = vkb_inst.debug_messenger;
 
-	SDL_Vulkan_CreateSurface(_window, _instance, &_surface);
+	if (!_options.headless) {
+		SDL_Vulkan_CreateSurface(_window, _instance, &_surface);
+	}
 
 	VkPhysicalDeviceVulkan13Features features{};
 	features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
@@ -866,33 +2574,92 @@ void VulkanEngine::init_vulkan() {
 	features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
 	features12.bufferDeviceAddress = true;
 	features12.descriptorIndexing = true;
+	// the bindless arrays are partially filled and grow while in use
+	features12.descriptorBindingPartiallyBound = true;
+	features12.descriptorBindingSampledImageUpdateAfterBind = true;
+	features12.descriptorBindingUpdateUnusedWhilePending = true;
+	features12.timelineSemaphore = true;
+	// the gpu driven path draws whole batches with a count written by the
+	// culling pass, and passes the object index as the first instance
+	features12.drawIndirectCount = _options.gpu_driven;
+
+	VkPhysicalDeviceFeatures features10{};
+	features10.drawIndirectFirstInstance = _options.gpu_driven;
+	// every draw indexes the bindless arrays with its own material's indices
+	features10.shaderSampledImageArrayDynamicIndexing = true;
 
 	//use vkbootstrap to select a gpu.
 	//We want a gpu that can write to the SDL surface and supports vulkan 1.3
 	//with the correct features
 	vkb::PhysicalDeviceSelector selector{ vkb_inst };
-	vkb::PhysicalDevice physical_device =
-			selector.set_minimum_version(1, 3)
-					.set_required_features_13(features)
-					.set_required_features_12(features12)
-					.set_surface(_surface)
-					.select()
-					.value();
+	selector.set_minimum_version(1, 3)
+			.set_required_features_13(features)
+			.set_required_features_12(features12)
+			.set_required_features(features10);
+	// a headless instance does not need presentation support
+	if (!_options.headless) {
+		selector.set_surface(_surface);
+	}
+	vkb::PhysicalDevice physical_device = selector.select().value();
+
+	// the scene set is pushed where possible. Lavapipe has the extension,
+	// --no-push-descriptors exercises the fallback there.
+	_push_descriptors = _options.push_descriptors &&
+			physical_device.enable_extension_if_present(
+					VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME);
 
 	//create the final vulkan device
 	vkb::DeviceBuilder device_builder{ physical_device };
 	vkb::Device vkb_device = device_builder.build().value();
 
 	_device = vkb_device.device;
+	_push_descriptors = _push_descriptors && load_push_descriptor(_device);
 	_chosenGPU = physical_device.physical_device;
 
 	_graphics_queue = vkb_device.get_queue(vkb::QueueType::graphics).value();
 	_graphics_queue_family =
 			vkb_device.get_queue_index(vkb::QueueType::graphics).value();
 
+	// uploads prefer a transfer only family, then any family other than the
+	// graphics one, and share the graphics queue if there is neither
+	auto dedicated_transfer =
+			vkb_device.get_dedicated_queue(vkb::QueueType::transfer);
+	auto separate_transfer = vkb_device.get_queue(vkb::QueueType::transfer);
+	if (dedicated_transfer) {
+		_transfer_queue = dedicated_transfer.value();
+		_transfer_queue_family =
+				vkb_device.get_dedicated_queue_index(vkb::QueueType::transfer)
+						.value();
+	} else if (separate_transfer) {
+		_transfer_queue = separate_transfer.value();
+		_transfer_queue_family =
+				vkb_device.get_queue_index(vkb::QueueType::transfer).value();
+	} else {
+		_transfer_queue = _graphics_queue;
+		_transfer_queue_family = _graphics_queue_family;
+	}
+
+	_device_name = physical_device.properties.deviceName;
+	_min_uniform_alignment =
+			physical_device.properties.limits.minUniformBufferOffsetAlignment;
+
+	// timestamps are only usable if the graphics queue reports valid bits
+	uint32_t queue_family_count = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(
+			_chosenGPU, &queue_family_count, nullptr);
+	std::vector<VkQueueFamilyProperties> queue_families(queue_family_count);
+	vkGetPhysicalDeviceQueueFamilyProperties(
+			_chosenGPU, &queue_family_count, queue_families.data());
+
+	if (queue_families[_graphics_queue_family].timestampValidBits != 0) {
+		_timestamp_period = physical_device.properties.limits.timestampPeriod;
+	}
+
 	// instance cleanup
 	_deletion_queue.push_function([this]() {
-		vkDestroySurfaceKHR(_instance, _surface, nullptr);
+		if (_surface) {
+			vkDestroySurfaceKHR(_instance, _surface, nullptr);
+		}
 		vkDestroyDevice(_device, nullptr);
 
 		vkb::destroy_debug_utils_messenger(_instance, _debug_messenger);
@@ -911,9 +2678,11 @@ void VulkanEngine::init_vulkan() {
 }
 
 void VulkanEngine::init_swapchain() {
-	create_swapchain(_window_extent.width, _window_extent.height);
+	if (!_options.headless) {
+		create_swapchain(_window_extent.width, _window_extent.height);
 
-	_deletion_queue.push_function([this]() { destroy_swapchain(); });
+		_deletion_queue.push_function([this]() { destroy_swapchain(); });
+	}
 
 	// draw image size will match the window
 	VkExtent3D draw_image_extent = {
@@ -955,8 +2724,10 @@ void VulkanEngine::init_swapchain() {
 	_depth_image.image_format = VK_FORMAT_D32_SFLOAT;
 	_depth_image.image_extent = draw_image_extent;
 
+	// sampled by the depth pyramid reduction
 	VkImageUsageFlags depth_image_uses =
-			VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+			VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+			VK_IMAGE_USAGE_SAMPLED_BIT;
 
 	VkImageCreateInfo dimg_info = vkinit::image_create_info(
 			_depth_image.image_format, depth_image_uses, draw_image_extent);
@@ -973,6 +2744,14 @@ void VulkanEngine::init_swapchain() {
 	VK_CHECK(vkCreateImageView(
 			_device, &dview_info, nullptr, &_depth_image.image_view));
 
+	// weighted blended transparency targets, read by the resolve pass
+	_oit_accum_image = create_image(draw_image_extent,
+			VK_FORMAT_R16G16B16A16_SFLOAT,
+			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+	_oit_revealage_image = create_image(draw_image_extent,
+			VK_FORMAT_R16_SFLOAT,
+			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+
 	// deletion queues
 	_deletion_queue.push_function([this]() {
 		vkDestroyImageView(_device, _draw_image.image_view, nullptr);
@@ -981,6 +2760,9 @@ void VulkanEngine::init_swapchain() {
 		vkDestroyImageView(_device, _depth_image.image_view, nullptr);
 		vmaDestroyImage(
 				_allocator, _depth_image.image, _depth_image.allocation);
+
+		destroy_image(_oit_accum_image);
+		destroy_image(_oit_revealage_image);
 	});
 }
 
@@ -1005,23 +2787,62 @@ void VulkanEngine::init_commands() {
 
 		VK_CHECK(vkAllocateCommandBuffers(
 				_device, &cmd_alloc_info, &_frames[i].main_command_buffer));
+
+		// one pool and secondary buffer per recording thread. The pools are
+		// reset as a whole once the frame's fence has been waited on.
+		VkCommandPoolCreateInfo thread_pool_info =
+				vkinit::command_pool_create_info(_graphics_queue_family,
+						VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+
+		const uint32_t thread_count = _job_system.thread_count();
+		_frames[i].thread_command_pools.resize(thread_count);
+		_frames[i].thread_command_buffers.resize(thread_count);
+		for (uint32_t t = 0; t < thread_count; t++) {
+			VK_CHECK(vkCreateCommandPool(_device, &thread_pool_info, nullptr,
+					&_frames[i].thread_command_pools[t]));
+
+			VkCommandBufferAllocateInfo secondary_alloc_info =
+					vkinit::command_buffer_allocate_info(
+							_frames[i].thread_command_pools[t], 1);
+			secondary_alloc_info.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+
+			VK_CHECK(vkAllocateCommandBuffers(_device, &secondary_alloc_info,
+					&_frames[i].thread_command_buffers[t]));
+		}
+
+		_deletion_queue.push_function([this, i]() {
+			for (VkCommandPool pool : _frames[i].thread_command_pools) {
+				vkDestroyCommandPool(_device, pool, nullptr);
+			}
+		});
+
+		// the per frame draw buffers are created the first time they are
+		// needed
+		_deletion_queue.push_function([this, i]() {
+			FrameData& frame = _frames[i];
+			if (frame.instance_capacity > 0) {
+				destroy_buffer(frame.instance_buffer);
+			}
+			if (frame.object_capacity > 0) {
+				destroy_buffer(frame.object_buffer);
+				destroy_buffer(frame.indirect_buffer);
+			}
+			if (frame.batch_capacity > 0) {
+				destroy_buffer(frame.batch_buffer);
+			}
+		});
 	}
 
-	// create imgui commands
+	// create the upload context used for every staging copy
 	{
-		VK_CHECK(vkCreateCommandPool(
-				_device, &command_pool_info, nullptr, &_imm_command_pool));
+		constexpr VkDeviceSize STAGING_RING_SIZE = 64 * 1024 * 1024;
 
-		// allocate the command buffer for immediate submits
-		VkCommandBufferAllocateInfo cmd_alloc_info =
-				vkinit::command_buffer_allocate_info(_imm_command_pool, 1);
-
-		VK_CHECK(vkAllocateCommandBuffers(
-				_device, &cmd_alloc_info, &_imm_command_buffer));
+		_upload_context.init(_device, _allocator, _transfer_queue,
+				_transfer_queue_family, _graphics_queue_family,
+				STAGING_RING_SIZE);
 
-		_deletion_queue.push_function([this]() {
-			vkDestroyCommandPool(_device, _imm_command_pool, nullptr);
-		});
+		_deletion_queue.push_function(
+				[this]() { _upload_context.destroy(); });
 	}
 }
 
@@ -1056,11 +2877,22 @@ void VulkanEngine::init_sync_structures() {
 		});
 	}
 
-	// imgui sync structures
-	{
-		VK_CHECK(vkCreateFence(_device, &fence_info, nullptr, &_imm_fence));
-		_deletion_queue.push_function(
-				[this]() { vkDestroyFence(_device, _imm_fence, nullptr); });
+	// timestamp queries to measure the gpu time of every frame
+	if (_timestamp_period > 0.0f) {
+		VkQueryPoolCreateInfo query_pool_info = {
+			.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+			.queryType = VK_QUERY_TYPE_TIMESTAMP,
+			.queryCount = 2,
+		};
+
+		for (int i = 0; i < FRAME_OVERLAP; i++) {
+			VK_CHECK(vkCreateQueryPool(_device, &query_pool_info, nullptr,
+					&_frames[i].timestamp_pool));
+
+			_deletion_queue.push_function([this, i]() {
+				vkDestroyQueryPool(_device, _frames[i].timestamp_pool, nullptr);
+			});
+		}
 	}
 }
 
@@ -1116,9 +2948,13 @@ void VulkanEngine::init_descriptors() {
 	// create a descriptor pool that will hold 10 sets with 1 image each
 	std::vector<DescriptorAllocatorGrowable::PoolSizeRatio> sizes = {
 		{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1 },
+		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1 },
+		{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1 },
 	};
 
 	_global_descriptor_allocator.init(_device, 10, sizes);
+	_descriptor_cache.init(
+			&_global_descriptor_allocator, DESCRIPTOR_CACHE_CAPACITY);
 
 	// make the descriptor set layout for our compute draw
 	{
@@ -1126,6 +2962,8 @@ void VulkanEngine::init_descriptors() {
 		builder.add_binding(0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
 		_draw_image_descriptor_layout =
 				builder.build(_device, VK_SHADER_STAGE_COMPUTE_BIT);
+		_global_descriptor_allocator.describe_layout(
+				_draw_image_descriptor_layout, builder.bindings);
 	}
 
 	// allocate a descriptor set for our draw image
@@ -1156,28 +2994,43 @@ void VulkanEngine::init_descriptors() {
 	writer.update_set(_device, _draw_image_descriptors);
 #endif
 
+	{
+		const VkShaderStageFlags stages =
+				VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+		DescriptorLayoutBuilder builder;
+		if (_push_descriptors) {
+			// push descriptors cannot be dynamic, the offset is part of the
+			// pushed descriptor instead
+			builder.add_binding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+			_gpu_scene_data_descriptor_layout =
+					builder.build_push(_device, stages);
+		} else {
+			builder.add_binding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC);
+			_gpu_scene_data_descriptor_layout = builder.build(_device, stages);
+			_global_descriptor_allocator.describe_layout(
+					_gpu_scene_data_descriptor_layout, builder.bindings);
+		}
+	}
+
+	// every frame writes its uniforms to its own arena and keeps one scene
+	// set pointing at it for its whole lifetime, unless it is pushed
 	for (int i = 0; i < FRAME_OVERLAP; i++) {
-		// create a descriptor pool
-		std::vector<DescriptorAllocatorGrowable::PoolSizeRatio> frame_sizes = {
-			{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 3 },
-			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3 },
-			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3 },
-			{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4 },
-		};
+		_frames[i].uniforms.init(
+				_allocator, UNIFORM_ARENA_SIZE, _min_uniform_alignment);
 
-		_frames[i].frame_descriptors = DescriptorAllocatorGrowable{};
-		_frames[i].frame_descriptors.init(_device, 1000, frame_sizes);
+		_deletion_queue.push_function(
+				[this, i]() { _frames[i].uniforms.destroy(); });
 
-		_deletion_queue.push_function([&, i]() {
-			_frames[i].frame_descriptors.destroy_pools(_device);
-		});
-	}
+		if (_push_descriptors) {
+			continue;
+		}
 
-	{
-		DescriptorLayoutBuilder builder;
-		builder.add_binding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
-		_gpu_scene_data_descriptor_layout = builder.build(_device,
-				VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT);
+		DescriptorWriter writer;
+		writer.write_buffer(0, _frames[i].uniforms.buffer(),
+				sizeof(GPUSceneData), 0,
+				VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC);
+		_frames[i].scene_descriptor = _descriptor_cache.acquire(
+				_device, _gpu_scene_data_descriptor_layout, writer);
 	}
 
 	{
@@ -1186,11 +3039,23 @@ void VulkanEngine::init_descriptors() {
 		_single_image_descriptor_layout =
 				builder.build(_device, VK_SHADER_STAGE_FRAGMENT_BIT);
 	}
+
+	// constants of every material, and their textures and samplers
+	_material_registry.init(_allocator, MATERIAL_CAPACITY, FRAME_OVERLAP);
+	_bindless.init(_device, _material_registry.buffer(),
+			_material_registry.size());
+	_deletion_queue.push_function([this]() {
+		_bindless.destroy();
+		_material_registry.destroy();
+	});
 }
 
 void VulkanEngine::init_pipelines() {
 	init_background_pipelines();
 	init_mesh_pipeline();
+	init_depth_pyramid();
+	init_cull_pipeline();
+	init_oit_resolve_pipeline();
 
 	_metal_rough_material.build_pipeline(this);
 }
@@ -1279,6 +3144,21 @@ void VulkanEngine::init_background_pipelines() {
 	});
 }
 
+void VulkanEngine::init_geometry_buffer() {
+	const uint32_t vertex_stride = _options.packed_vertices
+			? (uint32_t)sizeof(PackedVertex)
+			: (uint32_t)sizeof(Vertex);
+	const uint32_t position_stride = _options.packed_vertices
+			? (uint32_t)sizeof(PackedPosition)
+			: (uint32_t)sizeof(glm::vec3);
+
+	_geometry_buffer.init(_device, _allocator, vertex_stride,
+			position_stride, GEOMETRY_VERTEX_CAPACITY,
+			GEOMETRY_INDEX_CAPACITY);
+
+	_deletion_queue.push_function([this]() { _geometry_buffer.destroy(); });
+}
+
 void VulkanEngine::init_mesh_pipeline() {
 	VkShaderModule triangle_frag_shader;
 	if (!vkutil::load_shader_module(
@@ -1338,6 +3218,288 @@ void VulkanEngine::init_mesh_pipeline() {
 	});
 }
 
+void VulkanEngine::init_cull_pipeline() {
+	{
+		DescriptorLayoutBuilder builder;
+		builder.add_binding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC);
+		builder.add_binding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+		_cull_descriptor_layout =
+				builder.build(_device, VK_SHADER_STAGE_COMPUTE_BIT);
+		_global_descriptor_allocator.describe_layout(
+				_cull_descriptor_layout, builder.bindings);
+	}
+
+	// like the scene set, every frame points one set at its uniform arena
+	for (int i = 0; i < FRAME_OVERLAP; i++) {
+		DescriptorWriter writer;
+		writer.write_buffer(0, _frames[i].uniforms.buffer(),
+				sizeof(GPUCullData), 0,
+				VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC);
+		writer.write_image(1, _depth_pyramid.image_view,
+				_depth_pyramid_sampler, VK_IMAGE_LAYOUT_GENERAL,
+				VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+		_frames[i].cull_descriptor = _descriptor_cache.acquire(
+				_device, _cull_descriptor_layout, writer);
+
+		// host visible, the counters are read back for the stats
+		_frames[i].cull_stats_buffer = create_buffer(sizeof(GPUCullStats),
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+						VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+				VMA_MEMORY_USAGE_CPU_TO_GPU);
+
+		_deletion_queue.push_function([this, i]() {
+			destroy_buffer(_frames[i].cull_stats_buffer);
+		});
+	}
+
+	VkPushConstantRange push_constants = {
+		.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+		.offset = 0,
+		.size = sizeof(GPUCullPushConstants),
+	};
+
+	// the buffers are reached through their device addresses
+	VkPipelineLayoutCreateInfo layout_info = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+		.pNext = nullptr,
+		.setLayoutCount = 1,
+		.pSetLayouts = &_cull_descriptor_layout,
+		.pushConstantRangeCount = 1,
+		.pPushConstantRanges = &push_constants,
+	};
+
+	VK_CHECK(vkCreatePipelineLayout(
+			_device, &layout_info, nullptr, &_cull_pipeline_layout));
+
+	VkShaderModule cull_shader;
+	if (!vkutil::load_shader_module("cull.comp.spv", _device, &cull_shader)) {
+		fmt::print("Error when building the culling compute shader!\n");
+	}
+
+	VkComputePipelineCreateInfo pipeline_info = {
+		.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+		.pNext = nullptr,
+		.stage = vkinit::pipeline_shader_stage_create_info(
+				VK_SHADER_STAGE_COMPUTE_BIT, cull_shader),
+		.layout = _cull_pipeline_layout,
+	};
+
+	VK_CHECK(vkCreateComputePipelines(_device, VK_NULL_HANDLE, 1,
+			&pipeline_info, nullptr, &_cull_pipeline));
+
+	vkDestroyShaderModule(_device, cull_shader, nullptr);
+
+	_deletion_queue.push_function([this]() {
+		vkDestroyPipelineLayout(_device, _cull_pipeline_layout, nullptr);
+		vkDestroyPipeline(_device, _cull_pipeline, nullptr);
+		vkDestroyDescriptorSetLayout(_device, _cull_descriptor_layout, nullptr);
+	});
+}
+
+void VulkanEngine::init_depth_pyramid() {
+	// half the draw image, every texel covers 2x2 depth samples
+	VkExtent3D pyramid_extent = {
+		(_draw_image.image_extent.width + 1) / 2,
+		(_draw_image.image_extent.height + 1) / 2,
+		1,
+	};
+	_depth_pyramid = create_image(pyramid_extent, VK_FORMAT_R32_SFLOAT,
+			VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, true);
+
+	const uint32_t level_count = (uint32_t)std::bit_width(
+			std::max(pyramid_extent.width, pyramid_extent.height));
+	for (uint32_t level = 0; level < level_count; level++) {
+		VkImageViewCreateInfo view_info =
+				vkinit::imageview_create_info(VK_FORMAT_R32_SFLOAT,
+						_depth_pyramid.image, VK_IMAGE_ASPECT_COLOR_BIT);
+		view_info.subresourceRange.baseMipLevel = level;
+
+		VkImageView view;
+		VK_CHECK(vkCreateImageView(_device, &view_info, nullptr, &view));
+		_depth_pyramid_views.push_back(view);
+	}
+
+	// only read with texelFetch, the sampler is never used to filter
+	VkSamplerCreateInfo sampler_info = {
+		.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+		.magFilter = VK_FILTER_NEAREST,
+		.minFilter = VK_FILTER_NEAREST,
+		.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+		.maxLod = VK_LOD_CLAMP_NONE,
+	};
+	VK_CHECK(vkCreateSampler(
+			_device, &sampler_info, nullptr, &_depth_pyramid_sampler));
+
+	{
+		DescriptorLayoutBuilder builder;
+		builder.add_binding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+		builder.add_binding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+		_depth_reduce_descriptor_layout =
+				builder.build(_device, VK_SHADER_STAGE_COMPUTE_BIT);
+		_global_descriptor_allocator.describe_layout(
+				_depth_reduce_descriptor_layout, builder.bindings);
+	}
+
+	// every level reads the one above it, the first reads the depth image.
+	// The sets of all levels come from one allocation.
+	const std::vector<VkDescriptorSetLayout> level_layouts(
+			level_count, _depth_reduce_descriptor_layout);
+	_depth_reduce_descriptors =
+			_global_descriptor_allocator.allocate_many(_device, level_layouts);
+
+	for (uint32_t level = 0; level < level_count; level++) {
+		DescriptorWriter writer;
+		if (level == 0) {
+			writer.write_image(0, _depth_image.image_view,
+					_depth_pyramid_sampler,
+					VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL,
+					VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+		} else {
+			writer.write_image(0, _depth_pyramid_views[level - 1],
+					_depth_pyramid_sampler, VK_IMAGE_LAYOUT_GENERAL,
+					VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+		}
+		writer.write_image(1, _depth_pyramid_views[level], VK_NULL_HANDLE,
+				VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+		writer.update_set(_device, _depth_reduce_descriptors[level]);
+	}
+
+	VkPushConstantRange push_constants = {
+		.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+		.offset = 0,
+		.size = sizeof(GPUDepthReducePushConstants),
+	};
+
+	VkPipelineLayoutCreateInfo layout_info = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+		.pNext = nullptr,
+		.setLayoutCount = 1,
+		.pSetLayouts = &_depth_reduce_descriptor_layout,
+		.pushConstantRangeCount = 1,
+		.pPushConstantRanges = &push_constants,
+	};
+
+	VK_CHECK(vkCreatePipelineLayout(
+			_device, &layout_info, nullptr, &_depth_reduce_pipeline_layout));
+
+	VkShaderModule reduce_shader;
+	if (!vkutil::load_shader_module(
+				"depth_reduce.comp.spv", _device, &reduce_shader)) {
+		fmt::print("Error when building the depth reduce compute shader!\n");
+	}
+
+	VkComputePipelineCreateInfo pipeline_info = {
+		.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+		.pNext = nullptr,
+		.stage = vkinit::pipeline_shader_stage_create_info(
+				VK_SHADER_STAGE_COMPUTE_BIT, reduce_shader),
+		.layout = _depth_reduce_pipeline_layout,
+	};
+
+	VK_CHECK(vkCreateComputePipelines(_device, VK_NULL_HANDLE, 1,
+			&pipeline_info, nullptr, &_depth_reduce_pipeline));
+
+	vkDestroyShaderModule(_device, reduce_shader, nullptr);
+
+	_deletion_queue.push_function([this]() {
+		vkDestroyPipelineLayout(
+				_device, _depth_reduce_pipeline_layout, nullptr);
+		vkDestroyPipeline(_device, _depth_reduce_pipeline, nullptr);
+		vkDestroyDescriptorSetLayout(
+				_device, _depth_reduce_descriptor_layout, nullptr);
+		vkDestroySampler(_device, _depth_pyramid_sampler, nullptr);
+		for (VkImageView view : _depth_pyramid_views) {
+			vkDestroyImageView(_device, view, nullptr);
+		}
+		destroy_image(_depth_pyramid);
+
+		if (_visibility_capacity > 0) {
+			destroy_buffer(_visibility_buffer);
+		}
+	});
+}
+
+void VulkanEngine::init_oit_resolve_pipeline() {
+	{
+		DescriptorLayoutBuilder builder;
+		builder.add_binding(0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+		builder.add_binding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+		builder.add_binding(2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+		_oit_resolve_descriptor_layout =
+				builder.build(_device, VK_SHADER_STAGE_COMPUTE_BIT);
+		_global_descriptor_allocator.describe_layout(
+				_oit_resolve_descriptor_layout, builder.bindings);
+	}
+
+	// the targets are only read with texelFetch, the sampler is never used
+	// to filter
+	VkSamplerCreateInfo sampler_info = {
+		.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+		.magFilter = VK_FILTER_NEAREST,
+		.minFilter = VK_FILTER_NEAREST,
+	};
+	VK_CHECK(vkCreateSampler(_device, &sampler_info, nullptr, &_oit_sampler));
+
+	// the images never change, so neither does the set
+	DescriptorWriter writer;
+	writer.write_image(0, _draw_image.image_view, VK_NULL_HANDLE,
+			VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+	writer.write_image(1, _oit_accum_image.image_view, _oit_sampler,
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+	writer.write_image(2, _oit_revealage_image.image_view, _oit_sampler,
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+	_oit_resolve_descriptors = _descriptor_cache.acquire(
+			_device, _oit_resolve_descriptor_layout, writer);
+
+	VkPushConstantRange push_constants = {
+		.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+		.offset = 0,
+		.size = sizeof(GPUOITResolvePushConstants),
+	};
+
+	VkPipelineLayoutCreateInfo layout_info = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+		.pNext = nullptr,
+		.setLayoutCount = 1,
+		.pSetLayouts = &_oit_resolve_descriptor_layout,
+		.pushConstantRangeCount = 1,
+		.pPushConstantRanges = &push_constants,
+	};
+
+	VK_CHECK(vkCreatePipelineLayout(
+			_device, &layout_info, nullptr, &_oit_resolve_pipeline_layout));
+
+	VkShaderModule resolve_shader;
+	if (!vkutil::load_shader_module(
+				"oit_resolve.comp.spv", _device, &resolve_shader)) {
+		fmt::print("Error when building the oit resolve compute shader!\n");
+	}
+
+	VkComputePipelineCreateInfo pipeline_info = {
+		.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+		.pNext = nullptr,
+		.stage = vkinit::pipeline_shader_stage_create_info(
+				VK_SHADER_STAGE_COMPUTE_BIT, resolve_shader),
+		.layout = _oit_resolve_pipeline_layout,
+	};
+
+	VK_CHECK(vkCreateComputePipelines(_device, VK_NULL_HANDLE, 1,
+			&pipeline_info, nullptr, &_oit_resolve_pipeline));
+
+	vkDestroyShaderModule(_device, resolve_shader, nullptr);
+
+	_deletion_queue.push_function([this]() {
+		vkDestroyPipelineLayout(
+				_device, _oit_resolve_pipeline_layout, nullptr);
+		vkDestroyPipeline(_device, _oit_resolve_pipeline, nullptr);
+		vkDestroyDescriptorSetLayout(
+				_device, _oit_resolve_descriptor_layout, nullptr);
+		vkDestroySampler(_device, _oit_sampler, nullptr);
+	});
+}
+
 AllocatedBuffer VulkanEngine::create_buffer(size_t alloc_size,
 		VkBufferUsageFlags usage, VmaMemoryUsage memory_usage) {
 	// allocate buffer
@@ -1443,30 +3605,3 @@ void VulkanEngine::draw_imgui(
 
 	vkCmdEndRendering(cmd);
 }
-
-void VulkanEngine::immediate_submit(
-		std::function<void(VkCommandBuffer cmd)>&& function) {
-	VK_CHECK(vkResetFences(_device, 1, &_imm_fence));
-	VK_CHECK(vkResetCommandBuffer(_imm_command_buffer, 0));
-
-	VkCommandBuffer cmd = _imm_command_buffer;
-
-	VkCommandBufferBeginInfo cmd_begin_info = vkinit::command_buffer_begin_info(
-			VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
-
-	VK_CHECK(vkBeginCommandBuffer(_imm_command_buffer, &cmd_begin_info));
-
-	function(cmd);
-
-	VK_CHECK(vkEndCommandBuffer(cmd));
-
-	VkCommandBufferSubmitInfo cmd_info =
-			vkinit::command_buffer_submit_info(cmd);
-	VkSubmitInfo2 submit = vkinit::submit_info(&cmd_info, nullptr, nullptr);
-
-	// submit command buffer to the queue and execute it.
-	// _imm_fence will now block until the graphic commands finish execution
-	VK_CHECK(vkQueueSubmit2(_graphics_queue, 1, &submit, _imm_fence));
-
-	VK_CHECK(vkWaitForFences(_device, 1, &_imm_fence, true, UINT64_MAX));
-}
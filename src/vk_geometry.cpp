@@ -0,0 +1,158 @@
+#include "vk_geometry.h"
+
+// both 16 and 32 bit indices can start anywhere in the index buffer
+constexpr VkDeviceSize INDEX_ALIGNMENT = sizeof(uint32_t);
+
+void RangeAllocator::init(uint64_t capacity) {
+	_free_ranges.clear();
+	_free_ranges[0] = capacity;
+	_capacity = capacity;
+	_used = 0;
+}
+
+std::optional<uint64_t> RangeAllocator::allocate(
+		uint64_t size, uint64_t alignment) {
+	for (auto it = _free_ranges.begin(); it != _free_ranges.end(); it++) {
+		const uint64_t range_offset = it->first;
+		const uint64_t range_size = it->second;
+
+		const uint64_t offset =
+				(range_offset + alignment - 1) / alignment * alignment;
+		if (offset + size > range_offset + range_size) {
+			continue;
+		}
+
+		// keep whatever is left on either side of the allocation
+		_free_ranges.erase(it);
+		if (offset > range_offset) {
+			_free_ranges[range_offset] = offset - range_offset;
+		}
+		if (offset + size < range_offset + range_size) {
+			_free_ranges[offset + size] =
+					range_offset + range_size - (offset + size);
+		}
+
+		_used += size;
+		return offset;
+	}
+
+	return {};
+}
+
+void RangeAllocator::free(uint64_t offset, uint64_t size) {
+	if (size == 0) {
+		return;
+	}
+
+	_used -= size;
+
+	auto it = _free_ranges.emplace(offset, size).first;
+
+	// merge with the following range
+	auto next = std::next(it);
+	if (next != _free_ranges.end() && offset + it->second == next->first) {
+		it->second += next->second;
+		_free_ranges.erase(next);
+	}
+
+	// and with the preceding one
+	if (it != _free_ranges.begin()) {
+		auto prev = std::prev(it);
+		if (prev->first + prev->second == it->first) {
+			prev->second += it->second;
+			_free_ranges.erase(it);
+		}
+	}
+}
+
+static AllocatedBuffer create_device_buffer(
+		VmaAllocator allocator, VkDeviceSize size, VkBufferUsageFlags usage) {
+	VkBufferCreateInfo buffer_info = {
+		.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+		.size = size,
+		.usage = usage,
+	};
+
+	VmaAllocationCreateInfo vma_alloc_info = {
+		.usage = VMA_MEMORY_USAGE_GPU_ONLY,
+	};
+
+	AllocatedBuffer new_buffer;
+	VK_CHECK(vmaCreateBuffer(allocator, &buffer_info, &vma_alloc_info,
+			&new_buffer.buffer, &new_buffer.allocation, &new_buffer.info));
+
+	return new_buffer;
+}
+
+void GeometryBuffer::init(VkDevice device, VmaAllocator allocator,
+		uint32_t vertex_stride, uint32_t position_stride,
+		VkDeviceSize vertex_capacity, VkDeviceSize index_capacity) {
+	_allocator = allocator;
+	_vertex_stride = vertex_stride;
+	_position_stride = position_stride;
+
+	_vertex_buffer = create_device_buffer(allocator, vertex_capacity,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+					VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+					VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);
+
+	VkBufferDeviceAddressInfo device_address_info = {
+		.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
+		.buffer = _vertex_buffer.buffer,
+	};
+	_vertex_address = vkGetBufferDeviceAddress(device, &device_address_info);
+
+	// room for as many vertices as the vertex buffer
+	_position_buffer = create_device_buffer(allocator,
+			vertex_capacity / vertex_stride * position_stride,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+					VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+					VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);
+
+	device_address_info.buffer = _position_buffer.buffer;
+	_position_address =
+			vkGetBufferDeviceAddress(device, &device_address_info);
+
+	_index_buffer = create_device_buffer(allocator, index_capacity,
+			VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+
+	_vertex_ranges.init(vertex_capacity / vertex_stride);
+	_index_ranges.init(index_capacity);
+}
+
+void GeometryBuffer::destroy() {
+	vmaDestroyBuffer(
+			_allocator, _vertex_buffer.buffer, _vertex_buffer.allocation);
+	vmaDestroyBuffer(
+			_allocator, _position_buffer.buffer, _position_buffer.allocation);
+	vmaDestroyBuffer(
+			_allocator, _index_buffer.buffer, _index_buffer.allocation);
+}
+
+std::optional<GeometryAllocation> GeometryBuffer::allocate(
+		uint32_t vertex_count, VkDeviceSize index_size) {
+	std::optional<uint64_t> first_vertex =
+			_vertex_ranges.allocate(vertex_count);
+	if (!first_vertex.has_value()) {
+		return {};
+	}
+
+	std::optional<uint64_t> index_offset =
+			_index_ranges.allocate(index_size, INDEX_ALIGNMENT);
+	if (!index_offset.has_value()) {
+		_vertex_ranges.free(first_vertex.value(), vertex_count);
+		return {};
+	}
+
+	return GeometryAllocation{
+		.first_vertex = (uint32_t)first_vertex.value(),
+		.vertex_count = vertex_count,
+		.index_offset = index_offset.value(),
+		.index_size = index_size,
+	};
+}
+
+void GeometryBuffer::free(const GeometryAllocation& allocation) {
+	_vertex_ranges.free(allocation.first_vertex, allocation.vertex_count);
+	_index_ranges.free(allocation.index_offset, allocation.index_size);
+}
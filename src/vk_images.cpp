@@ -19,7 +19,8 @@ void vkutil::transition_image(VkCommandBuffer cmd, VkImage image,
 	image_barrier.newLayout = new_layout;
 
 	VkImageAspectFlags aspect_mask =
-			(new_layout == VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL)
+			(new_layout == VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL ||
+					new_layout == VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL)
 			? VK_IMAGE_ASPECT_DEPTH_BIT
 			: VK_IMAGE_ASPECT_COLOR_BIT;
 	image_barrier.subresourceRange =
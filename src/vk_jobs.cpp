@@ -0,0 +1,88 @@
+#include "vk_jobs.h"
+
+void JobSystem::init(uint32_t thread_count) {
+	_stop = false;
+
+	for (uint32_t i = 1; i < thread_count; i++) {
+		_workers.emplace_back([this]() { worker_loop(); });
+	}
+}
+
+void JobSystem::shutdown() {
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stop = true;
+	}
+	_wake.notify_all();
+
+	for (std::thread& worker : _workers) {
+		worker.join();
+	}
+	_workers.clear();
+}
+
+void JobSystem::parallel_for(
+		size_t count, const std::function<void(size_t)>& fn) {
+	// not worth waking anyone up
+	if (_workers.empty() || count <= 1) {
+		for (size_t i = 0; i < count; i++) {
+			fn(i);
+		}
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_fn = &fn;
+		_count = count;
+		_next = 0;
+		_busy_workers = (uint32_t)_workers.size();
+		_generation++;
+	}
+	_wake.notify_all();
+
+	run_items();
+
+	// every worker has to be back to sleep before fn goes out of scope
+	std::unique_lock<std::mutex> lock(_mutex);
+	_done.wait(lock, [this]() { return _busy_workers == 0; });
+	_fn = nullptr;
+}
+
+void JobSystem::worker_loop() {
+	uint64_t seen_generation = 0;
+
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_wake.wait(lock, [&]() {
+				return _stop || _generation != seen_generation;
+			});
+
+			if (_stop) {
+				return;
+			}
+
+			seen_generation = _generation;
+		}
+
+		run_items();
+
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_busy_workers--;
+		}
+		_done.notify_one();
+	}
+}
+
+void JobSystem::run_items() {
+	while (true) {
+		size_t i = _next.fetch_add(1);
+		if (i >= _count) {
+			return;
+		}
+
+		(*_fn)(i);
+	}
+}
@@ -10,14 +10,125 @@
 
 #include "vk_engine.h"
 #include "vk_initializers.h"
+#include "vk_jobs.h"
+#include "vk_mesh_cache.h"
+#include "vk_mesh_optimize.h"
+#include "vk_occlusion.h"
 #include "vk_types.h"
+#include "vk_utils.h"
 
 #include <iostream>
 
-std::optional<std::vector<std::shared_ptr<MeshAsset>>> load_gltf_meshes(
-		VulkanEngine* engine, std::filesystem::path file_path) {
-	std::cout << "Loading GLTF: " << file_path << std::endl;
+// where a primitive's geometry goes inside the arrays of its mesh
+struct PrimitiveRange {
+	size_t mesh;
+	size_t primitive;
+	size_t first_vertex;
+	size_t first_index;
+};
+
+template <typename T>
+static std::vector<T> copy_attribute(const fastgltf::Asset& gltf,
+		fastgltf::Primitive& p, std::string_view name) {
+	auto attribute = p.findAttribute(name);
+	if (attribute == p.attributes.end()) {
+		return {};
+	}
+
+	// tightly packed float attributes, which is what exporters write, are a
+	// single memcpy
+	const fastgltf::Accessor& accessor = gltf.accessors[attribute->second];
+	std::vector<T> values(accessor.count);
+	fastgltf::copyFromAccessor<T>(gltf, accessor, values.data());
+
+	return values;
+}
+
+static void decode_indices(const fastgltf::Asset& gltf,
+		const fastgltf::Accessor& accessor, uint32_t base_vertex,
+		uint32_t* dst) {
+	// copy the indices at their stored width, then widen and rebase them in a
+	// plain loop the compiler can vectorize
+	if (accessor.componentType == fastgltf::ComponentType::UnsignedShort) {
+		std::vector<uint16_t> narrow(accessor.count);
+		fastgltf::copyFromAccessor<uint16_t>(gltf, accessor, narrow.data());
+
+		for (size_t i = 0; i < accessor.count; i++) {
+			dst[i] = narrow[i] + base_vertex;
+		}
+	} else {
+		fastgltf::copyFromAccessor<uint32_t>(gltf, accessor, dst);
+
+		for (size_t i = 0; i < accessor.count; i++) {
+			dst[i] += base_vertex;
+		}
+	}
+}
+
+static Bounds compute_bounds(std::span<const glm::vec3> positions) {
+	if (positions.empty()) {
+		return Bounds{
+			.origin = glm::vec3{ 0.f },
+			.sphere_radius = 0.f,
+			.extents = glm::vec3{ 0.f },
+		};
+	}
 
+	glm::vec3 min = positions[0];
+	glm::vec3 max = positions[0];
+	for (const glm::vec3& p : positions) {
+		min = glm::min(min, p);
+		max = glm::max(max, p);
+	}
+
+	Bounds bounds = {
+		.origin = (max + min) / 2.f,
+		.sphere_radius = 0.f,
+		.extents = (max - min) / 2.f,
+	};
+
+	// tighter than the sphere around the aabb
+	for (const glm::vec3& p : positions) {
+		bounds.sphere_radius =
+				glm::max(bounds.sphere_radius, glm::length(p - bounds.origin));
+	}
+
+	return bounds;
+}
+
+static void decode_primitive(const fastgltf::Asset& gltf,
+		fastgltf::Primitive& p, const PrimitiveRange& range, MeshData& mesh) {
+	const fastgltf::Accessor& index_accessor =
+			gltf.accessors[p.indicesAccessor.value()];
+	decode_indices(gltf, index_accessor, (uint32_t)range.first_vertex,
+			&mesh.indices[range.first_index]);
+
+	std::vector<glm::vec3> positions =
+			copy_attribute<glm::vec3>(gltf, p, "POSITION");
+	std::vector<glm::vec3> normals =
+			copy_attribute<glm::vec3>(gltf, p, "NORMAL");
+	std::vector<glm::vec2> uvs =
+			copy_attribute<glm::vec2>(gltf, p, "TEXCOORD_0");
+	std::vector<glm::vec4> colors =
+			copy_attribute<glm::vec4>(gltf, p, "COLOR_0");
+
+	// every primitive is a surface of its own
+	mesh.surfaces[range.primitive].bounds = compute_bounds(positions);
+
+	// interleave every attribute, writing each vertex exactly once
+	Vertex* vertices = &mesh.vertices[range.first_vertex];
+	for (size_t i = 0; i < positions.size(); i++) {
+		Vertex& vtx = vertices[i];
+		vtx.position = positions[i];
+		vtx.normal = normals.empty() ? glm::vec3{ 1, 0, 0 } : normals[i];
+		vtx.uv_x = uvs.empty() ? 0 : uvs[i].x;
+		vtx.uv_y = uvs.empty() ? 0 : uvs[i].y;
+		vtx.color = colors.empty() ? glm::vec4{ 1.f } : colors[i];
+	}
+}
+
+std::optional<std::vector<MeshData>> decode_gltf_meshes(
+		std::filesystem::path file_path, JobSystem* job_system) {
 	auto data = fastgltf::GltfDataBuffer::FromPath(file_path);
 	if (data.error() != fastgltf::Error::None) {
 		return {};
@@ -38,103 +149,175 @@ std::optional<std::vector<std::shared_ptr<MeshAsset>>> load_gltf_meshes(
 		return {};
 	}
 
-	std::vector<std::shared_ptr<MeshAsset>> meshes;
+	// lay out every primitive inside its mesh up front from the accessor
+	// counts, so they can be decoded independently straight into place
+	std::vector<MeshData> meshes(gltf.meshes.size());
+	std::vector<PrimitiveRange> ranges;
+	for (size_t m = 0; m < gltf.meshes.size(); m++) {
+		fastgltf::Mesh& mesh = gltf.meshes[m];
+		MeshData& mesh_data = meshes[m];
 
-	// use the same vectors for all meshes so that the memory doesnt reallocate
-	// as often
-	std::vector<uint32_t> indices;
-	std::vector<Vertex> vertices;
-	for (fastgltf::Mesh& mesh : gltf.meshes) {
-		MeshAsset new_mesh;
+		mesh_data.name = mesh.name;
 
-		new_mesh.name = mesh.name;
+		size_t vertex_count = 0;
+		size_t index_count = 0;
+		for (size_t p = 0; p < mesh.primitives.size(); p++) {
+			fastgltf::Primitive& primitive = mesh.primitives[p];
 
-		// clear the mesh arrays each mesh, we dont want to merge them by error
-		indices.clear();
-		vertices.clear();
-
-		for (auto&& p : mesh.primitives) {
 			GeoSurface new_surface;
-			new_surface.start_index = (uint32_t)indices.size();
+			new_surface.start_index = (uint32_t)index_count;
 			new_surface.count =
-					(uint32_t)gltf.accessors[p.indicesAccessor.value()].count;
+					(uint32_t)gltf.accessors[primitive.indicesAccessor.value()]
+							.count;
+			mesh_data.surfaces.push_back(new_surface);
 
-			size_t initial_vtx = vertices.size();
+			ranges.push_back(PrimitiveRange{
+					.mesh = m,
+					.primitive = p,
+					.first_vertex = vertex_count,
+					.first_index = index_count,
+			});
 
-			// load indexes
-			{
-				fastgltf::Accessor& index_accessor =
-						gltf.accessors[p.indicesAccessor.value()];
-				indices.reserve(indices.size() + index_accessor.count);
+			vertex_count +=
+					gltf.accessors[primitive.findAttribute("POSITION")->second]
+							.count;
+			index_count += new_surface.count;
+		}
 
-				fastgltf::iterateAccessor<std::uint32_t>(
-						gltf, index_accessor, [&](std::uint32_t idx) {
-							indices.push_back(idx + initial_vtx);
-						});
-			}
+		mesh_data.vertices.resize(vertex_count);
+		mesh_data.indices.resize(index_count);
+	}
 
-			// load vertex positions
-			{
-				fastgltf::Accessor& pos_accessor =
-						gltf.accessors[p.findAttribute("POSITION")->second];
-				vertices.resize(vertices.size() + pos_accessor.count);
-
-				fastgltf::iterateAccessorWithIndex<glm::vec3>(
-						gltf, pos_accessor, [&](glm::vec3 v, size_t index) {
-							Vertex new_vtx;
-							new_vtx.position = v;
-							new_vtx.normal = { 1, 0, 0 };
-							new_vtx.color = glm::vec4{ 1.f };
-							new_vtx.uv_x = 0;
-							new_vtx.uv_y = 0;
-							vertices[initial_vtx + index] = new_vtx;
-						});
-			}
+	auto decode = [&](size_t i) {
+		const PrimitiveRange& range = ranges[i];
+		decode_primitive(gltf,
+				gltf.meshes[range.mesh].primitives[range.primitive], range,
+				meshes[range.mesh]);
+	};
 
-			// load vertex normals
-			auto normals = p.findAttribute("NORMAL");
-			if (normals != p.attributes.end()) {
-				fastgltf::iterateAccessorWithIndex<glm::vec3>(gltf,
-						gltf.accessors[(*normals).second],
-						[&](glm::vec3 v, size_t index) {
-							vertices[initial_vtx + index].normal = v;
-						});
-			}
+	if (job_system) {
+		job_system->parallel_for(ranges.size(), decode);
+	} else {
+		for (size_t i = 0; i < ranges.size(); i++) {
+			decode(i);
+		}
+	}
+
+	return meshes;
+}
+
+std::optional<std::vector<std::shared_ptr<MeshAsset>>> load_gltf_meshes(
+		VulkanEngine* engine, std::filesystem::path file_path) {
+	std::cout << "Loading GLTF: " << file_path << std::endl;
+
+	// display the vertex normals
+	constexpr bool OVERRIDE_COLORS = false;
+
+	// the cache is keyed on the source contents and on everything else that
+	// changes the decoded vertices
+	MappedFile source;
+	if (!source.open(file_path)) {
+		fmt::println("Failed to open {}", file_path.string());
+		return {};
+	}
+	const uint64_t key = vkutil::hash_bytes(&OVERRIDE_COLORS,
+			sizeof(OVERRIDE_COLORS),
+			vkutil::hash_bytes(source.data(), source.size()));
+	source.close();
+
+	const std::filesystem::path cache_path = mesh_cache_path(file_path);
+
+	// a cache hit skips parsing entirely, the arrays are copied from the
+	// mapping into staging memory
+	MeshCache cache;
+	std::optional<std::vector<MeshData>> decoded;
+	std::vector<MeshView> views;
+	if (cache.open(cache_path, key)) {
+		views = cache.meshes();
+	} else {
+		decoded = decode_gltf_meshes(file_path, &engine->get_job_system());
+		if (!decoded.has_value()) {
+			return {};
+		}
+
+		// the optimized meshes are what gets cached, so this only runs when
+		// the source changed
+		std::vector<MeshData>& decoded_meshes = decoded.value();
+		engine->get_job_system().parallel_for(decoded_meshes.size(),
+				[&](size_t i) { optimize_mesh(decoded_meshes[i]); });
 
-			// load UVs
-			auto uv = p.findAttribute("TEXCOORD_0");
-			if (uv != p.attributes.end()) {
-				fastgltf::iterateAccessorWithIndex<glm::vec2>(gltf,
-						gltf.accessors[(*uv).second],
-						[&](glm::vec2 v, size_t index) {
-							vertices[initial_vtx + index].uv_x = v.x;
-							vertices[initial_vtx + index].uv_y = v.y;
-						});
+		if (OVERRIDE_COLORS) {
+			for (MeshData& mesh_data : decoded.value()) {
+				for (Vertex& vtx : mesh_data.vertices) {
+					vtx.color = glm::vec4(vtx.normal, 1.f);
+				}
 			}
+		}
+
+		MeshCache::write(cache_path, key, decoded.value());
+
+		for (MeshData& mesh_data : decoded.value()) {
+			views.push_back(MeshView{
+					.name = mesh_data.name,
+					.surfaces = mesh_data.surfaces,
+					.indices = mesh_data.indices,
+					.vertices = mesh_data.vertices,
+			});
+		}
+	}
+
+	std::vector<std::shared_ptr<MeshAsset>> meshes;
 
-			// load vertex colors
-			auto colors = p.findAttribute("COLOR_0");
-			if (colors != p.attributes.end()) {
-				fastgltf::iterateAccessorWithIndex<glm::vec4>(gltf,
-						gltf.accessors[(*colors).second],
-						[&](glm::vec4 v, size_t index) {
-							vertices[initial_vtx + index].color = v;
-						});
+	// every mesh of the file is uploaded with a single submit
+	UploadBatch upload = engine->begin_upload();
+
+	for (MeshView& view : views) {
+		MeshAsset new_mesh;
+
+		new_mesh.name = std::move(view.name);
+		new_mesh.surfaces = std::move(view.surfaces);
+		for (GeoSurface& surface : new_mesh.surfaces) {
+			surface.id = engine->next_surface_id();
+		}
+		// the position only stream of the depth prepass goes along with
+		// the vertices, in the position encoding of their format
+		std::optional<GPUMeshBuffers> mesh_buffers;
+		if (engine->uses_packed_vertices()) {
+			mesh_buffers = engine->upload_mesh(
+					upload, view.indices, pack_vertices(view.vertices));
+		} else {
+			mesh_buffers = engine->upload_mesh(upload, view.indices,
+					view.vertices, extract_positions(view.vertices));
+		}
+
+		// the file does not fit in what is left of the geometry buffer. The
+		// copies recorded so far still go out, the meshes they belong to
+		// are freed once the frames that could see them are done.
+		if (!mesh_buffers.has_value()) {
+			upload.submit();
+			for (std::shared_ptr<MeshAsset>& mesh : meshes) {
+				engine->destroy_mesh(mesh->mesh_buffers);
 			}
-			new_mesh.surfaces.push_back(new_surface);
+			return {};
 		}
+		new_mesh.mesh_buffers = mesh_buffers.value();
 
-		// display the vertex normals
-		constexpr bool OVERRIDE_COLORS = false;
-		if (OVERRIDE_COLORS) {
-			for (Vertex& vtx : vertices) {
-				vtx.color = glm::vec4(vtx.normal, 1.f);
+		if (engine->uses_cpu_occlusion()) {
+			std::optional<OccluderMesh> occluder =
+					build_occluder(view.vertices, view.indices);
+			if (occluder.has_value()) {
+				new_mesh.occluder = std::make_shared<OccluderMesh>(
+						std::move(occluder.value()));
 			}
 		}
-		new_mesh.mesh_buffers = engine->upload_mesh(indices, vertices);
 
 		meshes.emplace_back(std::make_shared<MeshAsset>(std::move(new_mesh)));
 	}
 
+	UploadTicket ticket = upload.submit();
+	for (std::shared_ptr<MeshAsset>& mesh : meshes) {
+		mesh->mesh_buffers.upload_ticket = ticket;
+	}
+
 	return meshes;
 }
@@ -0,0 +1,170 @@
+#include "vk_material_registry.h"
+
+#include <fmt/core.h>
+
+#include <cstring>
+
+void DirtyRanges::add(uint32_t first, uint32_t count) {
+	if (count == 0) {
+		return;
+	}
+
+	uint32_t begin = first;
+	uint32_t end = first + count;
+
+	// the range starting before this one may reach into it
+	auto it = _ranges.upper_bound(begin);
+	if (it != _ranges.begin()) {
+		auto prev = std::prev(it);
+		if (prev->second >= begin) {
+			begin = prev->first;
+			end = std::max(end, prev->second);
+			it = _ranges.erase(prev);
+		}
+	}
+
+	// and the ones starting inside it or right after it are swallowed
+	while (it != _ranges.end() && it->first <= end) {
+		end = std::max(end, it->second);
+		it = _ranges.erase(it);
+	}
+
+	_ranges[begin] = end;
+}
+
+VkDeviceSize pack_dirty_materials(std::span<const GPUMaterial> materials,
+		const DirtyRanges& dirty, std::byte* staging,
+		std::vector<VkBufferCopy>& regions) {
+	VkDeviceSize offset = 0;
+	for (const auto& [first, end] : dirty.ranges()) {
+		const VkDeviceSize size = (end - first) * sizeof(GPUMaterial);
+		memcpy(staging + offset, &materials[first], size);
+
+		regions.push_back(VkBufferCopy{
+				.srcOffset = offset,
+				.dstOffset = first * sizeof(GPUMaterial),
+				.size = size,
+		});
+		offset += size;
+	}
+
+	return offset;
+}
+
+void MaterialRegistry::init(
+		VmaAllocator allocator, uint32_t capacity, uint32_t frame_count) {
+	_allocator = allocator;
+	_capacity = capacity;
+	_materials.clear();
+	_materials.reserve(capacity);
+	_dirty.clear();
+
+	VkBufferCreateInfo buffer_info = {
+		.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+		.size = size(),
+		.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+				VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+	};
+
+	VmaAllocationCreateInfo vma_alloc_info = {
+		.usage = VMA_MEMORY_USAGE_GPU_ONLY,
+	};
+
+	VK_CHECK(vmaCreateBuffer(allocator, &buffer_info, &vma_alloc_info,
+			&_buffer.buffer, &_buffer.allocation, &_buffer.info));
+
+	buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	vma_alloc_info = {
+		.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT,
+		.usage = VMA_MEMORY_USAGE_CPU_ONLY,
+	};
+
+	_staging.resize(frame_count);
+	for (AllocatedBuffer& staging : _staging) {
+		VK_CHECK(vmaCreateBuffer(allocator, &buffer_info, &vma_alloc_info,
+				&staging.buffer, &staging.allocation, &staging.info));
+	}
+
+	_stats = MaterialRegistryStats{
+		.capacity = capacity,
+		.device_bytes = size(),
+		.staging_bytes = size() * frame_count,
+		.allocations = allocation_count(frame_count),
+	};
+}
+
+void MaterialRegistry::destroy() {
+	vmaDestroyBuffer(_allocator, _buffer.buffer, _buffer.allocation);
+	for (AllocatedBuffer& staging : _staging) {
+		vmaDestroyBuffer(_allocator, staging.buffer, staging.allocation);
+	}
+	_staging.clear();
+}
+
+std::optional<uint32_t> MaterialRegistry::add(const GPUMaterial& material) {
+	if (_materials.size() == _capacity) {
+		fmt::println("Material registry is full");
+		return {};
+	}
+
+	const uint32_t index = (uint32_t)_materials.size();
+	_materials.push_back(material);
+	_dirty.add(index, 1);
+
+	_stats.material_count = (uint32_t)_materials.size();
+
+	return index;
+}
+
+void MaterialRegistry::update(uint32_t index, const GPUMaterial& material) {
+	_materials[index] = material;
+	_dirty.add(index, 1);
+}
+
+void MaterialRegistry::flush(VkCommandBuffer cmd, uint32_t frame_index) {
+	_stats.flushed_materials = 0;
+	_stats.copy_regions = 0;
+
+	if (_dirty.empty()) {
+		return;
+	}
+
+	AllocatedBuffer& staging = _staging[frame_index];
+
+	_regions.clear();
+	const VkDeviceSize bytes = pack_dirty_materials(_materials, _dirty,
+			static_cast<std::byte*>(staging.info.pMappedData), _regions);
+	_dirty.clear();
+
+	// earlier frames may still be reading the slots about to be overwritten
+	VkMemoryBarrier2 barrier = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+		.srcStageMask = VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT |
+				VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
+		.dstStageMask = VK_PIPELINE_STAGE_2_COPY_BIT,
+		.dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+	};
+
+	VkDependencyInfo dep_info = {
+		.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+		.memoryBarrierCount = 1,
+		.pMemoryBarriers = &barrier,
+	};
+	vkCmdPipelineBarrier2(cmd, &dep_info);
+
+	vkCmdCopyBuffer(cmd, staging.buffer, _buffer.buffer,
+			(uint32_t)_regions.size(), _regions.data());
+
+	barrier = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+		.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT,
+		.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+		.dstStageMask = VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT |
+				VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
+		.dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT,
+	};
+	vkCmdPipelineBarrier2(cmd, &dep_info);
+
+	_stats.flushed_materials = (uint32_t)(bytes / sizeof(GPUMaterial));
+	_stats.copy_regions = (uint32_t)_regions.size();
+}
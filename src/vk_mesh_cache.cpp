@@ -0,0 +1,312 @@
+#include "vk_mesh_cache.h"
+
+#include <cstring>
+#include <fstream>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// bump whenever decoding or the file layout changes, old caches are then
+// rebuilt on their next load
+constexpr uint32_t MESH_CACHE_VERSION = 3;
+constexpr uint32_t MESH_CACHE_MAGIC = 0x484d4b56; // "VKMH"
+
+// arrays are aligned so they can be read in place from the mapping
+constexpr uint64_t MESH_CACHE_ALIGNMENT = 16;
+
+struct MeshCacheHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t key;
+	uint64_t file_size;
+	uint32_t mesh_count;
+	uint32_t vertex_size;
+};
+
+struct MeshCacheRecord {
+	uint64_t name_offset;
+	uint64_t surfaces_offset;
+	uint64_t vertices_offset;
+	uint64_t indices_offset;
+	uint32_t name_size;
+	uint32_t surface_count;
+	uint32_t vertex_count;
+	uint32_t index_count;
+};
+
+struct MeshCacheSurface {
+	uint32_t start_index;
+	uint32_t count;
+	Bounds bounds;
+};
+
+bool MappedFile::open(const std::filesystem::path& path) {
+	close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+			nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping =
+			CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	void* data = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)
+						 : nullptr;
+	if (!data) {
+		if (mapping) {
+			CloseHandle(mapping);
+		}
+		CloseHandle(file);
+		return false;
+	}
+
+	_file = file;
+	_mapping = mapping;
+	_data = static_cast<const std::byte*>(data);
+	_size = (size_t)size.QuadPart;
+#else
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size == 0) {
+		::close(fd);
+		return false;
+	}
+
+	void* data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	// the mapping keeps its own reference to the file
+	::close(fd);
+	if (data == MAP_FAILED) {
+		return false;
+	}
+
+	_data = static_cast<const std::byte*>(data);
+	_size = (size_t)info.st_size;
+#endif
+
+	return true;
+}
+
+void MappedFile::close() {
+	if (!_data) {
+		return;
+	}
+
+#ifdef _WIN32
+	UnmapViewOfFile(_data);
+	CloseHandle(_mapping);
+	CloseHandle(_file);
+	_file = nullptr;
+	_mapping = nullptr;
+#else
+	munmap(const_cast<std::byte*>(_data), _size);
+#endif
+
+	_data = nullptr;
+	_size = 0;
+}
+
+std::filesystem::path mesh_cache_path(const std::filesystem::path& source) {
+	std::filesystem::path path = source;
+	path += ".vkmesh";
+	return path;
+}
+
+static uint64_t align_up(uint64_t offset) {
+	return (offset + MESH_CACHE_ALIGNMENT - 1) & ~(MESH_CACHE_ALIGNMENT - 1);
+}
+
+bool MeshCache::open(const std::filesystem::path& path, uint64_t key) {
+	_meshes.clear();
+
+	if (!_file.open(path)) {
+		return false;
+	}
+
+	const std::byte* data = _file.data();
+	const uint64_t size = _file.size();
+
+	if (size < sizeof(MeshCacheHeader)) {
+		_file.close();
+		return false;
+	}
+
+	MeshCacheHeader header;
+	memcpy(&header, data, sizeof(header));
+
+	const uint64_t table_end = sizeof(MeshCacheHeader) +
+			(uint64_t)header.mesh_count * sizeof(MeshCacheRecord);
+	if (header.magic != MESH_CACHE_MAGIC ||
+			header.version != MESH_CACHE_VERSION || header.key != key ||
+			header.file_size != size || header.vertex_size != sizeof(Vertex) ||
+			table_end > size) {
+		_file.close();
+		return false;
+	}
+
+	// every range is checked so a truncated or corrupted file is rejected
+	// instead of read out of bounds
+	auto in_file = [&](uint64_t offset, uint64_t bytes) {
+		return offset % MESH_CACHE_ALIGNMENT == 0 && offset <= size &&
+				bytes <= size - offset;
+	};
+
+	for (uint32_t m = 0; m < header.mesh_count; m++) {
+		MeshCacheRecord record;
+		memcpy(&record,
+				data + sizeof(MeshCacheHeader) + m * sizeof(MeshCacheRecord),
+				sizeof(record));
+
+		if (!in_file(record.name_offset, record.name_size) ||
+				!in_file(record.surfaces_offset,
+						(uint64_t)record.surface_count *
+								sizeof(MeshCacheSurface)) ||
+				!in_file(record.vertices_offset,
+						(uint64_t)record.vertex_count * sizeof(Vertex)) ||
+				!in_file(record.indices_offset,
+						(uint64_t)record.index_count * sizeof(uint32_t))) {
+			_meshes.clear();
+			_file.close();
+			return false;
+		}
+
+		MeshView mesh;
+		mesh.name = std::string(
+				reinterpret_cast<const char*>(data + record.name_offset),
+				record.name_size);
+
+		for (uint32_t s = 0; s < record.surface_count; s++) {
+			MeshCacheSurface surface;
+			memcpy(&surface,
+					data + record.surfaces_offset +
+							s * sizeof(MeshCacheSurface),
+					sizeof(surface));
+
+			GeoSurface new_surface;
+			new_surface.start_index = surface.start_index;
+			new_surface.count = surface.count;
+			new_surface.bounds = surface.bounds;
+			mesh.surfaces.push_back(new_surface);
+		}
+
+		mesh.vertices = std::span<const Vertex>(
+				reinterpret_cast<const Vertex*>(data + record.vertices_offset),
+				record.vertex_count);
+		mesh.indices = std::span<const uint32_t>(
+				reinterpret_cast<const uint32_t*>(data + record.indices_offset),
+				record.index_count);
+
+		_meshes.push_back(std::move(mesh));
+	}
+
+	return true;
+}
+
+bool MeshCache::write(const std::filesystem::path& path, uint64_t key,
+		const std::vector<MeshData>& meshes) {
+	// lay the file out first, the header needs the final size
+	std::vector<MeshCacheRecord> records(meshes.size());
+
+	uint64_t offset = sizeof(MeshCacheHeader) +
+			meshes.size() * sizeof(MeshCacheRecord);
+	for (size_t m = 0; m < meshes.size(); m++) {
+		const MeshData& mesh = meshes[m];
+		MeshCacheRecord& record = records[m];
+
+		record.name_size = (uint32_t)mesh.name.size();
+		record.surface_count = (uint32_t)mesh.surfaces.size();
+		record.vertex_count = (uint32_t)mesh.vertices.size();
+		record.index_count = (uint32_t)mesh.indices.size();
+
+		record.name_offset = align_up(offset);
+		offset = record.name_offset + record.name_size;
+		record.surfaces_offset = align_up(offset);
+		offset = record.surfaces_offset +
+				record.surface_count * sizeof(MeshCacheSurface);
+		record.vertices_offset = align_up(offset);
+		offset = record.vertices_offset + record.vertex_count * sizeof(Vertex);
+		record.indices_offset = align_up(offset);
+		offset = record.indices_offset + record.index_count * sizeof(uint32_t);
+	}
+
+	MeshCacheHeader header = {
+		.magic = MESH_CACHE_MAGIC,
+		.version = MESH_CACHE_VERSION,
+		.key = key,
+		.file_size = offset,
+		.mesh_count = (uint32_t)meshes.size(),
+		.vertex_size = sizeof(Vertex),
+	};
+
+	std::vector<std::byte> contents(offset);
+	memcpy(contents.data(), &header, sizeof(header));
+	memcpy(contents.data() + sizeof(header), records.data(),
+			records.size() * sizeof(MeshCacheRecord));
+
+	for (size_t m = 0; m < meshes.size(); m++) {
+		const MeshData& mesh = meshes[m];
+		const MeshCacheRecord& record = records[m];
+
+		memcpy(contents.data() + record.name_offset, mesh.name.data(),
+				record.name_size);
+
+		for (size_t s = 0; s < mesh.surfaces.size(); s++) {
+			MeshCacheSurface surface = {
+				.start_index = mesh.surfaces[s].start_index,
+				.count = mesh.surfaces[s].count,
+				.bounds = mesh.surfaces[s].bounds,
+			};
+			memcpy(contents.data() + record.surfaces_offset +
+							s * sizeof(MeshCacheSurface),
+					&surface, sizeof(surface));
+		}
+
+		memcpy(contents.data() + record.vertices_offset, mesh.vertices.data(),
+				mesh.vertices.size() * sizeof(Vertex));
+		memcpy(contents.data() + record.indices_offset, mesh.indices.data(),
+				mesh.indices.size() * sizeof(uint32_t));
+	}
+
+	// written next to the cache and renamed over it, so a crash or a
+	// concurrent load never sees a partial file
+	std::filesystem::path temp_path = path;
+	temp_path += ".tmp";
+	{
+		std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+		if (!file.write(reinterpret_cast<const char*>(contents.data()),
+					contents.size())) {
+			fmt::println("Failed to write mesh cache {}", temp_path.string());
+			return false;
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::rename(temp_path, path, error);
+	if (error) {
+		fmt::println("Failed to write mesh cache {}: {}", path.string(),
+				error.message());
+		std::filesystem::remove(temp_path, error);
+		return false;
+	}
+
+	return true;
+}
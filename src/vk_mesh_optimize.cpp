@@ -0,0 +1,328 @@
+#include "vk_mesh_optimize.h"
+
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <string_view>
+#include <unordered_map>
+
+VertexCacheStats analyze_vertex_cache(
+		const MeshData& mesh, uint32_t cache_size) {
+	VertexCacheStats stats = {
+		.vertices = 0,
+		.triangles = (uint32_t)(mesh.indices.size() / 3),
+		.cache_misses = 0,
+	};
+
+	// timestamp based fifo: a vertex is in the cache if fewer than cache_size
+	// misses happened since it was last loaded
+	constexpr uint32_t never = ~0u;
+	std::vector<uint32_t> loaded_at(mesh.vertices.size(), never);
+	for (uint32_t index : mesh.indices) {
+		if (loaded_at[index] == never) {
+			stats.vertices++;
+		}
+
+		if (loaded_at[index] == never ||
+				stats.cache_misses - loaded_at[index] >= cache_size) {
+			loaded_at[index] = stats.cache_misses;
+			stats.cache_misses++;
+		}
+	}
+
+	return stats;
+}
+
+void deduplicate_vertices(MeshData& mesh) {
+	auto bytes_of = [](const Vertex& v) {
+		return std::string_view(
+				reinterpret_cast<const char*>(&v), sizeof(Vertex));
+	};
+
+	std::unordered_map<std::string_view, uint32_t> unique;
+	unique.reserve(mesh.vertices.size());
+
+	std::vector<uint32_t> remap(mesh.vertices.size());
+	std::vector<Vertex> vertices;
+	vertices.reserve(mesh.vertices.size());
+
+	for (size_t i = 0; i < mesh.vertices.size(); i++) {
+		// the keys point into the original array, which outlives the map
+		auto [it, inserted] = unique.try_emplace(
+				bytes_of(mesh.vertices[i]), (uint32_t)vertices.size());
+		if (inserted) {
+			vertices.push_back(mesh.vertices[i]);
+		}
+		remap[i] = it->second;
+	}
+
+	for (uint32_t& index : mesh.indices) {
+		index = remap[index];
+	}
+	mesh.vertices = std::move(vertices);
+}
+
+// triangles of every vertex, as offsets into one flat array
+struct Adjacency {
+	std::vector<uint32_t> offsets;
+	std::vector<uint32_t> triangles;
+};
+
+static Adjacency build_adjacency(
+		std::span<const uint32_t> indices, size_t vertex_count) {
+	Adjacency adjacency;
+	adjacency.offsets.assign(vertex_count + 1, 0);
+	for (uint32_t index : indices) {
+		adjacency.offsets[index + 1]++;
+	}
+	std::partial_sum(adjacency.offsets.begin(), adjacency.offsets.end(),
+			adjacency.offsets.begin());
+
+	std::vector<uint32_t> cursor(
+			adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+	adjacency.triangles.resize(indices.size());
+	for (size_t i = 0; i < indices.size(); i++) {
+		adjacency.triangles[cursor[indices[i]]++] = (uint32_t)(i / 3);
+	}
+
+	return adjacency;
+}
+
+// tipsify, Sander et al. 2007. Writes the reordered triangle list to out and
+// returns the triangle index each cluster starts at. Clusters begin whenever
+// the walk hits a dead end and has to jump, so they are the natural units to
+// reorder for overdraw without losing cache reuse.
+static std::vector<uint32_t> tipsify(std::span<const uint32_t> indices,
+		size_t vertex_count, uint32_t cache_size, std::span<uint32_t> out) {
+	const Adjacency adjacency = build_adjacency(indices, vertex_count);
+
+	std::vector<uint32_t> live(vertex_count);
+	for (size_t v = 0; v < vertex_count; v++) {
+		live[v] = adjacency.offsets[v + 1] - adjacency.offsets[v];
+	}
+
+	std::vector<uint32_t> cache_time(vertex_count, 0);
+	std::vector<bool> emitted(indices.size() / 3, false);
+	std::vector<uint32_t> dead_end;
+	std::vector<uint32_t> candidates;
+	std::vector<uint32_t> cluster_starts;
+
+	uint32_t time = cache_size + 1;
+	size_t scan = 0;
+	size_t written = 0;
+
+	auto next_live = [&]() -> int64_t {
+		while (!dead_end.empty()) {
+			uint32_t v = dead_end.back();
+			dead_end.pop_back();
+			if (live[v] > 0) {
+				return v;
+			}
+		}
+		for (; scan < vertex_count; scan++) {
+			if (live[scan] > 0) {
+				return (int64_t)scan;
+			}
+		}
+		return -1;
+	};
+
+	int64_t fan = next_live();
+	bool jumped = true;
+	while (fan >= 0) {
+		if (jumped) {
+			cluster_starts.push_back((uint32_t)(written / 3));
+		}
+
+		candidates.clear();
+		for (uint32_t a = adjacency.offsets[fan];
+				a < adjacency.offsets[fan + 1]; a++) {
+			const uint32_t t = adjacency.triangles[a];
+			if (emitted[t]) {
+				continue;
+			}
+			emitted[t] = true;
+
+			for (uint32_t k = 0; k < 3; k++) {
+				const uint32_t v = indices[t * 3 + k];
+				out[written++] = v;
+				dead_end.push_back(v);
+				candidates.push_back(v);
+				live[v]--;
+				if (time - cache_time[v] > cache_size) {
+					cache_time[v] = time++;
+				}
+			}
+		}
+
+		// prefer the candidate that will still be in the cache when its
+		// remaining triangles are emitted, and among those the oldest one
+		int64_t best = -1;
+		int64_t best_priority = -1;
+		for (uint32_t v : candidates) {
+			if (live[v] == 0) {
+				continue;
+			}
+			int64_t priority = 0;
+			if (time - cache_time[v] + 2 * live[v] <= cache_size) {
+				priority = time - cache_time[v];
+			}
+			if (priority > best_priority) {
+				best_priority = priority;
+				best = v;
+			}
+		}
+
+		jumped = best < 0;
+		fan = jumped ? next_live() : best;
+	}
+
+	return cluster_starts;
+}
+
+// sorts clusters by how far they face away from the center of the surface.
+// Those on the outside tend to occlude the ones inside and behind them, so
+// drawing them first lets early depth reject more fragments.
+static void sort_clusters_for_overdraw(std::span<uint32_t> indices,
+		const std::vector<uint32_t>& cluster_starts,
+		const std::vector<Vertex>& vertices) {
+	const size_t triangle_count = indices.size() / 3;
+	if (cluster_starts.size() < 2) {
+		return;
+	}
+
+	auto triangle_position = [&](size_t t, uint32_t k) {
+		return vertices[indices[t * 3 + k]].position;
+	};
+
+	glm::vec3 center{ 0.f };
+	for (size_t t = 0; t < triangle_count; t++) {
+		center += triangle_position(t, 0) + triangle_position(t, 1) +
+				triangle_position(t, 2);
+	}
+	center /= (float)(triangle_count * 3);
+
+	struct Cluster {
+		uint32_t first;
+		uint32_t count;
+		float sort_key;
+	};
+
+	std::vector<Cluster> clusters(cluster_starts.size());
+	for (size_t c = 0; c < clusters.size(); c++) {
+		Cluster& cluster = clusters[c];
+		cluster.first = cluster_starts[c];
+		cluster.count = (c + 1 < cluster_starts.size()
+									? cluster_starts[c + 1]
+									: (uint32_t)triangle_count) -
+				cluster.first;
+
+		// area weighted normal and centroid
+		glm::vec3 normal{ 0.f };
+		glm::vec3 centroid{ 0.f };
+		float area = 0.f;
+		for (uint32_t t = cluster.first; t < cluster.first + cluster.count;
+				t++) {
+			const glm::vec3 p0 = triangle_position(t, 0);
+			const glm::vec3 p1 = triangle_position(t, 1);
+			const glm::vec3 p2 = triangle_position(t, 2);
+
+			const glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+			const float a = glm::length(n);
+			normal += n;
+			centroid += (p0 + p1 + p2) * (a / 3.f);
+			area += a;
+		}
+
+		if (area > 0.f && glm::length(normal) > 0.f) {
+			centroid /= area;
+			cluster.sort_key =
+					glm::dot(centroid - center, glm::normalize(normal));
+		} else {
+			cluster.sort_key = 0.f;
+		}
+	}
+
+	std::stable_sort(clusters.begin(), clusters.end(),
+			[](const Cluster& a, const Cluster& b) {
+				return a.sort_key > b.sort_key;
+			});
+
+	std::vector<uint32_t> sorted;
+	sorted.reserve(indices.size());
+	for (const Cluster& cluster : clusters) {
+		sorted.insert(sorted.end(), indices.begin() + cluster.first * 3,
+				indices.begin() + (cluster.first + cluster.count) * 3);
+	}
+	std::copy(sorted.begin(), sorted.end(), indices.begin());
+}
+
+void optimize_vertex_cache(MeshData& mesh) {
+	std::vector<uint32_t> reordered(mesh.indices.size());
+
+	// tipsify runs on the vertices of one surface at a time, renumbered from
+	// zero in the order the surface uses them, so its cost does not depend
+	// on the vertices of the other surfaces. Only the entries a surface set
+	// are cleared after it.
+	constexpr uint32_t unused = ~0u;
+	std::vector<uint32_t> local(mesh.vertices.size(), unused);
+	std::vector<uint32_t> global;
+	std::vector<uint32_t> local_indices;
+
+	for (const GeoSurface& surface : mesh.surfaces) {
+		global.clear();
+		local_indices.resize(surface.count);
+		for (uint32_t i = 0; i < surface.count; i++) {
+			const uint32_t index = mesh.indices[surface.start_index + i];
+			if (local[index] == unused) {
+				local[index] = (uint32_t)global.size();
+				global.push_back(index);
+			}
+			local_indices[i] = local[index];
+		}
+
+		std::span<uint32_t> out(
+				reordered.data() + surface.start_index, surface.count);
+		std::vector<uint32_t> cluster_starts = tipsify(
+				local_indices, global.size(), VERTEX_CACHE_SIZE, out);
+
+		for (uint32_t& index : out) {
+			index = global[index];
+		}
+		for (uint32_t v : global) {
+			local[v] = unused;
+		}
+
+		sort_clusters_for_overdraw(out, cluster_starts, mesh.vertices);
+	}
+
+	mesh.indices = std::move(reordered);
+}
+
+void optimize_vertex_fetch(MeshData& mesh) {
+	constexpr uint32_t unused = ~0u;
+	std::vector<uint32_t> remap(mesh.vertices.size(), unused);
+	std::vector<Vertex> vertices;
+	vertices.reserve(mesh.vertices.size());
+
+	// vertices no index refers to are dropped
+	for (uint32_t& index : mesh.indices) {
+		if (remap[index] == unused) {
+			remap[index] = (uint32_t)vertices.size();
+			vertices.push_back(mesh.vertices[index]);
+		}
+		index = remap[index];
+	}
+
+	mesh.vertices = std::move(vertices);
+}
+
+void optimize_mesh(MeshData& mesh) {
+	// fewer vertices means more cache hits, so merge them first, and the
+	// fetch order can only be decided once the index order is final
+	deduplicate_vertices(mesh);
+	optimize_vertex_cache(mesh);
+	optimize_vertex_fetch(mesh);
+}
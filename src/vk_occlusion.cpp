@@ -0,0 +1,380 @@
+#include "vk_occlusion.h"
+
+#include "vk_simd.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// depth of an empty working layer, any triangle replaces it
+constexpr float EMPTY_LAYER_DEPTH = std::numeric_limits<float>::max();
+
+// vertices closer to the camera plane than this are not projected, their
+// triangles are dropped, which only ever occludes less
+constexpr float MIN_CLIP_W = 1e-5f;
+
+constexpr uint32_t FULL_MASK = ~0u;
+
+std::optional<OccluderMesh> build_occluder(
+		std::span<const Vertex> vertices, std::span<const uint32_t> indices) {
+	if (indices.size() / 3 > OCCLUDER_MAX_TRIANGLES) {
+		return {};
+	}
+
+	OccluderMesh occluder;
+	occluder.positions.reserve(vertices.size());
+	for (const Vertex& vertex : vertices) {
+		occluder.positions.push_back(vertex.position);
+	}
+	occluder.indices.assign(indices.begin(), indices.end());
+
+	return occluder;
+}
+
+void OcclusionBuffer::init(uint32_t width, uint32_t height) {
+	_tiles_x = (width + TILE_WIDTH - 1) / TILE_WIDTH;
+	_tiles_y = (height + TILE_HEIGHT - 1) / TILE_HEIGHT;
+	_tiles.resize(_tiles_x * _tiles_y);
+	clear();
+}
+
+void OcclusionBuffer::clear() {
+	// the depth the engine clears to, it never wins the depth test
+	std::fill(_tiles.begin(), _tiles.end(),
+			Tile{ .depth = { 0.f, EMPTY_LAYER_DEPTH }, .mask = 0 });
+}
+
+void OcclusionBuffer::setup_triangles(const OccluderMesh& mesh,
+		const glm::mat4& mvp, std::vector<OccluderTriangle>& out) const {
+	const float width = (float)this->width();
+	const float height = (float)this->height();
+
+	struct ScreenVertex {
+		float x;
+		float y;
+		float depth;
+		bool valid;
+	};
+
+	std::vector<ScreenVertex> screen(mesh.positions.size());
+	for (size_t i = 0; i < mesh.positions.size(); i++) {
+		const glm::vec4 clip = mvp * glm::vec4(mesh.positions[i], 1.f);
+		if (clip.w < MIN_CLIP_W) {
+			screen[i].valid = false;
+			continue;
+		}
+
+		// pixels, y down like the viewport
+		screen[i] = ScreenVertex{
+			.x = (clip.x / clip.w * 0.5f + 0.5f) * width,
+			.y = (clip.y / clip.w * 0.5f + 0.5f) * height,
+			.depth = clip.z / clip.w,
+			.valid = true,
+		};
+	}
+
+	for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+		const ScreenVertex& v0 = screen[mesh.indices[i]];
+		const ScreenVertex& v1 = screen[mesh.indices[i + 1]];
+		const ScreenVertex& v2 = screen[mesh.indices[i + 2]];
+		if (!v0.valid || !v1.valid || !v2.valid) {
+			continue;
+		}
+
+		const float min_x = std::min({ v0.x, v1.x, v2.x });
+		const float max_x = std::max({ v0.x, v1.x, v2.x });
+		const float min_y = std::min({ v0.y, v1.y, v2.y });
+		const float max_y = std::max({ v0.y, v1.y, v2.y });
+		if (max_x < 0.f || max_y < 0.f || min_x >= width ||
+				min_y >= height) {
+			continue;
+		}
+
+		// twice the signed area, both windings occlude since the pipelines
+		// do not cull back faces
+		const float area = (v1.x - v0.x) * (v2.y - v0.y) -
+				(v1.y - v0.y) * (v2.x - v0.x);
+		if (area == 0.f) {
+			continue;
+		}
+		const float sign = area > 0.f ? 1.f : -1.f;
+
+		OccluderTriangle triangle;
+
+		const ScreenVertex* corners[3] = { &v0, &v1, &v2 };
+		for (int e = 0; e < 3; e++) {
+			const ScreenVertex& a = *corners[e];
+			const ScreenVertex& b = *corners[(e + 1) % 3];
+			triangle.edge_a[e] = -(b.y - a.y) * sign;
+			triangle.edge_b[e] = (b.x - a.x) * sign;
+			triangle.edge_c[e] = ((b.y - a.y) * a.x - (b.x - a.x) * a.y) * sign;
+		}
+
+		const float d1 = v1.depth - v0.depth;
+		const float d2 = v2.depth - v0.depth;
+		triangle.depth_a =
+				(d1 * (v2.y - v0.y) - (v1.y - v0.y) * d2) / area;
+		triangle.depth_b =
+				((v1.x - v0.x) * d2 - d1 * (v2.x - v0.x)) / area;
+		triangle.depth_c = v0.depth - triangle.depth_a * v0.x -
+				triangle.depth_b * v0.y;
+		triangle.min_depth = std::min({ v0.depth, v1.depth, v2.depth });
+
+		auto tile_of = [](float pixel, uint32_t tile_size, uint32_t tiles) {
+			const float tile = std::floor(pixel / tile_size);
+			return (uint16_t)std::clamp(tile, 0.f, (float)(tiles - 1));
+		};
+		triangle.tile_min_x = tile_of(min_x, TILE_WIDTH, _tiles_x);
+		triangle.tile_max_x = tile_of(max_x, TILE_WIDTH, _tiles_x);
+		triangle.tile_min_y = tile_of(min_y, TILE_HEIGHT, _tiles_y);
+		triangle.tile_max_y = tile_of(max_y, TILE_HEIGHT, _tiles_y);
+
+		out.push_back(triangle);
+	}
+}
+
+// pixels of the tile at x, y whose centers are inside the triangle, one bit
+// per pixel in rows of 8. Every kernel evaluates the edges as
+// (a * x + b * y) + c so they agree on pixels right on an edge.
+using CoverageKernel = uint32_t (*)(const OccluderTriangle&, float, float);
+
+static uint32_t tile_coverage_scalar(
+		const OccluderTriangle& triangle, float x, float y) {
+	uint32_t mask = 0;
+	for (uint32_t row = 0; row < OcclusionBuffer::TILE_HEIGHT; row++) {
+		const float py = y + (float)row + 0.5f;
+		for (uint32_t column = 0; column < OcclusionBuffer::TILE_WIDTH;
+				column++) {
+			const float px = x + (float)column + 0.5f;
+
+			bool inside = true;
+			for (int e = 0; e < 3; e++) {
+				const float distance =
+						(triangle.edge_a[e] * px + triangle.edge_b[e] * py) +
+						triangle.edge_c[e];
+				inside = inside && distance > 0.f;
+			}
+			mask |= (uint32_t)inside
+					<< (row * OcclusionBuffer::TILE_WIDTH + column);
+		}
+	}
+	return mask;
+}
+
+#if CULLING_X86
+static uint32_t tile_coverage_sse(
+		const OccluderTriangle& triangle, float x, float y) {
+	// the left and right half of a row
+	const __m128 px[2] = {
+		_mm_add_ps(_mm_set1_ps(x), _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f)),
+		_mm_add_ps(_mm_set1_ps(x), _mm_setr_ps(4.5f, 5.5f, 6.5f, 7.5f)),
+	};
+
+	__m128 ax[3][2];
+	for (int e = 0; e < 3; e++) {
+		const __m128 a = _mm_set1_ps(triangle.edge_a[e]);
+		ax[e][0] = _mm_mul_ps(a, px[0]);
+		ax[e][1] = _mm_mul_ps(a, px[1]);
+	}
+
+	uint32_t mask = 0;
+	for (uint32_t row = 0; row < OcclusionBuffer::TILE_HEIGHT; row++) {
+		const float py = y + (float)row + 0.5f;
+
+		uint32_t row_mask = 0;
+		for (int half = 0; half < 2; half++) {
+			__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+			for (int e = 0; e < 3; e++) {
+				const __m128 distance = _mm_add_ps(
+						_mm_add_ps(ax[e][half],
+								_mm_set1_ps(triangle.edge_b[e] * py)),
+						_mm_set1_ps(triangle.edge_c[e]));
+				inside = _mm_and_ps(
+						inside, _mm_cmpgt_ps(distance, _mm_setzero_ps()));
+			}
+			row_mask |= (uint32_t)_mm_movemask_ps(inside) << (half * 4);
+		}
+		mask |= row_mask << (row * OcclusionBuffer::TILE_WIDTH);
+	}
+	return mask;
+}
+
+CULLING_TARGET_AVX2 static uint32_t tile_coverage_avx2(
+		const OccluderTriangle& triangle, float x, float y) {
+	// a whole row per vector
+	const __m256 px = _mm256_add_ps(_mm256_set1_ps(x),
+			_mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f));
+
+	__m256 ax[3];
+	for (int e = 0; e < 3; e++) {
+		ax[e] = _mm256_mul_ps(_mm256_set1_ps(triangle.edge_a[e]), px);
+	}
+
+	uint32_t mask = 0;
+	for (uint32_t row = 0; row < OcclusionBuffer::TILE_HEIGHT; row++) {
+		const float py = y + (float)row + 0.5f;
+
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (int e = 0; e < 3; e++) {
+			const __m256 distance = _mm256_add_ps(
+					_mm256_add_ps(
+							ax[e], _mm256_set1_ps(triangle.edge_b[e] * py)),
+					_mm256_set1_ps(triangle.edge_c[e]));
+			inside = _mm256_and_ps(inside,
+					_mm256_cmp_ps(distance, _mm256_setzero_ps(), _CMP_GT_OQ));
+		}
+		mask |= (uint32_t)_mm256_movemask_ps(inside)
+				<< (row * OcclusionBuffer::TILE_WIDTH);
+	}
+	return mask;
+}
+#endif
+
+static CoverageKernel coverage_kernel(CullingKernel kernel) {
+	switch (kernel) {
+#if CULLING_X86
+		case CullingKernel::AVX2:
+			return tile_coverage_avx2;
+		case CullingKernel::SSE:
+			return tile_coverage_sse;
+#endif
+		default:
+			return tile_coverage_scalar;
+	}
+}
+
+void OcclusionBuffer::rasterize(std::span<const OccluderTriangle> triangles,
+		uint32_t first_row, uint32_t end_row, CullingKernel kernel) {
+	const CoverageKernel coverage = coverage_kernel(kernel);
+
+	for (const OccluderTriangle& triangle : triangles) {
+		const uint32_t min_y =
+				std::max<uint32_t>(triangle.tile_min_y, first_row);
+		const uint32_t max_y =
+				std::min<uint32_t>(triangle.tile_max_y + 1, end_row);
+
+		for (uint32_t ty = min_y; ty < max_y; ty++) {
+			for (uint32_t tx = triangle.tile_min_x; tx <= triangle.tile_max_x;
+					tx++) {
+				const float x = (float)(tx * TILE_WIDTH);
+				const float y = (float)(ty * TILE_HEIGHT);
+
+				const uint32_t mask = coverage(triangle, x, y);
+				if (mask == 0) {
+					continue;
+				}
+
+				// the plane is linear, so its smallest depth over the tile
+				// is at a corner. The triangle never goes below its own
+				// vertices.
+				auto plane = [&](float px, float py) {
+					return (triangle.depth_a * px + triangle.depth_b * py) +
+							triangle.depth_c;
+				};
+				const float depth = std::max(triangle.min_depth,
+						std::min({ plane(x, y), plane(x + TILE_WIDTH, y),
+								plane(x, y + TILE_HEIGHT),
+								plane(x + TILE_WIDTH, y + TILE_HEIGHT) }));
+
+				update_tile(_tiles[ty * _tiles_x + tx], mask, depth);
+			}
+		}
+	}
+}
+
+void OcclusionBuffer::update_tile(Tile& tile, uint32_t coverage, float depth) {
+	// a triangle behind what already covers the whole tile adds nothing
+	if (depth <= tile.depth[0]) {
+		return;
+	}
+
+	// the working layer is dropped when the triangle is further from it than
+	// it is from the whole tile depth, merging would lower it too much
+	if (depth - tile.depth[1] > tile.depth[1] - tile.depth[0]) {
+		tile.depth[1] = EMPTY_LAYER_DEPTH;
+		tile.mask = 0;
+	}
+
+	tile.depth[1] = std::min(tile.depth[1], depth);
+	tile.mask |= coverage;
+
+	// a full working layer becomes the depth of the whole tile
+	if (tile.mask == FULL_MASK) {
+		tile.depth[0] = tile.depth[1];
+		tile.depth[1] = EMPTY_LAYER_DEPTH;
+		tile.mask = 0;
+	}
+}
+
+bool OcclusionBuffer::is_occluded(
+		const Bounds& bounds, const glm::mat4& mvp) const {
+	const float width = (float)this->width();
+	const float height = (float)this->height();
+
+	float min_x = width;
+	float max_x = 0.f;
+	float min_y = height;
+	float max_y = 0.f;
+	float box_depth = 0.f;
+	for (int i = 0; i < 8; i++) {
+		const glm::vec3 corner = bounds.origin +
+				bounds.extents *
+						glm::vec3((i & 1) ? 1.f : -1.f, (i & 2) ? 1.f : -1.f,
+								(i & 4) ? 1.f : -1.f);
+		const glm::vec4 clip = mvp * glm::vec4(corner, 1.f);
+
+		// crosses the camera plane, the projection is unbounded
+		if (clip.w < MIN_CLIP_W) {
+			return false;
+		}
+
+		const float x = (clip.x / clip.w * 0.5f + 0.5f) * width;
+		const float y = (clip.y / clip.w * 0.5f + 0.5f) * height;
+		min_x = std::min(min_x, x);
+		max_x = std::max(max_x, x);
+		min_y = std::min(min_y, y);
+		max_y = std::max(max_y, y);
+		box_depth = std::max(box_depth, clip.z / clip.w);
+	}
+
+	// every pixel the rectangle touches
+	const int x0 = std::max((int)std::floor(min_x), 0);
+	const int x1 = std::min((int)std::floor(max_x), (int)width - 1);
+	const int y0 = std::max((int)std::floor(min_y), 0);
+	const int y1 = std::min((int)std::floor(max_y), (int)height - 1);
+	if (x0 > x1 || y0 > y1) {
+		return false;
+	}
+
+	for (int ty = y0 / (int)TILE_HEIGHT; ty <= y1 / (int)TILE_HEIGHT; ty++) {
+		for (int tx = x0 / (int)TILE_WIDTH; tx <= x1 / (int)TILE_WIDTH; tx++) {
+			const Tile& tile = _tiles[ty * _tiles_x + tx];
+			if (box_depth < tile.depth[0]) {
+				continue;
+			}
+
+			// the part of the rectangle inside the tile
+			const int column0 = std::max(x0 - tx * (int)TILE_WIDTH, 0);
+			const int column1 =
+					std::min(x1 - tx * (int)TILE_WIDTH, (int)TILE_WIDTH - 1);
+			const int row0 = std::max(y0 - ty * (int)TILE_HEIGHT, 0);
+			const int row1 =
+					std::min(y1 - ty * (int)TILE_HEIGHT, (int)TILE_HEIGHT - 1);
+
+			const uint32_t row_bits = ((1u << (column1 - column0 + 1)) - 1)
+					<< column0;
+			uint32_t rect_mask = 0;
+			for (int row = row0; row <= row1; row++) {
+				rect_mask |= row_bits << (row * TILE_WIDTH);
+			}
+
+			if ((rect_mask & ~tile.mask) == 0 && box_depth < tile.depth[1]) {
+				continue;
+			}
+
+			return false;
+		}
+	}
+
+	return true;
+}
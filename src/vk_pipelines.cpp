@@ -15,7 +15,8 @@ void PipelineBuilder::clear() {
 		.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
 	};
 
-	_color_blend_attachment = {};
+	_color_blend_attachments[0] = {};
+	_color_blend_attachments[1] = {};
 
 	_multisampling = {
 		.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
@@ -43,15 +44,14 @@ VkPipeline PipelineBuilder::build_pipeline(VkDevice device) {
 		.scissorCount = 1,
 	};
 
-	// setup dummy color blending. We arent using transparent objects yet
-	// the blending is just "no blend", but we do write to the color attachment
+	// one blend state per color attachment
 	VkPipelineColorBlendStateCreateInfo color_blending = {
 		.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
 		.pNext = nullptr,
 		.logicOpEnable = VK_FALSE,
 		.logicOp = VK_LOGIC_OP_COPY,
-		.attachmentCount = 1,
-		.pAttachments = &_color_blend_attachment,
+		.attachmentCount = _render_info.colorAttachmentCount,
+		.pAttachments = _color_blend_attachments,
 	};
 
 	// completely clear VertexInputStateCreateInfo, as we have no need for it
@@ -110,8 +110,10 @@ void PipelineBuilder::set_shaders(
 	_shader_stages.push_back(vkinit::pipeline_shader_stage_create_info(
 			VK_SHADER_STAGE_VERTEX_BIT, vertex_shader));
 
-	_shader_stages.push_back(vkinit::pipeline_shader_stage_create_info(
-			VK_SHADER_STAGE_FRAGMENT_BIT, fragment_shader));
+	if (fragment_shader != VK_NULL_HANDLE) {
+		_shader_stages.push_back(vkinit::pipeline_shader_stage_create_info(
+				VK_SHADER_STAGE_FRAGMENT_BIT, fragment_shader));
+	}
 }
 
 void PipelineBuilder::set_input_topology(VkPrimitiveTopology topology) {
@@ -145,46 +147,88 @@ void PipelineBuilder::set_multisampling_none() {
 
 void PipelineBuilder::disable_blending() {
 	// default write mask
-	_color_blend_attachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT |
+	_color_blend_attachments[0].colorWriteMask = VK_COLOR_COMPONENT_R_BIT |
 			VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT |
 			VK_COLOR_COMPONENT_A_BIT;
 	// no blending
-	_color_blend_attachment.blendEnable = VK_FALSE;
+	_color_blend_attachments[0].blendEnable = VK_FALSE;
 }
 
 void PipelineBuilder::enable_blending_additive() {
-	_color_blend_attachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT |
+	_color_blend_attachments[0].colorWriteMask = VK_COLOR_COMPONENT_R_BIT |
 			VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT |
 			VK_COLOR_COMPONENT_A_BIT;
-	_color_blend_attachment.blendEnable = VK_TRUE;
-	_color_blend_attachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
-	_color_blend_attachment.dstColorBlendFactor = VK_BLEND_FACTOR_DST_ALPHA;
-	_color_blend_attachment.colorBlendOp = VK_BLEND_OP_ADD;
-	_color_blend_attachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-	_color_blend_attachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-	_color_blend_attachment.alphaBlendOp = VK_BLEND_OP_ADD;
+	_color_blend_attachments[0].blendEnable = VK_TRUE;
+	_color_blend_attachments[0].srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+	_color_blend_attachments[0].dstColorBlendFactor = VK_BLEND_FACTOR_DST_ALPHA;
+	_color_blend_attachments[0].colorBlendOp = VK_BLEND_OP_ADD;
+	_color_blend_attachments[0].srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+	_color_blend_attachments[0].dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+	_color_blend_attachments[0].alphaBlendOp = VK_BLEND_OP_ADD;
 }
 
 void PipelineBuilder::enable_blending_alphablend() {
-	_color_blend_attachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT |
+	_color_blend_attachments[0].colorWriteMask = VK_COLOR_COMPONENT_R_BIT |
 			VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT |
 			VK_COLOR_COMPONENT_A_BIT;
-	_color_blend_attachment.blendEnable = VK_TRUE;
-	_color_blend_attachment.srcColorBlendFactor =
-			VK_BLEND_FACTOR_ONE_MINUS_DST_ALPHA;
-	_color_blend_attachment.dstColorBlendFactor = VK_BLEND_FACTOR_DST_ALPHA;
-	_color_blend_attachment.colorBlendOp = VK_BLEND_OP_ADD;
-	_color_blend_attachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-	_color_blend_attachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-	_color_blend_attachment.alphaBlendOp = VK_BLEND_OP_ADD;
+	_color_blend_attachments[0].blendEnable = VK_TRUE;
+	// straight alpha over whatever was drawn before
+	_color_blend_attachments[0].srcColorBlendFactor =
+			VK_BLEND_FACTOR_SRC_ALPHA;
+	_color_blend_attachments[0].dstColorBlendFactor =
+			VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+	_color_blend_attachments[0].colorBlendOp = VK_BLEND_OP_ADD;
+	_color_blend_attachments[0].srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+	_color_blend_attachments[0].dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+	_color_blend_attachments[0].alphaBlendOp = VK_BLEND_OP_ADD;
 }
 
 void PipelineBuilder::set_color_attachment_format(VkFormat format) {
-	_color_attachment_format = format;
+	_color_attachment_formats[0] = format;
 
 	// connect the format to the renderInfo  structure
 	_render_info.colorAttachmentCount = 1;
-	_render_info.pColorAttachmentFormats = &_color_attachment_format;
+	_render_info.pColorAttachmentFormats = _color_attachment_formats;
+}
+
+void PipelineBuilder::clear_color_attachments() {
+	_render_info.colorAttachmentCount = 0;
+	_render_info.pColorAttachmentFormats = nullptr;
+}
+
+void PipelineBuilder::set_weighted_blended_attachments(
+		VkFormat accum_format, VkFormat revealage_format) {
+	_color_attachment_formats[0] = accum_format;
+	_color_attachment_formats[1] = revealage_format;
+
+	_render_info.colorAttachmentCount = 2;
+	_render_info.pColorAttachmentFormats = _color_attachment_formats;
+
+	// sum of every fragment's contribution, in any order
+	_color_blend_attachments[0] = {
+		.blendEnable = VK_TRUE,
+		.srcColorBlendFactor = VK_BLEND_FACTOR_ONE,
+		.dstColorBlendFactor = VK_BLEND_FACTOR_ONE,
+		.colorBlendOp = VK_BLEND_OP_ADD,
+		.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE,
+		.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE,
+		.alphaBlendOp = VK_BLEND_OP_ADD,
+		.colorWriteMask = VK_COLOR_COMPONENT_R_BIT |
+				VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT |
+				VK_COLOR_COMPONENT_A_BIT,
+	};
+
+	// dst * (1 - src), the fragment writes its alpha
+	_color_blend_attachments[1] = {
+		.blendEnable = VK_TRUE,
+		.srcColorBlendFactor = VK_BLEND_FACTOR_ZERO,
+		.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_COLOR,
+		.colorBlendOp = VK_BLEND_OP_ADD,
+		.srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO,
+		.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+		.alphaBlendOp = VK_BLEND_OP_ADD,
+		.colorWriteMask = VK_COLOR_COMPONENT_R_BIT,
+	};
 }
 
 void PipelineBuilder::set_depth_format(VkFormat format) {
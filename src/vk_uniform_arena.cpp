@@ -0,0 +1,47 @@
+#include "vk_uniform_arena.h"
+
+#include <algorithm>
+
+void UniformArena::init(VmaAllocator allocator, VkDeviceSize size,
+		VkDeviceSize min_offset_alignment) {
+	_allocator = allocator;
+	_size = size;
+	_alignment = std::max<VkDeviceSize>(min_offset_alignment, 1);
+	_used = 0;
+
+	VkBufferCreateInfo buffer_info = {
+		.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+		.size = size,
+		.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+	};
+
+	VmaAllocationCreateInfo vma_alloc_info = {
+		.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT,
+		.usage = VMA_MEMORY_USAGE_CPU_TO_GPU,
+	};
+
+	VK_CHECK(vmaCreateBuffer(allocator, &buffer_info, &vma_alloc_info,
+			&_buffer.buffer, &_buffer.allocation, &_buffer.info));
+
+	_mapped = static_cast<std::byte*>(_buffer.info.pMappedData);
+}
+
+void UniformArena::destroy() {
+	vmaDestroyBuffer(_allocator, _buffer.buffer, _buffer.allocation);
+	_mapped = nullptr;
+}
+
+std::optional<UniformAllocation> UniformArena::allocate(VkDeviceSize size) {
+	// the alignment is a power of two on every implementation
+	const VkDeviceSize offset = (_used + _alignment - 1) & ~(_alignment - 1);
+	if (offset + size > _size) {
+		return {};
+	}
+
+	_used = offset + size;
+
+	return UniformAllocation{
+		.offset = (uint32_t)offset,
+		.data = _mapped + offset,
+	};
+}
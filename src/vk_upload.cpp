@@ -0,0 +1,475 @@
+#include "vk_upload.h"
+
+#include "vk_images.h"
+#include "vk_initializers.h"
+
+#include <cstring>
+
+// satisfies the offset requirements of both buffer and image copies
+constexpr VkDeviceSize STAGING_ALIGNMENT = 16;
+
+static VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment) {
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+static AllocatedBuffer create_staging_buffer(
+		VmaAllocator allocator, VkDeviceSize size) {
+	VkBufferCreateInfo buffer_info = {
+		.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+		.size = size,
+		.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+	};
+
+	VmaAllocationCreateInfo vma_alloc_info = {
+		.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT,
+		.usage = VMA_MEMORY_USAGE_CPU_ONLY,
+	};
+
+	AllocatedBuffer new_buffer;
+	VK_CHECK(vmaCreateBuffer(allocator, &buffer_info, &vma_alloc_info,
+			&new_buffer.buffer, &new_buffer.allocation, &new_buffer.info));
+
+	return new_buffer;
+}
+
+void UploadBatch::copy_to_buffer(VkBuffer dst, VkDeviceSize dst_offset,
+		const void* data, size_t size) {
+	if (size == 0) {
+		return;
+	}
+
+	UploadContext::StagingAllocation staging =
+			_context->allocate_staging(size);
+	memcpy(staging.data, data, size);
+
+	VkBufferCopy copy = {
+		.srcOffset = staging.offset,
+		.dstOffset = dst_offset,
+		.size = size,
+	};
+
+	vkCmdCopyBuffer(
+			_context->get_recording_cmd(), staging.buffer, dst, 1, &copy);
+
+	_context->release_buffer(dst, dst_offset, size);
+}
+
+void UploadBatch::copy_to_image(
+		const AllocatedImage& image, const void* data, size_t size) {
+	UploadContext::StagingAllocation staging =
+			_context->allocate_staging(size);
+	memcpy(staging.data, data, size);
+
+	VkCommandBuffer cmd = _context->get_recording_cmd();
+
+	vkutil::transition_image(cmd, image.image, VK_IMAGE_LAYOUT_UNDEFINED,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+	VkBufferImageCopy copy_region = {
+		.bufferOffset = staging.offset,
+		.bufferRowLength = 0,
+		.bufferImageHeight = 0,
+		.imageSubresource = {
+			.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+			.mipLevel = 0,
+			.baseArrayLayer = 0,
+			.layerCount = 1,
+		},
+		.imageExtent = image.image_extent,
+	};
+
+	vkCmdCopyBufferToImage(cmd, staging.buffer, image.image,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy_region);
+
+	// with an ownership transfer the layout change is part of the
+	// release/acquire pair instead
+	if (_context->transfers_ownership()) {
+		_context->release_image(image.image);
+	} else {
+		vkutil::transition_image(cmd, image.image,
+				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	}
+}
+
+UploadTicket UploadBatch::submit() { return _context->flush(); }
+
+void UploadContext::init(VkDevice device, VmaAllocator allocator,
+		VkQueue queue, uint32_t queue_family, uint32_t graphics_queue_family,
+		VkDeviceSize staging_size) {
+	_device = device;
+	_allocator = allocator;
+	_queue = queue;
+	_queue_family = queue_family;
+	_graphics_queue_family = graphics_queue_family;
+
+	VkCommandPoolCreateInfo command_pool_info =
+			vkinit::command_pool_create_info(queue_family,
+					VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+	VK_CHECK(vkCreateCommandPool(
+			_device, &command_pool_info, nullptr, &_command_pool));
+
+	VkSemaphoreTypeCreateInfo timeline_info = {
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+		.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+		.initialValue = 0,
+	};
+
+	VkSemaphoreCreateInfo semaphore_info = vkinit::semaphore_create_info();
+	semaphore_info.pNext = &timeline_info;
+	VK_CHECK(vkCreateSemaphore(_device, &semaphore_info, nullptr, &_timeline));
+
+	_ring_size = staging_size;
+	_ring = create_staging_buffer(_allocator, _ring_size);
+	_ring_head = 0;
+	_ring_tail = 0;
+
+	_recording_cmd = VK_NULL_HANDLE;
+	_last_submitted = 0;
+	_last_completed = 0;
+	_last_acquired = 0;
+}
+
+void UploadContext::destroy() {
+	flush();
+	wait(UploadTicket{ _last_submitted });
+
+	_free_cmds.clear();
+	_pending_acquires.clear();
+
+	vkDestroySemaphore(_device, _timeline, nullptr);
+	vkDestroyCommandPool(_device, _command_pool, nullptr);
+	vmaDestroyBuffer(_allocator, _ring.buffer, _ring.allocation);
+}
+
+UploadBatch UploadContext::begin_batch() { return UploadBatch(this); }
+
+bool UploadContext::is_complete(UploadTicket ticket) {
+	retire();
+	return ticket.value <= _last_completed;
+}
+
+void UploadContext::wait(UploadTicket ticket) {
+	if (ticket.value > _last_submitted) {
+		flush();
+	}
+
+	VkSemaphoreWaitInfo wait_info = {
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+		.semaphoreCount = 1,
+		.pSemaphores = &_timeline,
+		.pValues = &ticket.value,
+	};
+	VK_CHECK(vkWaitSemaphores(_device, &wait_info, UINT64_MAX));
+
+	retire();
+}
+
+UploadTicket UploadContext::record_acquires(VkCommandBuffer cmd) {
+	retire();
+
+	std::vector<VkBufferMemoryBarrier2> buffer_barriers;
+	std::vector<VkImageMemoryBarrier2> image_barriers;
+
+	uint64_t wait_value = 0;
+	while (!_pending_acquires.empty() &&
+			_pending_acquires.front().value <= _last_completed) {
+		PendingAcquire& acquire = _pending_acquires.front();
+
+		buffer_barriers.insert(buffer_barriers.end(),
+				acquire.buffer_barriers.begin(), acquire.buffer_barriers.end());
+		image_barriers.insert(image_barriers.end(),
+				acquire.image_barriers.begin(), acquire.image_barriers.end());
+
+		wait_value = acquire.value;
+		_pending_acquires.pop_front();
+	}
+
+	if (wait_value == 0) {
+		return UploadTicket{ 0 };
+	}
+
+	VkDependencyInfo dep_info = {
+		.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+		.bufferMemoryBarrierCount = (uint32_t)buffer_barriers.size(),
+		.pBufferMemoryBarriers = buffer_barriers.data(),
+		.imageMemoryBarrierCount = (uint32_t)image_barriers.size(),
+		.pImageMemoryBarriers = image_barriers.data(),
+	};
+
+	vkCmdPipelineBarrier2(cmd, &dep_info);
+
+	_last_acquired = wait_value;
+
+	return UploadTicket{ wait_value };
+}
+
+UploadTicket UploadContext::usable_ticket() const {
+	// on the graphics queue itself the closing barrier of every submission
+	// already covers everything recorded after it
+	if (!transfers_ownership()) {
+		return UploadTicket{ _last_submitted };
+	}
+
+	// tickets without anything to acquire are usable as soon as they are
+	// complete
+	if (_pending_acquires.empty()) {
+		return UploadTicket{ _last_completed };
+	}
+
+	return UploadTicket{ std::min(
+			_pending_acquires.front().value - 1, _last_completed) };
+}
+
+UploadContext::StagingAllocation UploadContext::allocate_staging(
+		VkDeviceSize size) {
+	VkDeviceSize aligned_size = align_up(size, STAGING_ALIGNMENT);
+
+	// uploads that can never fit the ring get their own staging buffer which
+	// lives until the submission that uses it has completed
+	if (aligned_size > _ring_size) {
+		AllocatedBuffer buffer = create_staging_buffer(_allocator, size);
+		_recording_oversized_buffers.push_back(buffer);
+
+		return StagingAllocation{
+			.buffer = buffer.buffer,
+			.offset = 0,
+			.data = buffer.info.pMappedData,
+		};
+	}
+
+	// allocations never wrap around, skip the rest of the ring instead
+	VkDeviceSize ring_offset = _ring_head % _ring_size;
+	if (ring_offset + aligned_size > _ring_size) {
+		_ring_head += _ring_size - ring_offset;
+	}
+
+	while (_ring_head + aligned_size - _ring_tail > _ring_size) {
+		retire();
+		if (_ring_head + aligned_size - _ring_tail <= _ring_size) {
+			break;
+		}
+
+		// the ring is used up by the commands being recorded right now, so
+		// they have to be submitted before their space can be reused
+		if (_in_flight.empty()) {
+			flush();
+		}
+
+		// nothing is using the ring anymore besides the skipped end
+		if (_in_flight.empty()) {
+			_ring_tail = _ring_head;
+			break;
+		}
+
+		wait_oldest();
+	}
+
+	StagingAllocation allocation = {
+		.buffer = _ring.buffer,
+		.offset = _ring_head % _ring_size,
+	};
+	allocation.data = (char*)_ring.info.pMappedData + allocation.offset;
+
+	_ring_head += aligned_size;
+
+	return allocation;
+}
+
+VkCommandBuffer UploadContext::get_recording_cmd() {
+	if (_recording_cmd != VK_NULL_HANDLE) {
+		return _recording_cmd;
+	}
+
+	if (_free_cmds.empty()) {
+		VkCommandBufferAllocateInfo cmd_alloc_info =
+				vkinit::command_buffer_allocate_info(_command_pool, 1);
+
+		VkCommandBuffer cmd;
+		VK_CHECK(vkAllocateCommandBuffers(_device, &cmd_alloc_info, &cmd));
+		_free_cmds.push_back(cmd);
+	}
+
+	_recording_cmd = _free_cmds.back();
+	_free_cmds.pop_back();
+
+	VK_CHECK(vkResetCommandBuffer(_recording_cmd, 0));
+
+	VkCommandBufferBeginInfo cmd_begin_info = vkinit::command_buffer_begin_info(
+			VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+	VK_CHECK(vkBeginCommandBuffer(_recording_cmd, &cmd_begin_info));
+
+	return _recording_cmd;
+}
+
+void UploadContext::release_buffer(
+		VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size) {
+	if (!transfers_ownership()) {
+		return;
+	}
+
+	VkBufferMemoryBarrier2 release = {
+		.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+		.srcStageMask = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT,
+		.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+		.dstStageMask = VK_PIPELINE_STAGE_2_NONE,
+		.dstAccessMask = VK_ACCESS_2_NONE,
+		.srcQueueFamilyIndex = _queue_family,
+		.dstQueueFamilyIndex = _graphics_queue_family,
+		.buffer = buffer,
+		.offset = offset,
+		.size = size,
+	};
+
+	_recording_buffer_releases.push_back(release);
+}
+
+void UploadContext::release_image(VkImage image) {
+	VkImageMemoryBarrier2 release = {
+		.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+		.srcStageMask = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT,
+		.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+		.dstStageMask = VK_PIPELINE_STAGE_2_NONE,
+		.dstAccessMask = VK_ACCESS_2_NONE,
+		.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		.srcQueueFamilyIndex = _queue_family,
+		.dstQueueFamilyIndex = _graphics_queue_family,
+		.image = image,
+		.subresourceRange =
+				vkinit::image_subresource_range(VK_IMAGE_ASPECT_COLOR_BIT),
+	};
+
+	_recording_image_releases.push_back(release);
+}
+
+UploadTicket UploadContext::flush() {
+	if (_recording_cmd == VK_NULL_HANDLE) {
+		return UploadTicket{ _last_submitted };
+	}
+
+	VkCommandBuffer cmd = _recording_cmd;
+	_recording_cmd = VK_NULL_HANDLE;
+
+	if (transfers_ownership()) {
+		VkDependencyInfo dep_info = {
+			.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+			.bufferMemoryBarrierCount =
+					(uint32_t)_recording_buffer_releases.size(),
+			.pBufferMemoryBarriers = _recording_buffer_releases.data(),
+			.imageMemoryBarrierCount =
+					(uint32_t)_recording_image_releases.size(),
+			.pImageMemoryBarriers = _recording_image_releases.data(),
+		};
+
+		vkCmdPipelineBarrier2(cmd, &dep_info);
+	} else {
+		// make the copies visible to everything submitted after them, which
+		// is what lets callers skip waiting on the ticket before drawing
+		VkMemoryBarrier2 barrier = {
+			.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+			.srcStageMask = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT,
+			.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+			.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+			.dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT,
+		};
+
+		VkDependencyInfo dep_info = {
+			.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+			.memoryBarrierCount = 1,
+			.pMemoryBarriers = &barrier,
+		};
+
+		vkCmdPipelineBarrier2(cmd, &dep_info);
+	}
+
+	VK_CHECK(vkEndCommandBuffer(cmd));
+
+	// no-op on coherent memory
+	vmaFlushAllocation(_allocator, _ring.allocation, 0, VK_WHOLE_SIZE);
+
+	const uint64_t value = _last_submitted + 1;
+
+	VkCommandBufferSubmitInfo cmd_info =
+			vkinit::command_buffer_submit_info(cmd);
+	VkSemaphoreSubmitInfo signal_info = vkinit::semaphore_submit_info(
+			VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, _timeline);
+	signal_info.value = value;
+
+	VkSubmitInfo2 submit =
+			vkinit::submit_info(&cmd_info, &signal_info, nullptr);
+
+	VK_CHECK(vkQueueSubmit2(_queue, 1, &submit, VK_NULL_HANDLE));
+
+	_last_submitted = value;
+
+	_in_flight.push_back(Submission{
+			.value = value,
+			.cmd = cmd,
+			.ring_end = _ring_head,
+			.oversized_buffers = std::move(_recording_oversized_buffers),
+	});
+	_recording_oversized_buffers.clear();
+
+	if (transfers_ownership()) {
+		// the acquire mirrors the release, only the stages and accesses
+		// change to the graphics side
+		PendingAcquire acquire = { .value = value };
+
+		for (VkBufferMemoryBarrier2 barrier : _recording_buffer_releases) {
+			barrier.srcStageMask = VK_PIPELINE_STAGE_2_NONE;
+			barrier.srcAccessMask = VK_ACCESS_2_NONE;
+			barrier.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+			barrier.dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT;
+			acquire.buffer_barriers.push_back(barrier);
+		}
+
+		for (VkImageMemoryBarrier2 barrier : _recording_image_releases) {
+			barrier.srcStageMask = VK_PIPELINE_STAGE_2_NONE;
+			barrier.srcAccessMask = VK_ACCESS_2_NONE;
+			barrier.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+			barrier.dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT;
+			acquire.image_barriers.push_back(barrier);
+		}
+
+		if (!acquire.buffer_barriers.empty() ||
+				!acquire.image_barriers.empty()) {
+			_pending_acquires.push_back(std::move(acquire));
+		}
+
+		_recording_buffer_releases.clear();
+		_recording_image_releases.clear();
+	}
+
+	return UploadTicket{ value };
+}
+
+void UploadContext::retire() {
+	uint64_t completed;
+	VK_CHECK(vkGetSemaphoreCounterValue(_device, _timeline, &completed));
+
+	// submissions complete in order of their values, so the ring tail only
+	// ever moves forward
+	while (!_in_flight.empty() && _in_flight.front().value <= completed) {
+		Submission& submission = _in_flight.front();
+
+		for (AllocatedBuffer& buffer : submission.oversized_buffers) {
+			vmaDestroyBuffer(_allocator, buffer.buffer, buffer.allocation);
+		}
+
+		_ring_tail = submission.ring_end;
+		_free_cmds.push_back(submission.cmd);
+
+		_in_flight.pop_front();
+	}
+
+	_last_completed = completed;
+}
+
+void UploadContext::wait_oldest() {
+	if (_in_flight.empty()) {
+		return;
+	}
+
+	wait(UploadTicket{ _in_flight.front().value });
+}
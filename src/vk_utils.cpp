@@ -1,8 +1,30 @@
 #include "vk_utils.h"
 
+#include <cstring>
+
 glm::mat4 vkutil::make_inf_reversed_z_proj_rh(
 		float fov_y_radians, float aspect_wby_h, float z_near) {
 	float f = 1.0f / tan(fov_y_radians / 2.0f);
 	return glm::mat4(f / aspect_wby_h, 0.0f, 0.0f, 0.0f, 0.0f, f, 0.0f, 0.0f,
 			0.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f, z_near, 0.0f);
 }
+
+uint64_t vkutil::hash_bytes(const void* data, size_t size, uint64_t seed) {
+	constexpr uint64_t prime = 0x100000001b3ull;
+
+	const std::byte* bytes = static_cast<const std::byte*>(data);
+	uint64_t hash = seed;
+
+	// whole words first, byte at a time fnv is too slow for large buffers
+	size_t i = 0;
+	for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+		uint64_t word;
+		memcpy(&word, bytes + i, sizeof(word));
+		hash = (hash ^ word) * prime;
+	}
+	for (; i < size; i++) {
+		hash = (hash ^ (uint64_t)bytes[i]) * prime;
+	}
+
+	return hash;
+}
@@ -0,0 +1,117 @@
+#include "vk_vertex_packing.h"
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/packing.hpp>
+
+#include <cstring>
+
+glm::vec2 encode_octahedral(const glm::vec3& n) {
+	const float l1 = glm::abs(n.x) + glm::abs(n.y) + glm::abs(n.z);
+	if (l1 == 0.f) {
+		return glm::vec2{ 0.f };
+	}
+
+	// project onto the octahedron, then fold the lower half over the upper
+	glm::vec2 p = glm::vec2(n.x, n.y) / l1;
+	if (n.z < 0.f) {
+		glm::vec2 sign = { p.x >= 0.f ? 1.f : -1.f, p.y >= 0.f ? 1.f : -1.f };
+		p = (1.f - glm::abs(glm::vec2(p.y, p.x))) * sign;
+	}
+	return p;
+}
+
+glm::vec3 decode_octahedral(const glm::vec2& e) {
+	glm::vec3 n = { e.x, e.y, 1.f - glm::abs(e.x) - glm::abs(e.y) };
+	float t = glm::max(-n.z, 0.f);
+	n.x += n.x >= 0.f ? -t : t;
+	n.y += n.y >= 0.f ? -t : t;
+	return glm::normalize(n);
+}
+
+PackedVertices pack_vertices(std::span<const Vertex> vertices) {
+	PackedVertices packed;
+
+	glm::vec3 min{ 0.f };
+	glm::vec3 max{ 0.f };
+	if (!vertices.empty()) {
+		min = max = vertices[0].position;
+	}
+	for (const Vertex& v : vertices) {
+		min = glm::min(min, v.position);
+		max = glm::max(max, v.position);
+	}
+
+	packed.position_offset = min;
+	packed.position_scale = (max - min) / 65535.f;
+
+	// flat axes would divide by zero, every vertex sits on the offset
+	const glm::vec3 inv_scale = {
+		packed.position_scale.x > 0.f ? 1.f / packed.position_scale.x : 0.f,
+		packed.position_scale.y > 0.f ? 1.f / packed.position_scale.y : 0.f,
+		packed.position_scale.z > 0.f ? 1.f / packed.position_scale.z : 0.f,
+	};
+
+	packed.vertices.resize(vertices.size());
+	packed.positions.resize(vertices.size());
+	for (size_t i = 0; i < vertices.size(); i++) {
+		const Vertex& v = vertices[i];
+		PackedVertex& p = packed.vertices[i];
+
+		const glm::vec3 unorm = glm::clamp(
+				glm::round((v.position - min) * inv_scale), 0.f, 65535.f);
+		p.position[0] = (uint16_t)unorm.x;
+		p.position[1] = (uint16_t)unorm.y;
+		p.position[2] = (uint16_t)unorm.z;
+
+		packed.positions[i] = PackedPosition{
+			.position = { p.position[0], p.position[1], p.position[2] },
+			.padding = 0,
+		};
+
+		const glm::vec2 oct = glm::round(
+				glm::clamp(encode_octahedral(v.normal), -1.f, 1.f) * 127.f);
+		p.normal[0] = (int8_t)oct.x;
+		p.normal[1] = (int8_t)oct.y;
+
+		// same bit layout the shader unpacks with unpackHalf2x16 and
+		// unpackUnorm4x8
+		const uint32_t uv = glm::packHalf2x16(glm::vec2(v.uv_x, v.uv_y));
+		memcpy(p.uv, &uv, sizeof(uv));
+		const uint32_t color = glm::packUnorm4x8(v.color);
+		memcpy(p.color, &color, sizeof(color));
+	}
+
+	return packed;
+}
+
+std::vector<glm::vec3> extract_positions(std::span<const Vertex> vertices) {
+	std::vector<glm::vec3> positions(vertices.size());
+	for (size_t i = 0; i < vertices.size(); i++) {
+		positions[i] = vertices[i].position;
+	}
+	return positions;
+}
+
+Vertex unpack_vertex(const PackedVertex& packed,
+		const glm::vec3& position_offset, const glm::vec3& position_scale) {
+	uint32_t uv;
+	memcpy(&uv, packed.uv, sizeof(uv));
+	uint32_t color;
+	memcpy(&color, packed.color, sizeof(color));
+
+	const glm::vec3 unorm = glm::vec3(
+			packed.position[0], packed.position[1], packed.position[2]);
+	const glm::vec2 oct =
+			glm::max(glm::vec2(packed.normal[0], packed.normal[1]) / 127.f,
+					-1.f);
+	const glm::vec2 tex_coord = glm::unpackHalf2x16(uv);
+
+	return Vertex{
+		.position = position_offset + unorm * position_scale,
+		.uv_x = tex_coord.x,
+		.normal = decode_octahedral(oct),
+		.uv_y = tex_coord.y,
+		.color = glm::unpackUnorm4x8(color),
+	};
+}